@@ -0,0 +1,177 @@
+/*
+ * host_main.c
+ *
+ * Runs the firmware as a Linux process: app_main() starts the tasks as on
+ * the device, then the main thread just waits for the run time to pass.
+ *
+ * With -s, the run is a soak test of the zero-allocation steady state: from
+ * the given number of seconds after start on, any heap allocation aborts the
+ * process, except in the tasks that talk to ESP-IDF components which
+ * allocate on the device too (esp_http_client, the event loop).  The I2C
+ * driver of ESP-IDF before v4.4 allocates every command link, those
+ * allocations are counted in the report rather than aborting.
+ *
+ * With -n, NVS lives in a file, so a second run starts like the device after
+ * a reboot; the blob writes of the run are printed at exit.
+ *
+ * With -b, the firmware boots into its benchmarks (see main/bench.h) and the
+ * process exits when they are done and it calls esp_restart().
+ *
+ * With -l, the process checks the LED driver's SPI encoder and backend
+ * (led_check.cpp) instead of running the firmware, and exits with 1 if that
+ * fails.  -w does the same for the captive portal scanner, on the saved
+ * portal pages in host/portal (portal_check.c), and -e for quotes restored
+ * from NVS meeting a partial response (restore_check.c).
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "host.h"
+#include "ssd1306_emu.h"
+#include "affinity.h"
+#include "bench.h"
+
+void app_main(void);
+int led_check_run(void);
+int portal_check_run(void);
+int restore_check_run(void);
+
+static int stdin_flags = -1;
+
+// tasks allowed to allocate in the steady state
+static const char *const soak_exempt[] = { "quote_task", "eventTask" };
+#define SOAK_EXEMPT (sizeof soak_exempt / sizeof soak_exempt[0])
+static uint64_t soak_start_allocs, soak_start_driver_allocs, soak_exempt_allocs[SOAK_EXEMPT];
+
+static void soak_alloc_hook(size_t size) {
+    const char *task = pcTaskGetTaskName(NULL);
+    for (size_t i = 0; i < SOAK_EXEMPT; i++) {
+        if (strcmp(task, soak_exempt[i]) == 0) {
+            __atomic_add_fetch(&soak_exempt_allocs[i], 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    fprintf(stderr, "soak: %zu byte heap allocation in %s after boot\n", size, task);
+    abort();
+}
+
+static void soak_report() {
+    printf("soak: %llu allocations after boot:",
+           (unsigned long long)(host_heap_allocs() - soak_start_allocs));
+    for (size_t i = 0; i < SOAK_EXEMPT; i++)
+        printf(" %llu in %s,", (unsigned long long)soak_exempt_allocs[i], soak_exempt[i]);
+    printf(" %llu in the I2C driver, none elsewhere\n",
+           (unsigned long long)(host_heap_driver_allocs() - soak_start_driver_allocs));
+}
+
+static void nvs_report() {
+    uint32_t writes, bytes;
+    host_nvs_stats(&writes, &bytes);
+    printf("nvs: %u blob writes, %u bytes\n", writes, bytes);
+}
+
+static void restore_stdin() {
+    if (stdin_flags != -1)
+        fcntl(STDIN_FILENO, F_SETFL, stdin_flags);
+}
+
+static void on_signal(int sig) {
+    restore_stdin();
+    _exit(128 + sig);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-t seconds] [-s seconds] [-r rtt_ms] [-k feed_tick_ms] [-z] [-q] [-f]\n"
+            "          [-o dir] [-n file] [-b] [-c channel] [-a ap_down_ms] [-p preset] [-l] [-w] [-e]\n"
+            "  -t  stop after this many seconds (default: run until killed)\n"
+            "  -s  soak test: abort on heap allocations this many seconds after start\n"
+            "  -r  simulated network round trip time (default %d ms)\n"
+            "  -k  how often the simulated rate feed changes (default %d ms)\n"
+            "  -z  never gzip the rate feed\n"
+            "  -q  only log warnings and errors\n"
+            "  -f  print I2C stats of every OLED frame\n"
+            "  -o  write every OLED frame to dir/frame_NNNNN.pbm\n"
+            "  -n  keep NVS in this file across runs\n"
+            "  -b  run the benchmarks, print them as CSV and exit\n"
+            "  -c  channel of the simulated AP (default %d)\n"
+            "  -a  simulated AP out of reach for this long after start\n"
+            "  -p  core affinity preset: 0 float, 1 split, 2 shared (see main/affinity.h)\n"
+            "  -l  check the LED driver's SPI encoder against the LED timings and exit\n"
+            "  -w  check the captive portal scanner on the saved pages and exit\n"
+            "  -e  check restored quotes against a partial first response and exit\n",
+            argv0, host_net.rtt_ms, host_net.feed_tick_ms, host_wifi.channel);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int seconds = 0, boot_seconds = -1;
+    ssd1306_emu_config_t oled = {0};
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:r:k:zqfo:n:bc:a:p:lweh")) != -1) {
+        switch (opt) {
+        case 't': seconds = atoi(optarg); break;
+        case 's': boot_seconds = atoi(optarg); break;
+        case 'r': host_net.rtt_ms = atoi(optarg); break;
+        case 'k': host_net.feed_tick_ms = atoi(optarg); break;
+        case 'z': host_net.gzip = 0; break;
+        case 'q': esp_log_level_set("*", ESP_LOG_WARN); break;
+        case 'f': oled.print_frames = 1; break;
+        case 'o': oled.dump_dir = optarg; break;
+        case 'n': host_nvs_path = optarg; break;
+        case 'b': bench_request_boot(); break;
+        case 'c': host_wifi.channel = atoi(optarg); break;
+        case 'a': host_wifi.down_ms = atoi(optarg); break;
+        case 'p': affinity_request(atoi(optarg)); break;
+        case 'l': exit(led_check_run() ? 1 : 0);
+        case 'w': exit(portal_check_run() ? 1 : 0);
+        case 'e': exit(restore_check_run() ? 1 : 0);
+        default: usage(argv[0]);
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // the console task polls stdin like the UART, which never blocks
+    stdin_flags = fcntl(STDIN_FILENO, F_GETFL);
+    if (stdin_flags != -1) {
+        fcntl(STDIN_FILENO, F_SETFL, stdin_flags | O_NONBLOCK);
+        atexit(restore_stdin);
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+    }
+
+    if (host_nvs_path)
+        atexit(nvs_report);
+
+    // the hat's OLED, at OLED_I2C_ADDRESS
+    ssd1306_emu_attach(0, 0x3C, &oled);
+
+    app_main();
+
+    if (boot_seconds >= 0) {
+        sleep(boot_seconds);
+        soak_start_allocs = host_heap_allocs();
+        soak_start_driver_allocs = host_heap_driver_allocs();
+        host_heap_set_hook(soak_alloc_hook);
+        atexit(soak_report);
+        printf("soak: boot over, no more heap allocations outside the exempt tasks and drivers\n");
+        seconds -= boot_seconds;
+    }
+
+    if (seconds > 0) {
+        sleep(seconds);
+        exit(0);
+    }
+    while (1)
+        pause();
+}
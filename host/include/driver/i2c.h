@@ -0,0 +1,94 @@
+/*
+ * driver/i2c.h (host)
+ *
+ * Command links are recorded like on the device, and i2c_master_cmd_begin()
+ * plays them to the slaves attached with host_i2c_attach().  Transactions to
+ * any other address are NACKed, like on a real bus.
+ *
+ * The API is ESP-IDF v4.0's, which this tree targets: every command of a
+ * link is allocated from the heap.  With TBHUT_I2C_STATIC defined (the CMake
+ * option of the same name) it is v4.4's, which adds links in caller-provided
+ * memory.
+ */
+
+#ifndef HOST_DRIVER_I2C_H_
+#define HOST_DRIVER_I2C_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    I2C_NUM_0 = 0,
+    I2C_NUM_1,
+    I2C_NUM_MAX,
+} i2c_port_t;
+
+typedef enum {
+    I2C_MODE_SLAVE = 0,
+    I2C_MODE_MASTER,
+} i2c_mode_t;
+
+typedef enum {
+    I2C_MASTER_WRITE = 0,
+    I2C_MASTER_READ,
+} i2c_rw_t;
+
+typedef struct {
+    i2c_mode_t mode;
+    int sda_io_num;
+    gpio_pullup_t sda_pullup_en;
+    int scl_io_num;
+    gpio_pullup_t scl_pullup_en;
+    union {
+        struct {
+            uint32_t clk_speed;
+        } master;
+        struct {
+            uint8_t addr_10bit_en;
+            uint16_t slave_addr;
+        } slave;
+    };
+} i2c_config_t;
+
+typedef struct host_i2c_cmd *i2c_cmd_handle_t;
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf);
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len,
+                             size_t slv_tx_buf_len, int intr_alloc_flags);
+
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+
+#ifdef TBHUT_I2C_STATIC
+// Command links in caller-provided memory, as in ESP-IDF v4.4.  Every
+// start/write/stop takes one I2C_INTERNAL_STRUCT_SIZE record from the buffer,
+// appending fails with ESP_ERR_NO_MEM once it is full.
+#define I2C_INTERNAL_STRUCT_SIZE 40
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) \
+    (2 * I2C_INTERNAL_STRUCT_SIZE + I2C_INTERNAL_STRUCT_SIZE * (5 * (TRANSACTIONS)))
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle);
+#endif
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+// data isn't copied, it must stay valid until i2c_master_cmd_begin()
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data,
+                           size_t data_len, bool ack_en);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle,
+                               TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_DRIVER_I2C_H_ */
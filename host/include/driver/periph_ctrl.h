@@ -0,0 +1,11 @@
+/*
+ * driver/periph_ctrl.h (host)
+ */
+
+#ifndef HOST_DRIVER_PERIPH_CTRL_H_
+#define HOST_DRIVER_PERIPH_CTRL_H_
+
+#define periph_module_enable(periph) ((void)(periph))
+#define periph_module_disable(periph) ((void)(periph))
+
+#endif /* HOST_DRIVER_PERIPH_CTRL_H_ */
@@ -0,0 +1,17 @@
+/*
+ * esp32/rom/crc.h (host)
+ *
+ * The ROM's little-endian CRC32 is the same as zlib's.
+ */
+
+#ifndef HOST_ROM_CRC_H_
+#define HOST_ROM_CRC_H_
+
+#include <stdint.h>
+#include <zlib.h>
+
+static inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    return crc32(crc, buf, len);
+}
+
+#endif /* HOST_ROM_CRC_H_ */
@@ -0,0 +1,113 @@
+/*
+ * esp32/rom/miniz.h (host)
+ *
+ * The slice of the ROM's tinfl API that gunzip.c uses, implemented with
+ * zlib's raw inflate.  zlib's allocations come out of an arena inside the
+ * decompressor, so like the real tinfl it needs no heap and tinfl_init()
+ * can be called on a used decompressor without leaking anything.
+ *
+ * zlib stops at the last deflate byte, but the ROM's tinfl reads ahead: its
+ * fast path loads four input bytes at a time, so when a stream ends, up to
+ * four bytes after it sit in m_bit_buf.  This does the same, so that
+ * gunzip.c's trailer recovery runs on the host too.
+ */
+
+#ifndef HOST_ROM_MINIZ_H_
+#define HOST_ROM_MINIZ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+// inflate state (~7 KB) plus its 32 KB window
+#define TINFL_HOST_ARENA_SIZE (48 * 1024)
+
+typedef struct {
+    int m_state;  // 0: not started, 1: inflating, 2: done
+    mz_uint32 m_num_bits, m_bit_buf;  // read past the end, as by the ROM
+    z_stream zs;
+    size_t arena_used;
+    uint8_t arena[TINFL_HOST_ARENA_SIZE] __attribute__((aligned(16)));
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; (r)->m_num_bits = 0; (r)->m_bit_buf = 0; } while (0)
+
+static inline voidpf tinfl_host_alloc(voidpf opaque, uInt items, uInt size) {
+    tinfl_decompressor *r = (tinfl_decompressor*)opaque;
+    size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+    if (r->arena_used + bytes > sizeof r->arena)
+        return Z_NULL;
+    voidpf p = r->arena + r->arena_used;
+    r->arena_used += bytes;
+    return p;
+}
+
+static inline void tinfl_host_free(voidpf opaque, voidpf address) {
+    (void)opaque; (void)address;  // the whole arena goes at the next tinfl_init
+}
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor *r,
+                                            const mz_uint8 *pIn_buf_next,
+                                            size_t *pIn_buf_size,
+                                            mz_uint8 *pOut_buf_start,
+                                            mz_uint8 *pOut_buf_next,
+                                            size_t *pOut_buf_size,
+                                            const mz_uint32 decomp_flags) {
+    (void)pOut_buf_start;
+    if (r->m_state == 0) {
+        memset(&r->zs, 0, sizeof r->zs);
+        r->zs.zalloc = tinfl_host_alloc;
+        r->zs.zfree = tinfl_host_free;
+        r->zs.opaque = r;
+        r->arena_used = 0;
+        const int window_bits = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (inflateInit2(&r->zs, window_bits) != Z_OK)
+            return TINFL_STATUS_FAILED;
+        r->m_state = 1;
+    }
+    if (r->m_state == 2) {
+        *pIn_buf_size = 0;
+        *pOut_buf_size = 0;
+        return TINFL_STATUS_DONE;
+    }
+
+    r->zs.next_in = (Bytef*)pIn_buf_next;
+    r->zs.avail_in = *pIn_buf_size;
+    r->zs.next_out = pOut_buf_next;
+    r->zs.avail_out = *pOut_buf_size;
+    const int ret = inflate(&r->zs, Z_NO_FLUSH);
+    *pIn_buf_size -= r->zs.avail_in;
+    *pOut_buf_size -= r->zs.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        r->m_state = 2;
+        while (r->zs.avail_in > 0 && r->m_num_bits < 32) {
+            r->m_bit_buf |= (mz_uint32)*r->zs.next_in++ << r->m_num_bits;
+            r->zs.avail_in--;
+            r->m_num_bits += 8;
+            ++*pIn_buf_size;
+        }
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+        return TINFL_STATUS_FAILED;
+    return r->zs.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT
+                                : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+#endif /* HOST_ROM_MINIZ_H_ */
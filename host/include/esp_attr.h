@@ -0,0 +1,15 @@
+/*
+ * esp_attr.h (host)
+ *
+ * Section placement attributes mean nothing on the host.
+ */
+
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif /* HOST_ESP_ATTR_H_ */
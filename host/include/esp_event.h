@@ -0,0 +1,75 @@
+/*
+ * esp_event.h (host)
+ *
+ * The legacy system event loop of ESP-IDF v4.0, with the events the
+ * firmware handles.
+ */
+
+#ifndef HOST_ESP_EVENT_H_
+#define HOST_ESP_EVENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_bit_defs.h"
+#include "tcpip_adapter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SYSTEM_EVENT_WIFI_READY = 0,
+    SYSTEM_EVENT_SCAN_DONE,
+    SYSTEM_EVENT_STA_START,
+    SYSTEM_EVENT_STA_STOP,
+    SYSTEM_EVENT_STA_CONNECTED,
+    SYSTEM_EVENT_STA_DISCONNECTED,
+    SYSTEM_EVENT_STA_AUTHMODE_CHANGE,
+    SYSTEM_EVENT_STA_GOT_IP,
+    SYSTEM_EVENT_STA_LOST_IP,
+    SYSTEM_EVENT_MAX,
+} system_event_id_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int authmode;
+} system_event_sta_connected_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} system_event_sta_disconnected_t;
+
+typedef struct {
+    tcpip_adapter_ip_info_t ip_info;
+    bool ip_changed;
+} system_event_sta_got_ip_t;
+
+typedef union {
+    system_event_sta_connected_t connected;
+    system_event_sta_disconnected_t disconnected;
+    system_event_sta_got_ip_t got_ip;
+} system_event_info_t;
+
+typedef struct {
+    system_event_id_t event_id;
+    system_event_info_t event_info;
+} system_event_t;
+
+typedef esp_err_t (*system_event_cb_t)(void *ctx, system_event_t *event);
+
+// queue an event for the event loop task, which calls the callback
+esp_err_t esp_event_send(system_event_t *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_EVENT_H_ */
@@ -0,0 +1,20 @@
+/*
+ * esp_event_loop.h (host)
+ */
+
+#ifndef HOST_ESP_EVENT_LOOP_H_
+#define HOST_ESP_EVENT_LOOP_H_
+
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_event_loop_init(system_event_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_EVENT_LOOP_H_ */
@@ -0,0 +1,29 @@
+/*
+ * esp_intr.h (host)
+ *
+ * Only the RMT interrupt exists, raised by the RMT model in host/shim/rmt.c.
+ */
+
+#ifndef HOST_ESP_INTR_H_
+#define HOST_ESP_INTR_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ETS_RMT_INTR_SOURCE 47
+
+typedef void (*intr_handler_t)(void *arg);
+typedef struct host_intr *intr_handle_t;
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg,
+                         intr_handle_t *ret_handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_INTR_H_ */
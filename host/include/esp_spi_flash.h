@@ -0,0 +1,21 @@
+/*
+ * esp_spi_flash.h (host)
+ */
+
+#ifndef HOST_ESP_SPI_FLASH_H_
+#define HOST_ESP_SPI_FLASH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// uint32_t rather than size_t, to keep printf formats that fit the ESP32 happy
+uint32_t spi_flash_get_chip_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_SPI_FLASH_H_ */
@@ -0,0 +1,41 @@
+/*
+ * esp_system.h (host)
+ */
+
+#ifndef HOST_ESP_SYSTEM_H_
+#define HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_bit_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP_FEATURE_EMB_FLASH  BIT0
+#define CHIP_FEATURE_WIFI_BGN   BIT1
+#define CHIP_FEATURE_BLE        BIT4
+#define CHIP_FEATURE_BT         BIT5
+
+typedef enum {
+    CHIP_ESP32 = 1,
+} esp_chip_model_t;
+
+typedef struct {
+    esp_chip_model_t model;
+    uint32_t features;
+    uint8_t cores;
+    uint8_t revision;
+} esp_chip_info_t;
+
+void esp_chip_info(esp_chip_info_t *out_info);
+uint32_t esp_random(void);
+void esp_restart(void) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_SYSTEM_H_ */
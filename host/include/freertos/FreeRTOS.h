@@ -0,0 +1,83 @@
+/*
+ * freertos/FreeRTOS.h (host)
+ *
+ * Just enough of the FreeRTOS API for the firmware, on top of POSIX threads.
+ * Every task is a thread, ticks are milliseconds of CLOCK_MONOTONIC since
+ * start (CONFIG_FREERTOS_HZ is 1000 on the device, too).  Priorities are
+ * recorded but not enforced; the Linux scheduler decides.  A task pinned to
+ * core n runs on host CPU n if there is one.
+ * Critical sections are recursive mutexes, which keeps their mutual exclusion
+ * but not their "interrupts off" side effect.  Run time stats count each
+ * task's thread CPU time in microseconds.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;  // stack sizes are in bytes, as in ESP-IDF
+#define portBASE_TYPE int
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define configUSE_TRACE_FACILITY 1
+#define configGENERATE_RUN_TIME_STATS 1
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portNUM_PROCESSORS 2
+#define pdMS_TO_TICKS(ms) ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+// Memory for statically allocated objects, big enough for the shim's own
+// structs (checked in freertos.c)
+typedef struct { void *dummy[24]; } StaticTask_t;
+typedef struct { void *dummy[32]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct { void *dummy[16]; } StaticEventGroup_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+void vPortCPUInitializeMutex(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+
+#define portYIELD_FROM_ISR() ((void)0)
+#define portYIELD() sched_yield()
+
+BaseType_t xPortGetCoreID(void);
+// True in the interrupt handlers the peripheral threads call
+BaseType_t xPortInIsrContext(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_FREERTOS_H_ */
@@ -0,0 +1,45 @@
+/*
+ * freertos/queue.h (host)
+ */
+
+#ifndef HOST_FREERTOS_QUEUE_H_
+#define HOST_FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_queue *QueueHandle_t;
+
+// Generic queue of uxQueueLength items, also the base of the semaphores
+// (item size 0) like in FreeRTOS itself.  uxInitialCount items are in the
+// queue to begin with.
+QueueHandle_t xQueueGenericCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize,
+                                  UBaseType_t uxInitialCount);
+#define xQueueCreate(len, size) xQueueGenericCreate(len, size, 0)
+// The same in caller-provided memory: pucQueueStorage holds the items
+QueueHandle_t xQueueGenericCreateStatic(UBaseType_t uxQueueLength, UBaseType_t uxItemSize,
+                                        UBaseType_t uxInitialCount,
+                                        uint8_t *pucQueueStorage,
+                                        StaticQueue_t *pxStaticQueue);
+#define xQueueCreateStatic(len, size, storage, buffer) \
+    xQueueGenericCreateStatic(len, size, 0, storage, buffer)
+void vQueueDelete(QueueHandle_t xQueue);
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue,
+                      TickType_t xTicksToWait);
+#define xQueueSendToBack xQueueSend
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue,
+                             BaseType_t *pxHigherPriorityTaskWoken);
+// for queues of length one: replace the item if there is one already
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void *pvItemToQueue);
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_FREERTOS_QUEUE_H_ */
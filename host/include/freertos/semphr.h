@@ -0,0 +1,26 @@
+/*
+ * freertos/semphr.h (host)
+ *
+ * Semaphores are queues of zero-sized items.  Mutexes don't do priority
+ * inheritance, priorities don't mean anything on the host anyway.
+ */
+
+#ifndef HOST_FREERTOS_SEMPHR_H_
+#define HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef QueueHandle_t xSemaphoreHandle;
+
+#define xSemaphoreCreateBinary() xQueueGenericCreate(1, 0, 0)
+#define xSemaphoreCreateMutex() xQueueGenericCreate(1, 0, 1)
+#define xSemaphoreCreateCounting(max, initial) xQueueGenericCreate(max, 0, initial)
+#define xSemaphoreCreateBinaryStatic(buffer) xQueueGenericCreateStatic(1, 0, 0, NULL, buffer)
+#define xSemaphoreCreateMutexStatic(buffer) xQueueGenericCreateStatic(1, 0, 1, NULL, buffer)
+#define vSemaphoreDelete(sem) vQueueDelete(sem)
+#define xSemaphoreTake(sem, ticks) xQueueReceive(sem, NULL, ticks)
+#define xSemaphoreGive(sem) xQueueSend(sem, NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken) xQueueSendFromISR(sem, NULL, woken)
+
+#endif /* HOST_FREERTOS_SEMPHR_H_ */
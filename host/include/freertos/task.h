@@ -0,0 +1,89 @@
+/*
+ * freertos/task.h (host)
+ */
+
+#ifndef HOST_FREERTOS_TASK_H_
+#define HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+} eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;
+    StackType_t *pxStackBase;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+// usStackDepth is in bytes, as in ESP-IDF.  Host threads get HOST_STACK_SIZE
+// instead, the firmware's sizes are too tight for glibc and the sanitizers.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName,
+                                   uint32_t usStackDepth, void *pvParameters,
+                                   UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID);
+#define xTaskCreate(code, name, depth, params, prio, handle) \
+    xTaskCreatePinnedToCore(code, name, depth, params, prio, handle, tskNO_AFFINITY)
+
+// The TCB lives in pxTaskBuffer.  The stack buffer is not used, host threads
+// get HOST_STACK_SIZE like all others.
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode, const char *pcName,
+                                           uint32_t ulStackDepth, void *pvParameters,
+                                           UBaseType_t uxPriority,
+                                           StackType_t *pxStackBuffer,
+                                           StaticTask_t *pxTaskBuffer,
+                                           BaseType_t xCoreID);
+#define xTaskCreateStatic(code, name, depth, params, prio, stack, tcb) \
+    xTaskCreateStaticPinnedToCore(code, name, depth, params, prio, stack, tcb, tskNO_AFFINITY)
+
+// only vTaskDelete(NULL) is supported
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+
+void vTaskDelay(TickType_t xTicksToDelay);
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement);
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+char *pcTaskGetTaskName(TaskHandle_t xTaskToQuery);
+
+// Tasks created with xTaskCreate, the thread running app_main isn't one.
+// Host tasks are never blocked as far as these know: the calling task is
+// eRunning, all others are eReady.
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray,
+                                 UBaseType_t uxArraySize, uint32_t *pulTotalRunTime);
+// The device's stack depth minus the most the host thread ever used of its
+// stack, so 0 whenever the host needed at least as much.  x86-64 frames are
+// bigger than Xtensa ones and glibc's stdio is hungrier, so this is a
+// pessimistic estimate.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+
+#define taskYIELD() sched_yield()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_FREERTOS_TASK_H_ */
@@ -0,0 +1,18 @@
+/*
+ * soc/dport_reg.h (host)
+ *
+ * Peripheral clocks and resets are always on / released on the host.
+ */
+
+#ifndef HOST_SOC_DPORT_REG_H_
+#define HOST_SOC_DPORT_REG_H_
+
+#define DPORT_PERIP_CLK_EN_REG 0
+#define DPORT_PERIP_RST_EN_REG 0
+#define DPORT_RMT_CLK_EN (1 << 9)
+#define DPORT_RMT_RST (1 << 9)
+
+#define DPORT_SET_PERI_REG_MASK(reg, mask) ((void)(reg), (void)(mask))
+#define DPORT_CLEAR_PERI_REG_MASK(reg, mask) ((void)(reg), (void)(mask))
+
+#endif /* HOST_SOC_DPORT_REG_H_ */
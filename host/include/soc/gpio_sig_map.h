@@ -0,0 +1,10 @@
+/*
+ * soc/gpio_sig_map.h (host)
+ */
+
+#ifndef HOST_SOC_GPIO_SIG_MAP_H_
+#define HOST_SOC_GPIO_SIG_MAP_H_
+
+#define RMT_SIG_OUT0_IDX 87
+
+#endif /* HOST_SOC_GPIO_SIG_MAP_H_ */
@@ -0,0 +1,108 @@
+/*
+ * soc/rmt_struct.h (host)
+ *
+ * The RMT registers and channel RAM the LED driver touches, laid out like
+ * the real ones as far as the driver can tell.  host/shim/rmt.c plays the
+ * peripheral: it watches tx_start, clocks items out of RMTMEM in real time
+ * and raises the threshold and end interrupts.
+ */
+
+#ifndef HOST_SOC_RMT_STRUCT_H_
+#define HOST_SOC_RMT_STRUCT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile struct {
+    uint32_t data_ch[8];
+    struct {
+        union {
+            struct {
+                uint32_t div_cnt:8;
+                uint32_t idle_thres:16;
+                uint32_t mem_size:4;
+                uint32_t carrier_en:1;
+                uint32_t carrier_out_lv:1;
+                uint32_t mem_pd:1;
+                uint32_t clk_en:1;
+            };
+            uint32_t val;
+        } conf0;
+        union {
+            struct {
+                uint32_t tx_start:1;
+                uint32_t rx_en:1;
+                uint32_t mem_wr_rst:1;
+                uint32_t mem_rd_rst:1;
+                uint32_t apb_mem_rst:1;
+                uint32_t mem_owner:1;
+                uint32_t tx_conti_mode:1;
+                uint32_t rx_filter_en:1;
+                uint32_t rx_filter_thres:8;
+                uint32_t ref_cnt_rst:1;
+                uint32_t ref_always_on:1;
+                uint32_t idle_out_lv:1;
+                uint32_t idle_out_en:1;
+                uint32_t reserved20:12;
+            };
+            uint32_t val;
+        } conf1;
+    } conf_ch[8];
+    struct {
+        uint32_t val;  // bit 3n: ch<n>_tx_end, bit 24 + n: ch<n>_tx_thr_event
+    } int_raw;
+    struct {
+        uint32_t val;
+    } int_st;
+    struct {
+        uint32_t val;
+    } int_ena;
+    struct {
+        uint32_t val;
+    } int_clr;
+    union {
+        struct {
+            uint32_t limit:9;
+            uint32_t reserved9:23;
+        };
+        uint32_t val;
+    } tx_lim_ch[8];
+    union {
+        struct {
+            uint32_t fifo_mask:1;
+            uint32_t mem_tx_wrap_en:1;
+            uint32_t reserved2:30;
+        };
+        uint32_t val;
+    } apb_conf;
+} rmt_dev_t;
+extern rmt_dev_t RMT;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t duration0:15;
+            uint32_t level0:1;
+            uint32_t duration1:15;
+            uint32_t level1:1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+// 64 items per channel block
+typedef volatile struct {
+    struct {
+        rmt_item32_t data32[64];
+    } chan[8];
+} rmt_mem_t;
+extern rmt_mem_t RMTMEM;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_SOC_RMT_STRUCT_H_ */
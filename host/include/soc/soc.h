@@ -0,0 +1,13 @@
+/*
+ * soc/soc.h (host)
+ *
+ * Only the core numbers.
+ */
+
+#ifndef HOST_SOC_SOC_H_
+#define HOST_SOC_SOC_H_
+
+#define PRO_CPU_NUM (0)
+#define APP_CPU_NUM (1)
+
+#endif /* HOST_SOC_SOC_H_ */
@@ -0,0 +1,45 @@
+/*
+ * tcpip_adapter.h (host)
+ */
+
+#ifndef HOST_TCPIP_ADAPTER_H_
+#define HOST_TCPIP_ADAPTER_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef struct {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+typedef enum {
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+} tcpip_adapter_if_t;
+
+void tcpip_adapter_init(void);
+// Without the DHCP client, the station uses the address set with
+// tcpip_adapter_set_ip_info() and reports it as soon as it is associated
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    const tcpip_adapter_ip_info_t *ip_info);
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    tcpip_adapter_ip_info_t *ip_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_TCPIP_ADAPTER_H_ */
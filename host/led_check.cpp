@@ -0,0 +1,239 @@
+/*
+ * led_check.cpp
+ *
+ * Checks the LED driver's SPI encoder against the waveforms in ledParamsAll,
+ * for every type, on test pixels with all bits clear, all set, alternating
+ * and pseudo-random:
+ *
+ *  - bit for bit against a reference that writes each LED bit as its high
+ *    and low time, rounded to whole SPI bits, followed by the reset
+ *  - as a waveform: every high and low time within 150 ns of the type's
+ *    T0H/T0L or T1H/T1L (the datasheets' tolerance), the bits decoded from
+ *    it equal to the pixels, and a reset of at least TRS at the end
+ *  - no byte written past digitalLeds_spiBufferSize()
+ *
+ * and then the backend, on one SPI strand: the bytes on the wire are what
+ * the encoder makes of the pixels, only up to the last changed one, and an
+ * unchanged frame isn't sent.  C++ for ledParamsAll, see
+ * esp32_digital_led_lib.h.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/spi_master.h"
+#include "esp32_digital_led_lib.h"
+
+#include "host.h"
+
+#define CHECK_PIXELS    16
+#define DATASHEET_TOL   150  // ns
+#define CANARY          0xa5
+
+static const char *const type_names[] = {
+    "WS2812_V1", "WS2812B_V1", "WS2812B_V2", "WS2812B_V3", "WS2813_V1",
+    "WS2813_V2", "WS2813_V3", "SK6812_V1", "SK6812W_V1",
+};
+#define NUM_TYPES (sizeof ledParamsAll / sizeof ledParamsAll[0])
+static_assert(sizeof type_names / sizeof type_names[0] == NUM_TYPES, "a name per type");
+
+static int get_bit(const uint8_t *data, size_t i) {
+    return (data[i / 8] >> (7 - i % 8)) & 1;
+}
+
+static void put_bits(uint8_t *data, size_t *pos, int level, uint32_t n) {
+    for (; n; n--, (*pos)++) {
+        if (level)
+            data[*pos / 8] |= 0x80 >> (*pos % 8);
+    }
+}
+
+// Wire order of pixel p, G R B (W), MSB first
+static int pixel_bit(const pixelColor_t *pixels, int width, size_t i) {
+    const pixelColor_t *px = &pixels[i / (8 * width)];
+    const uint8_t bytes[4] = { px->g, px->r, px->b, px->w };
+    return (bytes[i / 8 % width] >> (7 - i % 8)) & 1;
+}
+
+static void fill_pixels(pixelColor_t *pixels, int pattern) {
+    static uint32_t rng = 2463534242u;
+    for (int i = 0; i < CHECK_PIXELS; i++) {
+        switch (pattern) {
+        case 0: pixels[i].num = 0; break;
+        case 1: pixels[i].num = 0xffffffff; break;
+        case 2: pixels[i].num = i & 1 ? 0x55aa55aa : 0xaa55aa55; break;
+        default:
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            pixels[i].num = rng;
+        }
+    }
+}
+#define NUM_PATTERNS 8
+
+// Returns the number of failures
+static int check_type(int type) {
+    const ledParams_t *p = &ledParamsAll[type];
+    const uint32_t clock = digitalLeds_spiClockHz(type);
+    if (!clock) {
+        printf("%-11s not in DIGITALLEDS_TYPES\n", type_names[type]);
+        return 0;
+    }
+    // the clock is 80 MHz / divider, so a slot is a multiple of 12.5 ns
+    const uint32_t divider = (80000000 + clock / 2) / clock;
+    const double slot_ns = 12.5 * divider;
+    const int width = p->bytesPerPixel;
+    const size_t size = digitalLeds_spiBufferSize(type, CHECK_PIXELS);
+    uint8_t *out = (uint8_t *)malloc(size + 16);
+    uint8_t *ref = (uint8_t *)calloc(size + 16, 1);
+    pixelColor_t pixels[CHECK_PIXELS];
+    const uint32_t high[2] = { (uint32_t)(p->T0H / slot_ns + 0.5), (uint32_t)(p->T1H / slot_ns + 0.5) };
+    const uint32_t low[2] = { (uint32_t)(p->T0L / slot_ns + 0.5), (uint32_t)(p->T1L / slot_ns + 0.5) };
+    int failures = 0;
+    double worst = 0;
+
+    for (int pattern = 0; pattern < NUM_PATTERNS; pattern++) {
+        fill_pixels(pixels, pattern);
+        memset(out, CANARY, size + 16);
+        const size_t len = digitalLeds_encodeSpi(type, pixels, CHECK_PIXELS, out);
+        const size_t data_bits = (size_t)CHECK_PIXELS * width * 8;
+
+        // the reference
+        memset(ref, 0, size + 16);
+        size_t pos = 0;
+        for (size_t i = 0; i < data_bits; i++) {
+            const int bit = pixel_bit(pixels, width, i);
+            put_bits(ref, &pos, 1, high[bit] ? high[bit] : 1);
+            put_bits(ref, &pos, 0, low[bit] ? low[bit] : 1);
+        }
+        const size_t reset_bits = (size_t)ceil(p->TRS / slot_ns);
+        const size_t ref_len = (pos + reset_bits + 7) / 8;
+
+        if (len > size || out[size] != CANARY) {
+            printf("%-11s pattern %d: %zu bytes, past the buffer of %zu\n",
+                   type_names[type], pattern, len, size);
+            failures++;
+            continue;
+        }
+        if (len != ref_len || memcmp(out, ref, len) != 0) {
+            size_t i = 0;
+            while (i < len * 8 && i < ref_len * 8 && get_bit(out, i) == get_bit(ref, i))
+                i++;
+            printf("%-11s pattern %d: %zu bytes, expected %zu, first difference at bit %zu\n",
+                   type_names[type], pattern, len, ref_len, i);
+            failures++;
+            continue;
+        }
+
+        // the waveform
+        size_t i = 0, bit = 0;
+        while (i < len * 8 && bit < data_bits) {
+            size_t h = 0, l = 0;
+            while (i < len * 8 && get_bit(out, i)) {
+                h++;
+                i++;
+            }
+            while (i < len * 8 && !get_bit(out, i)) {
+                l++;
+                i++;
+            }
+            const int expected = pixel_bit(pixels, width, bit);
+            const double high_ns = h * slot_ns, low_ns = l * slot_ns;
+            // the closer high time decides what the LED reads
+            const int decoded = fabs(high_ns - p->T1H) < fabs(high_ns - p->T0H);
+            const double high_err = fabs(high_ns - (expected ? p->T1H : p->T0H));
+            // the last low time is the reset
+            const double low_err = bit + 1 == data_bits ? 0 : fabs(low_ns - (expected ? p->T1L : p->T0L));
+            worst = fmax(worst, fmax(high_err, low_err));
+            if (decoded != expected || high_err > DATASHEET_TOL || low_err > DATASHEET_TOL) {
+                printf("%-11s pattern %d bit %zu: %d sent as %.1f ns high, %.1f ns low\n",
+                       type_names[type], pattern, bit, expected, high_ns, low_ns);
+                failures++;
+                break;
+            }
+            if (bit + 1 == data_bits && low_ns < p->TRS) {
+                printf("%-11s pattern %d: reset of %.1f us, needs %.1f\n", type_names[type],
+                       pattern, low_ns / 1000, p->TRS / 1000.0);
+                failures++;
+            }
+            bit++;
+        }
+        if (bit != data_bits) {
+            printf("%-11s pattern %d: %zu of %zu bits on the wire\n", type_names[type],
+                   pattern, bit, data_bits);
+            failures++;
+        }
+    }
+
+    printf("%-11s %6.3f MHz  0: %u+%u  1: %u+%u bits  %5.1f bytes/pixel  worst %3.0f ns  %s\n",
+           type_names[type], clock / 1e6, high[0], low[0], high[1], low[1],
+           (high[0] + low[0] + high[1] + low[1]) * width / 2.0, worst,
+           failures ? "FAIL" : "ok");
+    free(out);
+    free(ref);
+    return failures;
+}
+
+// The backend: what goes out on the wire for a strand
+static int check_strand() {
+    static pixelColor_t pixels[CHECK_PIXELS];
+    static strand_t strand;
+    strand.spiHost = HSPI_HOST;
+    strand.gpioNum = 13;
+    strand.ledType = LED_SK6812W_V1;
+    strand.numPixels = CHECK_PIXELS;
+    strand.pixels = pixels;
+    if (digitalLeds_initStrands(&strand, 1)) {
+        printf("strand: init failed\n");
+        return 1;
+    }
+
+    const size_t size = digitalLeds_spiBufferSize(strand.ledType, CHECK_PIXELS);
+    uint8_t *expected = (uint8_t *)malloc(size);
+    const uint8_t *wire;
+    size_t bits, len;
+    int failures = 0;
+
+    // init sends all pixels, off
+    digitalLeds_waitIdle(&strand);
+    int sent = host_spi_wire(HSPI_HOST, &wire, &bits);
+    len = digitalLeds_encodeSpi(strand.ledType, pixels, CHECK_PIXELS, expected);
+    if (sent != 1 || bits != len * 8 || memcmp(wire, expected, len) != 0) {
+        printf("strand: reset frame differs from the encoder's\n");
+        failures++;
+    }
+
+    // a change in the middle sends the pixels up to it
+    digitalLeds_setPixel(&strand, 5, pixelFromRGBW(1, 2, 3, 4));
+    digitalLeds_updatePixels(&strand);
+    digitalLeds_waitIdle(&strand);
+    host_spi_wire(HSPI_HOST, &wire, &bits);
+    len = digitalLeds_encodeSpi(strand.ledType, pixels, 6, expected);
+    if (bits != len * 8 || memcmp(wire, expected, len) != 0) {
+        printf("strand: %zu bits for a change of pixel 5, expected %zu\n", bits, len * 8);
+        failures++;
+    }
+
+    // nothing changed, nothing sent
+    digitalLeds_updatePixels(&strand);
+    digitalLeds_waitIdle(&strand);
+    if (host_spi_wire(HSPI_HOST, &wire, &bits) != sent + 1) {
+        printf("strand: unchanged frame sent\n");
+        failures++;
+    }
+
+    printf("strand      %s\n", failures ? "FAIL" : "ok");
+    free(expected);
+    return failures;
+}
+
+extern "C" int led_check_run() {
+    int failures = 0;
+    for (size_t type = 0; type < NUM_TYPES; type++)
+        failures += check_type(type);
+    failures += check_strand();
+    return failures;
+}
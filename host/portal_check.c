@@ -0,0 +1,134 @@
+/*
+ * portal_check.c
+ *
+ * Checks the captive portal scanner (main/portal_scan.h) on the saved
+ * KA-WLAN pages in host/portal.  Each page is fed to portal_scan_feed()
+ *
+ *  - in chunks of every size from 1 to CHECK_MAX_CHUNK bytes, so that each
+ *    needle straddles a chunk boundary at every offset,
+ *  - and in two chunks split in the middle of every needle occurrence,
+ *
+ * and every time the result and the extracted fields must be the expected
+ * ones.  The scan must also stop early: the result is final in the chunk
+ * holding the page's stop marker (the end of the last field it needs, or
+ * of the "logged in" text), and feeding the rest of the page changes
+ * nothing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "portal_scan.h"
+
+#define CHECK_MAX_CHUNK 80
+#define PAGE_MAX 8192
+
+typedef struct {
+    const char *file;
+    portal_result_t result;
+    const char *username, *password;
+    const char *stop;  // the scan is done right after the first occurrence
+} page_check_t;
+
+static const page_check_t pages[] = {
+    { "login.html", PORTAL_FORM, "24:0a:c4:13:37:42", "b5e1c0ffee",
+      "value=\"b5e1c0ffee\"" },
+    { "logged_in.html", PORTAL_LOGGED_IN, "", "", "eingeloggt." },
+    { "login_reordered.html", PORTAL_FORM, "24:0a:c4:13:37:42",
+      "0123456789abcdef0123456789abcde", "value=\"24:0a:c4:13:37:42" },
+    { "login_long_password.html", PORTAL_FORM, "24:0a:c4:13:37:42", "b5e1c0ffee",
+      "value=\"b5e1c0ffee\"" },
+    { "other.html", PORTAL_SCANNING, "", "", NULL },
+};
+#define NUM_PAGES (sizeof pages / sizeof pages[0])
+
+// where the needles of portal_scan.c begin, for the splits in the middle
+static const char *const needle_starts[] = {
+    "Sie sind", "<input type=\"hidden\" name=\"username\"",
+    "<input type=\"hidden\" name=\"password\"",
+};
+#define NUM_NEEDLES (sizeof needle_starts / sizeof needle_starts[0])
+
+static int load(const char *file, char *page) {
+    char path[512];
+    snprintf(path, sizeof path, "%s/%s", PORTAL_PAGES_DIR, file);
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "portal check: can't open %s\n", path);
+        return -1;
+    }
+    const int len = fread(page, 1, PAGE_MAX, f);
+    fclose(f);
+    return len;
+}
+
+// Feed the page in the chunks that end at cuts[0..ncuts-1] and at len.
+// Returns 0 if the scan came out as expected.
+static int scan_page(const page_check_t *c, const char *page, int len, const int *cuts,
+                     int ncuts, const char *how) {
+    const char *marker = c->stop ? strstr(page, c->stop) : NULL;
+    const int stop = marker ? (int)(marker - page + strlen(c->stop)) : len;
+    portal_scan_t s;
+    portal_scan_init(&s);
+
+    int from = 0, failed = 0;
+    for (int i = 0; i <= ncuts && !failed; i++) {
+        const int to = i < ncuts ? cuts[i] : len;
+        const portal_result_t r = portal_scan_feed(&s, page + from, to - from);
+        // the chunk with the stop marker's end, or any later one, has the
+        // result; none before it has
+        const int done = to >= stop && c->result != PORTAL_SCANNING;
+        if (done != (r != PORTAL_SCANNING)) {
+            fprintf(stderr, "portal check: %s, %s: result %d after byte %d, "
+                    "expected it from byte %d\n", c->file, how, r, to, stop);
+            failed = 1;
+        }
+        from = to;
+    }
+    if (!failed && (s.result != c->result || strcmp(s.username, c->username) ||
+                    strcmp(s.password, c->password))) {
+        fprintf(stderr, "portal check: %s, %s: got %d \"%s\" \"%s\"\n", c->file, how,
+                s.result, s.username, s.password);
+        failed = 1;
+    }
+    return failed;
+}
+
+int portal_check_run(void) {
+    static char page[PAGE_MAX + 1];
+    static int cuts[PAGE_MAX];
+    int failures = 0, scans = 0;
+
+    for (size_t p = 0; p < NUM_PAGES; p++) {
+        const page_check_t *c = &pages[p];
+        const int len = load(c->file, page);
+        if (len < 0)
+            return 1;
+        page[len] = 0;
+
+        for (int chunk = 1; chunk <= CHECK_MAX_CHUNK; chunk++) {
+            char how[32];
+            int ncuts = 0;
+            for (int at = chunk; at < len; at += chunk)
+                cuts[ncuts++] = at;
+            snprintf(how, sizeof how, "%d byte chunks", chunk);
+            failures += scan_page(c, page, len, cuts, ncuts, how);
+            scans++;
+        }
+
+        for (size_t n = 0; n < NUM_NEEDLES; n++) {
+            for (const char *at = strstr(page, needle_starts[n]); at;
+                 at = strstr(at + 1, needle_starts[n])) {
+                char how[32];
+                cuts[0] = at - page + strlen(needle_starts[n]) / 2;
+                snprintf(how, sizeof how, "split at byte %d", cuts[0]);
+                failures += scan_page(c, page, len, cuts, 1, how);
+                scans++;
+            }
+        }
+    }
+
+    printf("portal check: %zu pages, %d scans, %d failed\n", NUM_PAGES, scans, failures);
+    return failures != 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * restore_check.c
+ *
+ * Checks how quotes restored from NVS (main/quote_store.h) give way to
+ * fetched ones when the first response after a reboot has only some of the
+ * watched pairs:
+ *
+ *  - a boot fetches all pairs twice, samples only the first response into
+ *    the history and saves the second,
+ *  - the next boot restores them, all stale, and its first response has
+ *    one pair only,
+ *
+ * after which that pair must be fetched and not stale, the others still
+ * the restored prices and stale, the history must have the fetched price
+ * and not the restored ones, and a third boot must restore the new price
+ * next to the old ones.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs_flash.h"
+
+#include "quote_store.h"
+#include "quotes.h"
+
+static const char *const watchlist[] = { "EUR/USD", "USD/JPY", "GBP/USD" };
+#define WATCH_LEN (sizeof watchlist / sizeof watchlist[0])
+
+// Responses in the feed format of quotes.h
+static const char full_feed[] =
+    "EUR/USDUSD/JPYGBP/USD"
+    "1.14110.1.30" "096123456"
+    "1.14110.1.30" "099126459\n";
+static const char moved_feed[] =
+    "EUR/USDUSD/JPYGBP/USD"
+    "1.14110.1.30" "096987456"
+    "1.14110.1.30" "099990459\n";
+static const char partial_feed[] =
+    "EUR/USD"
+    "1.15" "000"
+    "1.15" "003\n";
+
+static int failures;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "restore check: %s\n", what);
+        failures++;
+    }
+}
+
+static int fetch(quote_book_t *book, const char *feed) {
+    static quote_parser_t parser;
+    quote_parser_init(&parser, watchlist, WATCH_LEN);
+    quote_parser_feed(&parser, feed, strlen(feed));
+    return quote_parser_finish(&parser, book);
+}
+
+static int32_t last_sample(int slot) {
+    int32_t mids[QUOTE_HISTORY_LEN];
+    const int n = quote_history_get(slot, mids, QUOTE_HISTORY_LEN);
+    return n ? mids[n - 1] : 0;
+}
+
+int restore_check_run(void) {
+    static quote_book_t book;
+    nvs_flash_init();
+
+    // first boot: everything fetched and saved, the history a response
+    // behind the quotes (USD/JPY moved in between)
+    quote_store_init(0, 0);
+    quotes_book_init(&book, watchlist, WATCH_LEN);
+    quote_store_load(&book);
+    expect(fetch(&book, full_feed) == 3, "full response: 3 pairs expected");
+    quote_store_update(&book);
+    const int32_t old_mid = quote_mid_points(&book.q[1]);
+    quote_store_init(3600 * 1000, 0);
+    fetch(&book, moved_feed);
+    quote_store_update(&book);
+    quote_store_init(0, 0);
+
+    // second boot: restored, then a response with EUR/USD only
+    quotes_book_init(&book, watchlist, WATCH_LEN);
+    expect(quote_store_load(&book) == 3, "3 quotes restored expected");
+    expect(book.stale && book.q[0].stale && book.q[1].stale && book.q[2].stale,
+           "restored quotes not stale");
+    expect(fetch(&book, partial_feed) == 1, "partial response: 1 pair expected");
+    expect(!book.stale, "book stale after a fetch");
+    expect(!book.q[0].stale && !strcmp(book.q[0].bid, "1.15000"),
+           "EUR/USD not fetched from the partial response");
+    expect(book.q[1].stale && !strcmp(book.q[1].bid, "110.987"),
+           "USD/JPY lost its stale mark or restored price");
+    expect(book.q[2].stale && !strcmp(book.q[2].bid, "1.30456"),
+           "GBP/USD lost its stale mark or restored price");
+    expect(quotes_any_stale(&book), "book without stale quotes");
+    quote_store_update(&book);
+    expect(last_sample(0) == quote_mid_points(&book.q[0]), "EUR/USD not sampled");
+    // the restored USD/JPY isn't a price of this boot
+    expect(last_sample(1) == old_mid, "restored USD/JPY sampled into the history");
+
+    // third boot: the fetched price and the older ones
+    quotes_book_init(&book, watchlist, WATCH_LEN);
+    expect(quote_store_load(&book) == 3, "3 quotes restored again expected");
+    expect(!strcmp(book.q[0].bid, "1.15000") && !strcmp(book.q[1].bid, "110.987"),
+           "wrong prices restored after the partial fetch");
+
+    printf("restore check: %d failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,551 @@
+/*
+ * freertos.c
+ *
+ * FreeRTOS tasks, queues, semaphores and event groups on POSIX threads,
+ * see include/freertos/FreeRTOS.h
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+
+#include "host.h"
+
+/*** Time *********************************************************************/
+
+static struct timespec boot_time;
+
+__attribute__((constructor)) static void clock_init() {
+    clock_gettime(CLOCK_MONOTONIC, &boot_time);
+}
+
+int64_t host_time_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - boot_time.tv_sec) * 1000000LL +
+           (now.tv_nsec - boot_time.tv_nsec) / 1000;
+}
+
+// CLOCK_MONOTONIC time of the given microsecond since boot
+static struct timespec abs_time_us(int64_t us) {
+    struct timespec t = boot_time;
+    t.tv_sec += us / 1000000;
+    t.tv_nsec += (us % 1000000) * 1000;
+    if (t.tv_nsec >= 1000000000) {
+        t.tv_sec++;
+        t.tv_nsec -= 1000000000;
+    }
+    return t;
+}
+
+void host_sleep_until_us(int64_t us) {
+    struct timespec t = abs_time_us(us);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+        ;
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(host_time_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+TickType_t xTaskGetTickCountFromISR() {
+    return xTaskGetTickCount();
+}
+
+// absolute deadline for a wait of `ticks` from now
+static struct timespec deadline_after(TickType_t ticks) {
+    return abs_time_us(host_time_us() + (int64_t)ticks * (1000000 / configTICK_RATE_HZ));
+}
+
+static pthread_cond_t *cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return cond;
+}
+
+// Wait on cond until woken or the deadline passes, returns 0 on timeout
+static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                     TickType_t ticks, const struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, mutex);
+        return 1;
+    }
+    return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+/*** Tasks ********************************************************************/
+
+// Stack of every task thread.  The part below the entry frame is painted
+// with STACK_PAINT, like FreeRTOS does, to find the high water mark.
+#define HOST_STACK_SIZE (256 * 1024)
+#define STACK_PAINT 0xa5
+// left alone below the entry frame while painting, for the painting itself
+#define STACK_PAINT_MARGIN 1024
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *params;
+    char name[16];
+    uint32_t stack_depth;
+    UBaseType_t priority;
+    BaseType_t core;
+    UBaseType_t number;
+    int is_static;  // TCB is caller memory, don't free it
+    uint8_t *stack_low, *stack_entry;  // painted from low up to entry
+    struct host_task *next;
+};
+
+_Static_assert(sizeof(struct host_task) <= sizeof(StaticTask_t), "StaticTask_t too small");
+
+static __thread struct host_task *current_task;
+
+// all live tasks, for uxTaskGetSystemState
+static pthread_mutex_t tasks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *tasks;
+static UBaseType_t task_count, task_numbers;
+
+// Reads and writes other frames' memory, which the sanitizer would flag
+__attribute__((no_sanitize_address, noinline))
+static void stack_paint(struct host_task *task) {
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+    pthread_getattr_np(pthread_self(), &attr);
+    pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+
+    uint8_t *entry = (uint8_t *)__builtin_frame_address(0) - STACK_PAINT_MARGIN;
+    // volatile so that this stays a loop rather than a call to memset
+    for (volatile uint8_t *p = addr; p < entry; p++)
+        *p = STACK_PAINT;
+    task->stack_low = addr;
+    task->stack_entry = entry;
+}
+
+__attribute__((no_sanitize_address))
+static size_t stack_used(const struct host_task *task) {
+    const volatile uint8_t *p = task->stack_low;
+    while (p < task->stack_entry && *p == STACK_PAINT)
+        p++;
+    return task->stack_entry - p;
+}
+
+static void *task_main(void *arg) {
+    current_task = arg;
+    stack_paint(current_task);
+    current_task->code(current_task->params);
+    // FreeRTOS tasks must not return, but be lenient
+    fprintf(stderr, "task %s returned\n", current_task->name);
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+// Register and start an initialised TCB
+static BaseType_t task_start(struct host_task *task) {
+    pthread_mutex_lock(&tasks_mutex);
+    task->number = ++task_numbers;
+    task->next = tasks;
+    tasks = task;
+    task_count++;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, HOST_STACK_SIZE);
+    // Pinned tasks go to the host CPU of the same number, if the process may
+    // use it, so that two tasks pinned to one core compete for it as on the
+    // device
+    cpu_set_t cpus;
+    if (task->core != tskNO_AFFINITY && task->core < CPU_SETSIZE &&
+        sched_getaffinity(0, sizeof cpus, &cpus) == 0 && CPU_ISSET(task->core, &cpus)) {
+        CPU_ZERO(&cpus);
+        CPU_SET(task->core, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof cpus, &cpus);
+    }
+    int err = pthread_create(&task->thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        tasks = task->next;
+        task_count--;
+        pthread_mutex_unlock(&tasks_mutex);
+        return pdFAIL;
+    }
+    pthread_mutex_unlock(&tasks_mutex);
+    // thread names are limited to 15 characters
+    pthread_setname_np(task->thread, task->name);
+    return pdPASS;
+}
+
+static void task_init(struct host_task *task, TaskFunction_t code, const char *name,
+                      uint32_t stack_depth, void *params, UBaseType_t priority,
+                      BaseType_t core) {
+    memset(task, 0, sizeof *task);
+    task->code = code;
+    task->params = params;
+    snprintf(task->name, sizeof task->name, "%s", name);
+    task->stack_depth = stack_depth;
+    task->priority = priority;
+    task->core = core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName,
+                                   uint32_t usStackDepth, void *pvParameters,
+                                   UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID) {
+    struct host_task *task = malloc(sizeof *task);
+    if (!task)
+        return pdFAIL;
+    task_init(task, pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, xCoreID);
+    if (task_start(task) != pdPASS) {
+        free(task);
+        return pdFAIL;
+    }
+    if (pvCreatedTask)
+        *pvCreatedTask = task;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode, const char *pcName,
+                                           uint32_t ulStackDepth, void *pvParameters,
+                                           UBaseType_t uxPriority,
+                                           StackType_t *pxStackBuffer,
+                                           StaticTask_t *pxTaskBuffer,
+                                           BaseType_t xCoreID) {
+    struct host_task *task = (struct host_task *)pxTaskBuffer;
+    task_init(task, pvTaskCode, pcName, ulStackDepth, pvParameters, uxPriority, xCoreID);
+    task->is_static = 1;
+    return task_start(task) == pdPASS ? task : NULL;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+    if (xTaskToDelete && xTaskToDelete != current_task) {
+        fprintf(stderr, "vTaskDelete: deleting other tasks is not supported\n");
+        abort();
+    }
+    if (current_task) {
+        pthread_mutex_lock(&tasks_mutex);
+        for (struct host_task **t = &tasks; *t; t = &(*t)->next) {
+            if (*t == current_task) {
+                *t = current_task->next;
+                task_count--;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&tasks_mutex);
+    }
+    // like the idle task would, free the TCB; the handle is invalid from now on
+    if (current_task && !current_task->is_static)
+        free(current_task);
+    current_task = NULL;
+    pthread_exit(NULL);
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    pthread_mutex_lock(&tasks_mutex);
+    UBaseType_t count = task_count;
+    pthread_mutex_unlock(&tasks_mutex);
+    return count;
+}
+
+// CPU time of a live task's thread in microseconds, wrapping like the device's
+static uint32_t task_runtime(const struct host_task *task) {
+    clockid_t clock;
+    struct timespec t;
+    if (pthread_getcpuclockid(task->thread, &clock) || clock_gettime(clock, &t))
+        return 0;
+    return (uint32_t)(t.tv_sec * 1000000ULL + t.tv_nsec / 1000);
+}
+
+static UBaseType_t high_water_mark(const struct host_task *task) {
+    const size_t used = stack_used(task);
+    return used < task->stack_depth ? task->stack_depth - used : 0;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pxTaskStatusArray,
+                                 UBaseType_t uxArraySize, uint32_t *pulTotalRunTime) {
+    pthread_mutex_lock(&tasks_mutex);
+    UBaseType_t n = 0;
+    if (task_count <= uxArraySize) {
+        // tasks was built by prepending, report them oldest first
+        n = task_count;
+        UBaseType_t i = n;
+        for (struct host_task *task = tasks; task; task = task->next) {
+            TaskStatus_t *s = &pxTaskStatusArray[--i];
+            s->xHandle = task;
+            s->pcTaskName = task->name;
+            s->xTaskNumber = task->number;
+            s->eCurrentState = task == current_task ? eRunning : eReady;
+            s->uxCurrentPriority = s->uxBasePriority = task->priority;
+            s->ulRunTimeCounter = task_runtime(task);
+            s->pxStackBase = task->stack_low;
+            s->usStackHighWaterMark = high_water_mark(task);
+            s->xCoreID = task->core;
+        }
+    }
+    pthread_mutex_unlock(&tasks_mutex);
+    if (pulTotalRunTime)
+        *pulTotalRunTime = (uint32_t)host_time_us();
+    return n;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+    const struct host_task *task = xTask ? xTask : current_task;
+    return task ? high_water_mark(task) : 0;
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    host_sleep_until_us(host_time_us() +
+                        (int64_t)xTicksToDelay * (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement) {
+    const TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+    *pxPreviousWakeTime = wake;
+    // like FreeRTOS, don't sleep if the wake time has passed already
+    if ((int32_t)(wake - xTaskGetTickCount()) > 0)
+        host_sleep_until_us((int64_t)wake * (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current_task;
+}
+
+char *pcTaskGetTaskName(TaskHandle_t xTaskToQuery) {
+    struct host_task *task = xTaskToQuery ? xTaskToQuery : current_task;
+    static char main_name[] = "main";
+    return task ? task->name : main_name;
+}
+
+BaseType_t xPortGetCoreID() {
+    return 0;
+}
+
+static __thread int in_isr;
+
+void host_isr_enter() {
+    in_isr++;
+}
+
+void host_isr_exit() {
+    in_isr--;
+}
+
+BaseType_t xPortInIsrContext() {
+    return in_isr > 0;
+}
+
+void vPortCPUInitializeMutex(portMUX_TYPE *mux) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mux->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/*** Queues *******************************************************************/
+
+struct host_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty, not_full;
+    UBaseType_t length, item_size;
+    UBaseType_t head, count;
+    uint8_t *items;
+    int is_static;
+};
+
+_Static_assert(sizeof(struct host_queue) <= sizeof(StaticQueue_t), "StaticQueue_t too small");
+
+static void queue_init(struct host_queue *q, UBaseType_t length, UBaseType_t item_size,
+                       UBaseType_t initial_count, uint8_t *items) {
+    pthread_mutex_init(&q->mutex, NULL);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    q->length = length;
+    q->item_size = item_size;
+    q->count = initial_count;
+    q->items = items;
+}
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize,
+                                  UBaseType_t uxInitialCount) {
+    struct host_queue *q = calloc(1, sizeof *q + uxQueueLength * uxItemSize);
+    if (!q)
+        return NULL;
+    queue_init(q, uxQueueLength, uxItemSize, uxInitialCount, (uint8_t*)(q + 1));
+    return q;
+}
+
+QueueHandle_t xQueueGenericCreateStatic(UBaseType_t uxQueueLength, UBaseType_t uxItemSize,
+                                        UBaseType_t uxInitialCount,
+                                        uint8_t *pucQueueStorage,
+                                        StaticQueue_t *pxStaticQueue) {
+    struct host_queue *q = (struct host_queue *)pxStaticQueue;
+    memset(q, 0, sizeof *q);
+    queue_init(q, uxQueueLength, uxItemSize, uxInitialCount, pucQueueStorage);
+    q->is_static = 1;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    if (!q->is_static)
+        free(q);
+}
+
+static void queue_push(struct host_queue *q, const void *item) {
+    if (q->item_size) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->items + tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *pvItemToQueue,
+                      TickType_t xTicksToWait) {
+    const struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->length) {
+        if (xTicksToWait == 0 ||
+            !cond_wait(&q->not_full, &q->mutex, xTicksToWait, &deadline)) {
+            pthread_mutex_unlock(&q->mutex);
+            return pdFAIL;
+        }
+    }
+    queue_push(q, pvItemToQueue);
+    pthread_mutex_unlock(&q->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *pvItemToQueue,
+                             BaseType_t *pxHigherPriorityTaskWoken) {
+    if (pxHigherPriorityTaskWoken)
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    return xQueueSend(q, pvItemToQueue, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *pvItemToQueue) {
+    pthread_mutex_lock(&q->mutex);
+    q->count = 0;
+    q->head = 0;
+    queue_push(q, pvItemToQueue);
+    pthread_mutex_unlock(&q->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *pvBuffer, TickType_t xTicksToWait) {
+    const struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0) {
+        if (xTicksToWait == 0 ||
+            !cond_wait(&q->not_empty, &q->mutex, xTicksToWait, &deadline)) {
+            pthread_mutex_unlock(&q->mutex);
+            return pdFAIL;
+        }
+    }
+    if (q->item_size)
+        memcpy(pvBuffer, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->mutex);
+    return count;
+}
+
+/*** Event groups *************************************************************/
+
+struct host_event_group {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    EventBits_t bits;
+    int is_static;
+};
+
+_Static_assert(sizeof(struct host_event_group) <= sizeof(StaticEventGroup_t),
+               "StaticEventGroup_t too small");
+
+EventGroupHandle_t xEventGroupCreate() {
+    struct host_event_group *g = calloc(1, sizeof *g);
+    if (!g)
+        return NULL;
+    pthread_mutex_init(&g->mutex, NULL);
+    cond_init(&g->changed);
+    return g;
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *pxEventGroupBuffer) {
+    struct host_event_group *g = (struct host_event_group *)pxEventGroupBuffer;
+    memset(g, 0, sizeof *g);
+    pthread_mutex_init(&g->mutex, NULL);
+    cond_init(&g->changed);
+    g->is_static = 1;
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g) {
+    pthread_mutex_destroy(&g->mutex);
+    pthread_cond_destroy(&g->changed);
+    if (!g->is_static)
+        free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, const EventBits_t uxBitsToSet) {
+    pthread_mutex_lock(&g->mutex);
+    g->bits |= uxBitsToSet;
+    EventBits_t bits = g->bits;
+    pthread_cond_broadcast(&g->changed);
+    pthread_mutex_unlock(&g->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, const EventBits_t uxBitsToClear) {
+    pthread_mutex_lock(&g->mutex);
+    EventBits_t bits = g->bits;
+    g->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&g->mutex);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit,
+                                const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait) {
+    const struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&g->mutex);
+    while (1) {
+        const EventBits_t set = g->bits & uxBitsToWaitFor;
+        if (xWaitForAllBits ? set == uxBitsToWaitFor : set != 0) {
+            EventBits_t bits = g->bits;
+            if (xClearOnExit)
+                g->bits &= ~uxBitsToWaitFor;
+            pthread_mutex_unlock(&g->mutex);
+            return bits;
+        }
+        if (xTicksToWait == 0 ||
+            !cond_wait(&g->changed, &g->mutex, xTicksToWait, &deadline))
+            break;
+    }
+    EventBits_t bits = g->bits;
+    pthread_mutex_unlock(&g->mutex);
+    return bits;
+}
@@ -0,0 +1,124 @@
+/*
+ * heap.c
+ *
+ * Heap accounting for the host build.  The executable is linked with
+ * --wrap for malloc, calloc, realloc and free, so every allocation made by
+ * the firmware and the shims (but not by libc or zlib internally) passes
+ * through here.  Live bytes are subtracted from a nominal heap the size of
+ * what the ESP32 leaves for it, which gives free and minimum-ever free sizes
+ * that move like the device's.  The absolute numbers differ, 64-bit pointers
+ * and glibc's allocator make everything a little bigger.  There is no
+ * fragmentation model, the largest free block is all of the free heap.
+ * Allocations are also counted, and can be hooked to find out who makes them.
+ * The ones a shim makes where the ESP-IDF driver allocates on the device too
+ * (between host_heap_driver_enter() and _exit()) are counted apart instead.
+ */
+
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
+
+#include "host.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t live_bytes, peak_bytes;
+static uint64_t allocs, driver_allocs;
+static host_alloc_hook_t alloc_hook;
+static __thread int in_driver;
+
+void host_heap_set_hook(host_alloc_hook_t hook) {
+    __atomic_store_n(&alloc_hook, hook, __ATOMIC_RELEASE);
+}
+
+uint64_t host_heap_allocs() {
+    return __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+}
+
+void host_heap_driver_enter() {
+    in_driver++;
+}
+
+void host_heap_driver_exit() {
+    in_driver--;
+}
+
+uint64_t host_heap_driver_allocs() {
+    return __atomic_load_n(&driver_allocs, __ATOMIC_RELAXED);
+}
+
+static void account_alloc(void *ptr) {
+    if (!ptr)
+        return;
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    host_alloc_hook_t hook = __atomic_load_n(&alloc_hook, __ATOMIC_ACQUIRE);
+    if (in_driver)
+        __atomic_add_fetch(&driver_allocs, 1, __ATOMIC_RELAXED);
+    else if (hook)
+        hook(malloc_usable_size(ptr));
+    const size_t live = __atomic_add_fetch(&live_bytes, malloc_usable_size(ptr),
+                                           __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&peak_bytes, &peak, live, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void account_free(void *ptr) {
+    if (ptr)
+        __atomic_sub_fetch(&live_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    account_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    void *ptr = __real_calloc(nmemb, size);
+    account_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    account_free(ptr);
+    void *res = __real_realloc(ptr, size);
+    // a failed realloc leaves the old block alone
+    account_alloc(res ? res : (size ? ptr : NULL));
+    return res;
+}
+
+void __wrap_free(void *ptr) {
+    account_free(ptr);
+    __real_free(ptr);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+static size_t free_of(size_t used) {
+    return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return free_of(__atomic_load_n(&live_bytes, __ATOMIC_RELAXED));
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return free_of(__atomic_load_n(&peak_bytes, __ATOMIC_RELAXED));
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
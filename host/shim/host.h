@@ -0,0 +1,82 @@
+/*
+ * host.h
+ *
+ * Knobs and helpers of the host shim that the ESP-IDF API has no place for.
+ * Only host code (host_main.c and the shim itself) includes this.
+ */
+
+#ifndef HOST_SHIM_HOST_H_
+#define HOST_SHIM_HOST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// microseconds since start, the base of ticks and esp_timer_get_time()
+int64_t host_time_us(void);
+void host_sleep_until_us(int64_t us);
+
+// Nominal heap of the device, roughly what is left after Wi-Fi is up.
+// Free sizes reported on the host are this minus what is allocated (heap.c).
+#define HOST_HEAP_SIZE (200 * 1024)
+
+// Called on every allocation with its size, in the allocating thread
+typedef void (*host_alloc_hook_t)(size_t size);
+void host_heap_set_hook(host_alloc_hook_t hook);
+// Allocations so far
+uint64_t host_heap_allocs(void);
+// Around allocations the ESP-IDF driver makes on the device too, on the
+// calling thread: they are counted apart and don't go to the hook
+void host_heap_driver_enter(void);
+void host_heap_driver_exit(void);
+uint64_t host_heap_driver_allocs(void);
+
+// Around the calls of interrupt handlers, for xPortInIsrContext() (freertos.c)
+void host_isr_enter(void);
+void host_isr_exit(void);
+
+// Network model of the in-process HTTP servers (http_client.c)
+typedef struct {
+    int rtt_ms;         // added once per request, before the headers arrive
+    int feed_tick_ms;   // how often the rate feed changes
+    int gzip;           // compress the feed if the client accepts gzip
+} host_net_config_t;
+extern host_net_config_t host_net;
+
+// The simulated AP and the delays of the station (wifi.c)
+typedef struct {
+    int scan_ms;    // per channel scanned
+    int assoc_ms;   // authentication and association once the AP is found
+    int dhcp_ms;    // DHCP exchange, skipped with a static IP
+    int channel;    // of the AP
+    int down_ms;    // AP out of reach until this long after start
+} host_wifi_config_t;
+extern host_wifi_config_t host_wifi;
+
+// File the NVS partition is kept in between runs (nvs.c), NULL: RAM only.
+// Set before nvs_flash_init().
+extern const char *host_nvs_path;
+// Blob writes so far and their total size, to check flash write budgets
+void host_nvs_stats(uint32_t *writes, uint32_t *bytes);
+
+// A slave on the simulated I2C bus (i2c.c).  The bus strips the address
+// byte; stop() gets the time the whole transaction took on the wire.
+typedef struct {
+    void (*start)(void *ctx);
+    void (*write)(void *ctx, const uint8_t *data, size_t len);
+    void (*stop)(void *ctx, size_t bytes, int64_t bus_us);
+} host_i2c_device_t;
+void host_i2c_attach(int port, uint8_t addr, const host_i2c_device_t *dev, void *ctx);
+
+// The data of the last transaction on SPI host (spi.c), NULL if none yet.
+// Returns the number of transactions so far.
+int host_spi_wire(int host, const uint8_t **data, size_t *bits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_SHIM_HOST_H_ */
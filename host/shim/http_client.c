@@ -0,0 +1,416 @@
+/*
+ * http_client.c
+ *
+ * esp_http_client answered in-process, see include/esp_http_client.h.  Each
+ * request costs host_net.rtt_ms before its headers arrive, plus one more
+ * round trip to connect if the connection isn't kept alive from before.
+ *
+ * The rate feed mirrors tools/truefx_standin.py: ten pairs doing a random
+ * walk every host_net.feed_tick_ms, ETag / Last-Modified validators, 304s
+ * for unchanged rates and gzip if the client asks for it.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_client.h"
+
+#include "host.h"
+
+host_net_config_t host_net = {
+    .rtt_ms = 40,
+    .feed_tick_ms = 5000,
+    .gzip = 1,
+};
+
+#define MAX_HEADERS 12
+
+typedef struct {
+    char key[32];
+    char value[128];
+} header_t;
+
+typedef struct {
+    header_t h[MAX_HEADERS];
+    int count;
+} headers_t;
+
+typedef struct {
+    int status;
+    headers_t headers;
+    uint8_t *body;
+    int body_len;
+} response_t;
+
+struct esp_http_client {
+    char url[256];
+    http_event_handle_cb handler;
+    void *user_data;
+    esp_http_client_method_t method;
+    headers_t request_headers;
+    const char *post_data;
+    int post_len;
+
+    int connected;
+    int requested;
+    int finished;
+    response_t response;
+    int body_pos;
+};
+
+static void headers_set(headers_t *hs, const char *key, const char *value) {
+    int i;
+    for (i = 0; i < hs->count; i++) {
+        if (strcasecmp(hs->h[i].key, key) == 0)
+            break;
+    }
+    if (i == hs->count) {
+        if (hs->count == MAX_HEADERS)
+            return;
+        hs->count++;
+    }
+    snprintf(hs->h[i].key, sizeof hs->h[i].key, "%s", key);
+    snprintf(hs->h[i].value, sizeof hs->h[i].value, "%s", value);
+}
+
+static const char *headers_get(const headers_t *hs, const char *key) {
+    for (int i = 0; i < hs->count; i++) {
+        if (strcasecmp(hs->h[i].key, key) == 0)
+            return hs->h[i].value;
+    }
+    return NULL;
+}
+
+static void headers_delete(headers_t *hs, const char *key) {
+    for (int i = 0; i < hs->count; i++) {
+        if (strcasecmp(hs->h[i].key, key) == 0) {
+            hs->h[i] = hs->h[--hs->count];
+            return;
+        }
+    }
+}
+
+static void set_body(response_t *r, const void *data, int len) {
+    r->body = malloc(len);
+    memcpy(r->body, data, len);
+    r->body_len = len;
+}
+
+static void emit(esp_http_client_handle_t client, esp_http_client_event_id_t id,
+                 void *data, int len, char *key, char *value) {
+    if (!client->handler)
+        return;
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = len,
+        .user_data = client->user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    client->handler(&evt);
+}
+
+/*** Captive portal ***********************************************************/
+
+static pthread_mutex_t portal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int portal_logged_in;
+
+#define PORTAL_MAC "24:0a:c4:13:37:42"
+#define PORTAL_PASSWORD "b5e1c0ffee"
+
+static void portal_serve(esp_http_client_handle_t client, response_t *r) {
+    static const char filler[] =
+        "<p>Willkommen im KA-WLAN.  Bitte melden Sie sich an.</p>\n";
+    char page[4096];
+    int len = 0;
+
+    pthread_mutex_lock(&portal_mutex);
+    if (client->method == HTTP_METHOD_POST) {
+        char expected[128];
+        snprintf(expected, sizeof expected, "username=%s&password=%s",
+                 PORTAL_MAC, PORTAL_PASSWORD);
+        if (client->post_data && strstr(client->post_data, expected))
+            portal_logged_in = 1;
+    }
+
+    len += snprintf(page + len, sizeof page - len,
+                    "<html><head><title>KA-WLAN</title></head><body>\n");
+    for (int i = 0; i < 30; i++)
+        len += snprintf(page + len, sizeof page - len, "%s", filler);
+    if (portal_logged_in) {
+        len += snprintf(page + len, sizeof page - len,
+                        "<p>Sie sind erfolgreich eingeloggt.</p>\n");
+    } else {
+        len += snprintf(page + len, sizeof page - len,
+                        "<form name=\"login\" action=\"/login\" method=\"post\">\n"
+                        "<input type=\"hidden\" name=\"username\" type=\"text\" value=\"%s\">\n"
+                        "<input type=\"hidden\" name=\"password\" type=\"password\" value=\"%s\">\n"
+                        "</form>\n", PORTAL_MAC, PORTAL_PASSWORD);
+    }
+    len += snprintf(page + len, sizeof page - len, "</body></html>\n");
+    pthread_mutex_unlock(&portal_mutex);
+
+    r->status = client->method == HTTP_METHOD_POST && !portal_logged_in ? 403 : 200;
+    headers_set(&r->headers, "Content-Type", "text/html");
+    set_body(r, page, len);
+}
+
+/*** Rate feed ****************************************************************/
+
+static const struct {
+    const char *name;
+    double mid;
+} feed_pairs[] = {
+    {"EUR/USD", 1.14096}, {"USD/JPY", 110.123}, {"GBP/USD", 1.30456},
+    {"EUR/GBP", 0.87461}, {"USD/CHF", 0.99012}, {"EUR/JPY", 125.642},
+    {"EUR/CHF", 1.12975}, {"USD/CAD", 1.30521}, {"AUD/USD", 0.72843},
+    {"GBP/JPY", 143.651},
+};
+#define FEED_PAIRS ((int)(sizeof(feed_pairs) / sizeof(feed_pairs[0])))
+
+static struct {
+    pthread_mutex_t mutex;
+    int initialised;
+    double mids[FEED_PAIRS];
+    int64_t changed_us;
+    char body[FEED_PAIRS * 21 + 2];
+    char etag[24];
+    char last_modified[32];
+    unsigned seed;
+} feed = { .mutex = PTHREAD_MUTEX_INITIALIZER, .seed = 1 };
+
+static double gauss(double sigma) {
+    double u1 = (rand_r(&feed.seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(&feed.seed) + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// big figure (4 chars) and points (3 chars), as TrueFX sends them
+static void split_price(double price, char *big, char *points) {
+    char text[16];
+    snprintf(text, sizeof text, price >= 100 ? "%.3f" : "%.5f", price);
+    memcpy(big, text, 4);
+    memcpy(points, text + 4, 3);
+}
+
+static void feed_update(int64_t now) {
+    if (feed.initialised && now - feed.changed_us < host_net.feed_tick_ms * 1000LL)
+        return;
+    for (int i = 0; i < FEED_PAIRS; i++) {
+        feed.mids[i] = feed.initialised ? feed.mids[i] * (1 + gauss(2e-5))
+                                        : feed_pairs[i].mid;
+    }
+    feed.initialised = 1;
+    feed.changed_us = now;
+
+    // pair names, bid big figures, bid points, offer big figures, offer points
+    char *p = feed.body;
+    for (int i = 0; i < FEED_PAIRS; i++, p += 7)
+        memcpy(p, feed_pairs[i].name, 7);
+    for (int side = -1; side <= 1; side += 2) {
+        char big[FEED_PAIRS][4], points[FEED_PAIRS][3];
+        for (int i = 0; i < FEED_PAIRS; i++)
+            split_price(feed.mids[i] * (1 + side * 3e-5), big[i], points[i]);
+        for (int i = 0; i < FEED_PAIRS; i++, p += 4)
+            memcpy(p, big[i], 4);
+        for (int i = 0; i < FEED_PAIRS; i++, p += 3)
+            memcpy(p, points[i], 3);
+    }
+    *p++ = '\n';
+    *p = 0;
+
+    snprintf(feed.etag, sizeof feed.etag, "\"%08lx\"",
+             crc32(0, (const Bytef*)feed.body, p - feed.body));
+    time_t wall = time(NULL);
+    strftime(feed.last_modified, sizeof feed.last_modified,
+             "%a, %d %b %Y %H:%M:%S GMT", gmtime(&wall));
+}
+
+static void gzip_body(response_t *r, const char *data, int len) {
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    r->body = malloc(deflateBound(&zs, len));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = len;
+    zs.next_out = r->body;
+    zs.avail_out = deflateBound(&zs, len);
+    deflate(&zs, Z_FINISH);
+    r->body_len = zs.total_out;
+    deflateEnd(&zs);
+}
+
+static void feed_serve(esp_http_client_handle_t client, response_t *r) {
+    pthread_mutex_lock(&feed.mutex);
+    feed_update(host_time_us());
+    headers_set(&r->headers, "ETag", feed.etag);
+    headers_set(&r->headers, "Last-Modified", feed.last_modified);
+
+    const char *inm = headers_get(&client->request_headers, "If-None-Match");
+    const char *ims = headers_get(&client->request_headers, "If-Modified-Since");
+    if ((inm && strcmp(inm, feed.etag) == 0) ||
+        (!inm && ims && strcmp(ims, feed.last_modified) == 0)) {
+        r->status = 304;
+        pthread_mutex_unlock(&feed.mutex);
+        return;
+    }
+
+    r->status = 200;
+    headers_set(&r->headers, "Content-Type", "text/plain");
+    const char *accept = headers_get(&client->request_headers, "Accept-Encoding");
+    if (host_net.gzip && accept && strstr(accept, "gzip")) {
+        gzip_body(r, feed.body, strlen(feed.body));
+        headers_set(&r->headers, "Content-Encoding", "gzip");
+    } else {
+        set_body(r, feed.body, strlen(feed.body));
+    }
+    pthread_mutex_unlock(&feed.mutex);
+}
+
+/*** Client *******************************************************************/
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    esp_http_client_handle_t client = calloc(1, sizeof *client);
+    if (!client)
+        return NULL;
+    snprintf(client->url, sizeof client->url, "%s", config->url ? config->url : "");
+    client->handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->method = config->method;
+    return client;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+    snprintf(client->url, sizeof client->url, "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client,
+                                     esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client,
+                                     const char *key, const char *value) {
+    headers_set(&client->request_headers, key, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client,
+                                        const char *key) {
+    headers_delete(&client->request_headers, key);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client,
+                                         const char *data, int len) {
+    client->post_data = data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+static void response_free(response_t *r) {
+    free(r->body);
+    memset(r, 0, sizeof *r);
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    response_free(&client->response);
+    client->requested = client->finished = 0;
+    client->body_pos = 0;
+
+    if (!client->connected) {
+        vTaskDelay(host_net.rtt_ms / portTICK_PERIOD_MS);
+        client->connected = 1;
+        emit(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    }
+    emit(client, HTTP_EVENT_HEADER_SENT, NULL, 0, NULL, NULL);
+    client->requested = 1;
+    return ESP_OK;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    if (!client->requested)
+        return ESP_FAIL;
+    vTaskDelay(host_net.rtt_ms / portTICK_PERIOD_MS);
+
+    response_t *r = &client->response;
+    if (strstr(client->url, "ka-wlan.de"))
+        portal_serve(client, r);
+    else
+        feed_serve(client, r);
+
+    char length[16];
+    snprintf(length, sizeof length, "%d", r->body_len);
+    headers_set(&r->headers, "Content-Length", length);
+    for (int i = 0; i < r->headers.count; i++)
+        emit(client, HTTP_EVENT_ON_HEADER, NULL, 0, r->headers.h[i].key,
+             r->headers.h[i].value);
+    return r->body_len;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+    response_t *r = &client->response;
+    int n = r->body_len - client->body_pos;
+    if (n > len)
+        n = len;
+    if (n > 0) {
+        memcpy(buffer, r->body + client->body_pos, n);
+        client->body_pos += n;
+        emit(client, HTTP_EVENT_ON_DATA, buffer, n, NULL, NULL);
+    }
+    if (client->body_pos == r->body_len && !client->finished) {
+        client->finished = 1;
+        emit(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+    }
+    return n;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->connected) {
+        client->connected = 0;
+        emit(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+    client->requested = 0;
+    response_free(&client->response);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    esp_err_t err = esp_http_client_open(client, client->post_len);
+    if (err != ESP_OK)
+        return err;
+    esp_http_client_fetch_headers(client);
+    char buf[256];
+    while (esp_http_client_read(client, buf, sizeof buf) > 0)
+        ;
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->response.status;
+}
+
+int esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->response.body_len;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) {
+    return false;
+}
@@ -0,0 +1,266 @@
+/*
+ * i2c.c
+ *
+ * I2C master command links, recorded like the ESP-IDF driver does and
+ * played to the slaves attached to the simulated bus.  Like the real driver,
+ * i2c_master_cmd_begin() blocks for as long as the transfer takes on the
+ * wire: 9 clocks per byte (8 bits and the ACK) plus one each for START and
+ * STOP, at the configured clock speed.  The allocations of heap-allocated
+ * links are the driver's, see host_heap_driver_enter().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/i2c.h"
+
+#include "host.h"
+
+typedef enum {
+    OP_START,
+    OP_WRITE,
+    OP_STOP,
+} i2c_op_type_t;
+
+// Like in the driver, single bytes are kept in the op, longer writes by
+// reference to the caller's data
+typedef struct i2c_op {
+    struct i2c_op *next;
+    i2c_op_type_t type;
+    size_t len;
+    const uint8_t *data;
+    uint8_t byte;
+} i2c_op_t;
+
+struct host_i2c_cmd {
+    i2c_op_t *head, *tail;
+    uint8_t *free, *end;  // rest of the buffer of a static link
+    int is_static;
+};
+
+#ifdef TBHUT_I2C_STATIC
+_Static_assert(sizeof(i2c_op_t) <= I2C_INTERNAL_STRUCT_SIZE &&
+               sizeof(struct host_i2c_cmd) <= 2 * I2C_INTERNAL_STRUCT_SIZE,
+               "I2C_INTERNAL_STRUCT_SIZE too small");
+#endif
+
+#define MAX_SLAVES 4
+
+typedef struct {
+    uint8_t addr;
+    const host_i2c_device_t *dev;
+    void *ctx;
+} slave_t;
+
+typedef struct {
+    int installed;
+    uint32_t clk_speed;
+    pthread_mutex_t mutex;  // one command link at a time, as in the driver
+    slave_t slaves[MAX_SLAVES];
+    int nslaves;
+} bus_t;
+
+static bus_t buses[I2C_NUM_MAX] = {
+    { .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .mutex = PTHREAD_MUTEX_INITIALIZER },
+};
+
+void host_i2c_attach(int port, uint8_t addr, const host_i2c_device_t *dev, void *ctx) {
+    bus_t *bus = &buses[port];
+    if (bus->nslaves == MAX_SLAVES) {
+        fprintf(stderr, "i2c: too many slaves on port %d\n", port);
+        abort();
+    }
+    bus->slaves[bus->nslaves++] = (slave_t){ addr, dev, ctx };
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_conf->mode != I2C_MODE_MASTER ||
+        i2c_conf->master.clk_speed == 0)
+        return ESP_ERR_INVALID_ARG;
+    buses[i2c_num].clk_speed = i2c_conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len,
+                             size_t slv_tx_buf_len, int intr_alloc_flags) {
+    if (i2c_num >= I2C_NUM_MAX || !buses[i2c_num].clk_speed)
+        return ESP_ERR_INVALID_ARG;
+    buses[i2c_num].installed = 1;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create() {
+    host_heap_driver_enter();
+    i2c_cmd_handle_t cmd = calloc(1, sizeof(struct host_i2c_cmd));
+    host_heap_driver_exit();
+    return cmd;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd) {
+    if (!cmd)
+        return;
+    for (i2c_op_t *op = cmd->head, *next; op; op = next) {
+        next = op->next;
+        free(op);
+    }
+    free(cmd);
+}
+
+#ifdef TBHUT_I2C_STATIC
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size) {
+    if (!buffer || size < 2 * I2C_INTERNAL_STRUCT_SIZE)
+        return NULL;
+    struct host_i2c_cmd *cmd = (struct host_i2c_cmd *)buffer;
+    memset(cmd, 0, sizeof *cmd);
+    cmd->free = buffer + 2 * I2C_INTERNAL_STRUCT_SIZE;
+    cmd->end = buffer + size;
+    cmd->is_static = 1;
+    return cmd;
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd) {
+    // nothing to free, the buffer is the caller's
+}
+#endif
+
+static i2c_op_t *op_alloc(i2c_cmd_handle_t cmd) {
+#ifdef TBHUT_I2C_STATIC
+    if (cmd->is_static) {
+        if (cmd->end - cmd->free < I2C_INTERNAL_STRUCT_SIZE)
+            return NULL;
+        i2c_op_t *op = (i2c_op_t *)cmd->free;
+        cmd->free += I2C_INTERNAL_STRUCT_SIZE;
+        return op;
+    }
+#endif
+    host_heap_driver_enter();
+    i2c_op_t *op = malloc(sizeof(i2c_op_t));
+    host_heap_driver_exit();
+    return op;
+}
+
+static esp_err_t append(i2c_cmd_handle_t cmd, i2c_op_type_t type,
+                        const uint8_t *data, size_t len) {
+    if (!cmd)
+        return ESP_ERR_INVALID_ARG;
+    i2c_op_t *op = op_alloc(cmd);
+    if (!op)
+        return ESP_ERR_NO_MEM;
+    op->next = NULL;
+    op->type = type;
+    op->len = len;
+    if (len == 1) {
+        op->byte = *data;
+        op->data = &op->byte;
+    } else {
+        op->data = data;
+    }
+    if (cmd->tail)
+        cmd->tail->next = op;
+    else
+        cmd->head = op;
+    cmd->tail = op;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd) {
+    return append(cmd, OP_START, NULL, 0);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en) {
+    return append(cmd, OP_WRITE, &data, 1);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data,
+                           size_t data_len, bool ack_en) {
+    return append(cmd, OP_WRITE, data, data_len);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd) {
+    return append(cmd, OP_STOP, NULL, 0);
+}
+
+static const slave_t *find_slave(const bus_t *bus, uint8_t addr) {
+    for (int i = 0; i < bus->nslaves; i++) {
+        if (bus->slaves[i].addr == addr)
+            return &bus->slaves[i];
+    }
+    return NULL;
+}
+
+static int64_t wire_us(const bus_t *bus, size_t bytes) {
+    return ((int64_t)(2 + 9 * bytes) * 1000000 + bus->clk_speed - 1) / bus->clk_speed;
+}
+
+static esp_err_t play(bus_t *bus, i2c_cmd_handle_t cmd, int64_t *bus_us) {
+    const slave_t *slave = NULL;
+    int in_transaction = 0;
+    size_t bytes = 0;
+
+    for (const i2c_op_t *op = cmd->head; op; op = op->next) {
+        if (op->type == OP_START) {
+            if (slave)  // repeated START
+                slave->dev->stop(slave->ctx, bytes, wire_us(bus, bytes));
+            *bus_us += in_transaction ? wire_us(bus, bytes) : 0;
+            in_transaction = 1;
+            slave = NULL;
+            bytes = 0;
+            continue;
+        }
+        if (!in_transaction) {
+            fprintf(stderr, "i2c: %s outside of a transaction\n",
+                    op->type == OP_WRITE ? "write" : "stop");
+            return ESP_FAIL;
+        }
+        if (op->type == OP_STOP) {
+            *bus_us += wire_us(bus, bytes);
+            if (slave)
+                slave->dev->stop(slave->ctx, bytes, wire_us(bus, bytes));
+            in_transaction = 0;
+            slave = NULL;
+            continue;
+        }
+
+        const uint8_t *data = op->data;
+        size_t len = op->len;
+        if (bytes == 0 && len > 0) {
+            // address byte: nobody ACKs it unless there is such a slave
+            slave = (data[0] & 1) == I2C_MASTER_WRITE ? find_slave(bus, data[0] >> 1) : NULL;
+            bytes = 1;
+            if (!slave) {
+                *bus_us += wire_us(bus, bytes);
+                return ESP_FAIL;
+            }
+            slave->dev->start(slave->ctx);
+            data++;
+            len--;
+        }
+        if (len > 0)
+            slave->dev->write(slave->ctx, data, len);
+        bytes += len;
+    }
+    if (slave) {
+        // the driver would hang the bus, just end the transaction instead
+        fprintf(stderr, "i2c: command link without STOP\n");
+        *bus_us += wire_us(bus, bytes);
+        slave->dev->stop(slave->ctx, bytes, wire_us(bus, bytes));
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd,
+                               TickType_t ticks_to_wait) {
+    if (i2c_num >= I2C_NUM_MAX || !buses[i2c_num].installed || !cmd)
+        return ESP_ERR_INVALID_ARG;
+    bus_t *bus = &buses[i2c_num];
+
+    pthread_mutex_lock(&bus->mutex);
+    const int64_t start = host_time_us();
+    int64_t bus_us = 0;
+    esp_err_t err = play(bus, cmd, &bus_us);
+    host_sleep_until_us(start + bus_us);
+    pthread_mutex_unlock(&bus->mutex);
+    return err;
+}
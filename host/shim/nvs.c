@@ -0,0 +1,166 @@
+/*
+ * nvs.c
+ *
+ * NVS as a small table of blobs in RAM.  With host_nvs_path set, the table
+ * is read from that file by nvs_flash_init() and written back on every
+ * nvs_commit(), so that a second run sees what the first one stored, like
+ * the device after a reboot.  Handles are namespace index + 1.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "host.h"
+
+#define NVS_MAX_NAMESPACES 8
+#define NVS_MAX_ENTRIES    16
+#define NVS_KEY_MAX        16  // including the terminator, like on the device
+#define NVS_BLOB_MAX       4000
+
+typedef struct {
+    uint8_t ns;  // namespace index + 1, 0: unused
+    char key[NVS_KEY_MAX];
+    uint32_t len;
+    uint8_t data[NVS_BLOB_MAX];
+} nvs_entry_t;
+
+const char *host_nvs_path;
+
+static pthread_mutex_t nvs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[NVS_MAX_NAMESPACES][NVS_KEY_MAX];
+static nvs_entry_t entries[NVS_MAX_ENTRIES];
+static uint32_t blob_writes, blob_bytes;
+
+static void load() {
+    FILE *f = fopen(host_nvs_path, "rb");
+    if (!f)
+        return;  // first run
+    if (fread(namespaces, sizeof namespaces, 1, f) != 1 ||
+        fread(entries, sizeof entries, 1, f) != 1) {
+        fprintf(stderr, "nvs: %s is damaged, starting empty\n", host_nvs_path);
+        memset(namespaces, 0, sizeof namespaces);
+        memset(entries, 0, sizeof entries);
+    }
+    fclose(f);
+}
+
+static void save() {
+    FILE *f = fopen(host_nvs_path, "wb");
+    if (!f) {
+        perror(host_nvs_path);
+        return;
+    }
+    fwrite(namespaces, sizeof namespaces, 1, f);
+    fwrite(entries, sizeof entries, 1, f);
+    fclose(f);
+}
+
+esp_err_t nvs_flash_init() {
+    if (host_nvs_path)
+        load();
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase() {
+    pthread_mutex_lock(&nvs_mutex);
+    memset(namespaces, 0, sizeof namespaces);
+    memset(entries, 0, sizeof entries);
+    pthread_mutex_unlock(&nvs_mutex);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle_t *out_handle) {
+    if (strlen(name) >= NVS_KEY_MAX)
+        return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&nvs_mutex);
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(namespaces[i], name) == 0 ||
+            (!namespaces[i][0] && open_mode == NVS_READWRITE)) {
+            strcpy(namespaces[i], name);
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+static nvs_entry_t *find(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].ns == handle && strcmp(entries[i].key, key) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    if (handle < 1 || handle > NVS_MAX_NAMESPACES)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&nvs_mutex);
+    const nvs_entry_t *e = find(handle, key);
+    if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out_value) {
+        *length = e->len;  // size query
+    } else if (*length < e->len) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, e->data, e->len);
+        *length = e->len;
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (handle < 1 || handle > NVS_MAX_NAMESPACES)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (strlen(key) >= NVS_KEY_MAX)
+        return ESP_ERR_INVALID_ARG;
+    if (length > NVS_BLOB_MAX)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_entry_t *e = find(handle, key);
+    for (int i = 0; !e && i < NVS_MAX_ENTRIES; i++) {
+        if (!entries[i].ns)
+            e = &entries[i];
+    }
+    if (e) {
+        e->ns = handle;
+        strcpy(e->key, key);
+        e->len = length;
+        memcpy(e->data, value, length);
+        blob_writes++;
+        blob_bytes += length;
+    } else {
+        err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    pthread_mutex_lock(&nvs_mutex);
+    if (host_nvs_path)
+        save();
+    pthread_mutex_unlock(&nvs_mutex);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+void host_nvs_stats(uint32_t *writes, uint32_t *bytes) {
+    pthread_mutex_lock(&nvs_mutex);
+    *writes = blob_writes;
+    *bytes = blob_bytes;
+    pthread_mutex_unlock(&nvs_mutex);
+}
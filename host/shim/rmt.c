@@ -0,0 +1,150 @@
+/*
+ * rmt.c
+ *
+ * Model of the RMT transmitter as the LED driver uses it: memory mode with
+ * wraparound, one 64-item block per channel.  A thread stands in for the
+ * peripheral.  It picks up tx_start, sends items in (scaled) real time and
+ * raises ch<n>_tx_thr_event every tx_lim items and ch<n>_tx_end at the
+ * first zero-length item, calling the registered handler like the
+ * interrupt controller would.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+#include "esp_intr.h"
+#include "driver/rmt.h"
+#include "soc/rmt_struct.h"
+
+#include "host.h"
+
+rmt_dev_t RMT;
+rmt_mem_t RMTMEM;
+
+#define RMT_CHANNELS 8
+#define RMT_BLOCK_ITEMS 64
+#define APB_CLK_MHZ 80
+
+typedef struct {
+    int active;
+    unsigned pos;      // next item to send
+    unsigned sent;     // items since the last threshold event
+    int64_t start_us;  // of the transmission
+    uint64_t ticks;    // clock cycles of the items sent so far
+    int64_t next_us;   // when they are out on the wire
+    uint32_t pending;  // interrupt to raise at next_us
+} channel_t;
+
+static channel_t channels[RMT_CHANNELS];
+
+static intr_handler_t rmt_handler;
+static void *rmt_handler_arg;
+static pthread_t rmt_thread;
+
+esp_err_t rmt_set_pin(rmt_channel_t channel, rmt_mode_t mode, gpio_num_t gpio_num) {
+    if (channel >= RMT_CHANNEL_MAX || mode != RMT_MODE_TX || gpio_num >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+static void raise_intr(uint32_t bit) {
+    RMT.int_raw.val |= bit;
+    if (!(RMT.int_ena.val & bit) || !rmt_handler)
+        return;
+    RMT.int_st.val = RMT.int_raw.val & RMT.int_ena.val;
+    host_isr_enter();
+    rmt_handler(rmt_handler_arg);
+    host_isr_exit();
+    RMT.int_raw.val &= ~RMT.int_clr.val;
+    RMT.int_st.val = RMT.int_raw.val & RMT.int_ena.val;
+    RMT.int_clr.val = 0;
+}
+
+// Clock out the items of channel ch up to its next event, which becomes
+// pending until they are on the wire
+static void transmit(int ch) {
+    channel_t *c = &channels[ch];
+    const unsigned limit = RMT.tx_lim_ch[ch].limit;
+    const unsigned div = RMT.conf_ch[ch].conf0.div_cnt ? RMT.conf_ch[ch].conf0.div_cnt : 256;
+
+    while (1) {
+        const uint32_t item = RMTMEM.chan[ch].data32[c->pos].val;
+        const uint32_t d0 = item & 0x7fff, d1 = (item >> 16) & 0x7fff;
+        if (d0 == 0 || d1 == 0) {
+            // a zero duration ends the transmission, after d0 if it's not zero
+            c->ticks += (uint64_t)d0 * div;
+            c->next_us = c->start_us + c->ticks / APB_CLK_MHZ;
+            c->pending = 1u << (3 * ch);
+            return;
+        }
+        // in clock cycles, so that the sub-microsecond items add up
+        c->ticks += ((uint64_t)d0 + d1) * div;
+        c->next_us = c->start_us + c->ticks / APB_CLK_MHZ;
+        c->pos = (c->pos + 1) % RMT_BLOCK_ITEMS;
+        if (limit && ++c->sent == limit) {
+            c->sent = 0;
+            c->pending = 1u << (24 + ch);
+            return;
+        }
+    }
+}
+
+static void *rmt_main(void *arg) {
+    // wake up on time rather than with Linux' default 50 us of slack, so
+    // that the interrupt latencies the driver measures are the scheduler's
+    prctl(PR_SET_TIMERSLACK, 1UL);
+    while (1) {
+        const int64_t now = host_time_us();
+        int64_t wake = now + 20;
+        for (int ch = 0; ch < RMT_CHANNELS; ch++) {
+            channel_t *c = &channels[ch];
+            if (!c->active && RMT.conf_ch[ch].conf1.tx_start) {
+                RMT.conf_ch[ch].conf1.tx_start = 0;
+                if (RMT.conf_ch[ch].conf1.mem_rd_rst) {
+                    RMT.conf_ch[ch].conf1.mem_rd_rst = 0;
+                    c->pos = 0;
+                }
+                c->sent = 0;
+                c->start_us = c->next_us = now;
+                c->ticks = 0;
+                c->active = 1;
+                transmit(ch);
+            }
+            while (c->active && c->next_us <= now) {
+                const uint32_t event = c->pending;
+                c->pending = 0;
+                if (event & 0x00ffffff) {
+                    c->active = 0;
+                    raise_intr(event);
+                } else {
+                    raise_intr(event);
+                    transmit(ch);
+                }
+            }
+            if (c->active && c->next_us < wake)
+                wake = c->next_us;
+        }
+        host_sleep_until_us(wake);
+    }
+    return NULL;
+}
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg,
+                         intr_handle_t *ret_handle) {
+    if (source != ETS_RMT_INTR_SOURCE || rmt_handler)
+        return ESP_ERR_NOT_SUPPORTED;
+    rmt_handler = handler;
+    rmt_handler_arg = arg;
+    if (pthread_create(&rmt_thread, NULL, rmt_main, NULL) != 0)
+        return ESP_ERR_NO_MEM;
+    pthread_setname_np(rmt_thread, "rmt");
+    if (ret_handle)
+        *ret_handle = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,88 @@
+/*
+ * spi.c
+ *
+ * SPI master as the LED driver's SPI backend uses it: one device per bus,
+ * transactions that only send.  A queued transaction is on the wire for its
+ * length at the device's clock, and spi_device_get_trans_result() returns
+ * when that time is up.  host_spi_wire() shows the last transaction, as
+ * long as the caller leaves its buffer alone, and counts them.
+ */
+
+#include <stdio.h>
+
+#include "driver/spi_master.h"
+
+#include "host.h"
+
+#define SPI_HOSTS 3
+
+struct spi_device_t {
+    int host;
+    int clock_hz;
+    int max_transfer_sz;
+    spi_transaction_t *queued;  // result not collected yet
+    int64_t done_us;            // when its last bit is out
+    const uint8_t *wire;        // last transaction sent
+    size_t wire_bits;
+    int transactions;
+};
+
+static struct spi_device_t devices[SPI_HOSTS];
+static uint8_t bus_initialised[SPI_HOSTS];
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                             int dma_chan) {
+    if (host <= SPI_HOST || host >= SPI_HOSTS || dma_chan < 0 || dma_chan > 2)
+        return ESP_ERR_INVALID_ARG;
+    if (bus_initialised[host])
+        return ESP_ERR_INVALID_STATE;
+    bus_initialised[host] = 1;
+    // without DMA, a transaction is limited to the 64-byte buffer
+    devices[host].max_transfer_sz = dma_chan ? bus_config->max_transfer_sz : 64;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host,
+                             const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle) {
+    if (host <= SPI_HOST || host >= SPI_HOSTS || dev_config->clock_speed_hz <= 0)
+        return ESP_ERR_INVALID_ARG;
+    if (!bus_initialised[host] || devices[host].clock_hz)
+        return ESP_ERR_INVALID_STATE;  // the model has one device per bus
+    devices[host].host = host;
+    devices[host].clock_hz = dev_config->clock_speed_hz;
+    *handle = &devices[host];
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+                                 TickType_t ticks_to_wait) {
+    if (trans_desc->length > (size_t)handle->max_transfer_sz * 8 || trans_desc->rxlength)
+        return ESP_ERR_INVALID_ARG;
+    if (handle->queued)
+        return ESP_ERR_TIMEOUT;  // queue of one, as the LED driver sets it up
+    const int64_t now = host_time_us();
+    const int64_t start = handle->done_us > now ? handle->done_us : now;
+    handle->done_us = start + (int64_t)trans_desc->length * 1000000 / handle->clock_hz;
+    handle->queued = trans_desc;
+    handle->wire = trans_desc->tx_buffer;
+    handle->wire_bits = trans_desc->length;
+    handle->transactions++;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **trans_desc, TickType_t ticks_to_wait) {
+    if (!handle->queued)
+        return ESP_ERR_TIMEOUT;
+    host_sleep_until_us(handle->done_us);
+    *trans_desc = handle->queued;
+    handle->queued = NULL;
+    return ESP_OK;
+}
+
+int host_spi_wire(int host, const uint8_t **data, size_t *bits) {
+    *data = devices[host].wire;
+    *bits = devices[host].wire_bits;
+    return devices[host].transactions;
+}
@@ -0,0 +1,300 @@
+/*
+ * ssd1306_emu.c
+ *
+ * Emulated SSD1306, see ssd1306_emu.h.  Page numbers refer to the SSD1306
+ * datasheet rev 1.1, like the comments in main/ssd1366.h.
+ *
+ * Images are in GDDRAM orientation, column 0 left and bit 0 of page 0 at the
+ * top, which is how the firmware lays out its text.  Segment remap and COM
+ * scan direction are tracked but not applied (the hat sets both, which just
+ * turns the panel by 180 degrees).  Of the continuous scroll commands only
+ * the vertical part is modelled; the one-column content scroll of datasheet
+ * rev 1.5 moves GDDRAM columns.  GDDRAM and its addressing are the
+ * firmware's own model (main/gddram.h), which the mirror uses too.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "gddram.h"
+#include "host.h"
+#include "ssd1306_emu.h"
+
+_Static_assert(SSD1306_EMU_WIDTH == GDDRAM_WIDTH && SSD1306_EMU_PAGES == GDDRAM_PAGES,
+               "panel and GDDRAM model agree");
+
+// frame rate of the panel with the reset oscillator and clock settings:
+// Fosc / (D * K * MUX) = 370 kHz / (1 * 54 * 64), p22
+#define PANEL_FPS 107
+
+// what the next byte of a transaction is (control byte, p20)
+enum {
+    EXPECT_CONTROL,
+    EXPECT_SINGLE,  // Co = 1: one byte, then another control byte
+    EXPECT_STREAM,  // Co = 0: everything up to STOP
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    ssd1306_emu_config_t config;
+
+    gddram_t gddram;
+
+    uint8_t display_on, charge_pump, inverted, entire_on;
+    uint8_t start_line, contrast, seg_remap, com_remap;
+
+    uint8_t scrolling;
+    int64_t scroll_since_us;
+    uint8_t scroll_fixed, scroll_rows;  // vertical scroll area, p30
+    uint16_t scroll_interval;           // frames per step
+    uint8_t scroll_offset;              // rows per step
+
+    // transaction state
+    uint8_t expect, is_data;
+
+    // frame accounting
+    int in_frame;
+    int64_t last_activity_us;
+    ssd1306_emu_stats_t frame, total;
+    uint32_t frames;
+} oled = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    // reset state, p28ff
+    .gddram = GDDRAM_INIT,
+    .contrast = 0x7F,
+    .scroll_rows = SSD1306_EMU_HEIGHT,
+};
+
+// scroll step interval setting to frames, p29
+static const uint16_t scroll_frames[8] = {5, 64, 128, 256, 3, 4, 25, 2};
+
+/*** Commands *****************************************************************/
+
+// What a command does besides what gddram_command_byte() has done to GDDRAM
+// and its pointers
+static void execute(const uint8_t *c) {
+    if (c[0] <= 0x1F || (c[0] >= 0xB0 && c[0] <= 0xB7))
+        return;  // column and page pointers, page mode
+    if (c[0] >= 0x40 && c[0] <= 0x7F) {
+        oled.start_line = c[0] & 0x3F;
+    } else {
+        switch (c[0]) {
+        case 0x20: case 0x21: case 0x22:  // addressing mode and ranges
+        case 0x2C: case 0x2D:             // content scroll by one column, rev 1.5
+            break;
+        case 0x26: case 0x27:
+            oled.scroll_interval = scroll_frames[c[3] & 0x07];
+            oled.scroll_offset = 0;
+            break;
+        case 0x29: case 0x2A:
+            oled.scroll_interval = scroll_frames[c[3] & 0x07];
+            oled.scroll_offset = c[5] & 0x3F;
+            break;
+        case 0x2E:
+            oled.scrolling = 0;
+            break;
+        case 0x2F:
+            oled.scrolling = 1;
+            oled.scroll_since_us = host_time_us();
+            break;
+        case 0x81: oled.contrast = c[1]; break;
+        case 0x8D: oled.charge_pump = (c[1] & 0x04) != 0; break;
+        case 0xA0: case 0xA1: oled.seg_remap = c[0] & 1; break;
+        case 0xA3:
+            oled.scroll_fixed = c[1] & 0x3F;
+            oled.scroll_rows = c[2] & 0x7F;
+            break;
+        case 0xA4: case 0xA5: oled.entire_on = c[0] & 1; break;
+        case 0xA6: case 0xA7: oled.inverted = c[0] & 1; break;
+        case 0xAE: case 0xAF: oled.display_on = c[0] & 1; break;
+        case 0xC0: case 0xC8: oled.com_remap = (c[0] & 0x08) != 0; break;
+        case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0xE3:
+            break;  // timing and hardware configuration, don't affect the image
+        default:
+            fprintf(stderr, "ssd1306: unknown command 0x%02X\n", c[0]);
+            break;
+        }
+    }
+}
+
+static void command_byte(uint8_t b) {
+    const uint8_t *c = gddram_command_byte(&oled.gddram, b);
+    if (c)
+        execute(c);
+}
+
+/*** GDDRAM *******************************************************************/
+
+static void data_byte(uint8_t b) {
+    oled.frame.data_bytes++;
+    if (oled.scrolling)
+        oled.frame.scroll_writes++;
+    gddram_data_byte(&oled.gddram, b);
+}
+
+static void render_at(int64_t now, uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH]) {
+    int shift = 0;
+    const int area_end = oled.scroll_fixed + oled.scroll_rows;
+    if (oled.scrolling && oled.scroll_offset && oled.scroll_rows) {
+        const int64_t steps = (now - oled.scroll_since_us) * PANEL_FPS / 1000000 /
+                              oled.scroll_interval;
+        shift = steps * oled.scroll_offset % oled.scroll_rows;
+    }
+
+    for (int y = 0; y < SSD1306_EMU_HEIGHT; y++) {
+        int row = y;
+        if (shift && y >= oled.scroll_fixed && y < area_end)
+            row = oled.scroll_fixed + (y - oled.scroll_fixed + shift) % oled.scroll_rows;
+        row = (row + oled.start_line) % SSD1306_EMU_HEIGHT;
+
+        for (int x = 0; x < SSD1306_EMU_WIDTH; x++) {
+            int lit = oled.entire_on || ((oled.gddram.ram[row / 8][x] >> (row % 8)) & 1);
+            lit ^= oled.inverted;
+            pixels[y][x] = lit && oled.display_on && oled.charge_pump;
+        }
+    }
+}
+
+void ssd1306_emu_render(uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH]) {
+    pthread_mutex_lock(&oled.mutex);
+    render_at(host_time_us(), pixels);
+    pthread_mutex_unlock(&oled.mutex);
+}
+
+// lit pixels come out white, like on the panel
+static int write_pbm(const char *path,
+                     uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH]) {
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+    fprintf(f, "P4\n%d %d\n", SSD1306_EMU_WIDTH, SSD1306_EMU_HEIGHT);
+    for (int y = 0; y < SSD1306_EMU_HEIGHT; y++) {
+        uint8_t row[SSD1306_EMU_WIDTH / 8] = {0};
+        for (int x = 0; x < SSD1306_EMU_WIDTH; x++) {
+            if (!pixels[y][x])
+                row[x / 8] |= 0x80 >> (x % 8);
+        }
+        fwrite(row, 1, sizeof row, f);
+    }
+    return fclose(f);
+}
+
+int ssd1306_emu_write_pbm(const char *path) {
+    uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH];
+    ssd1306_emu_render(pixels);
+    return write_pbm(path, pixels);
+}
+
+/*** Frames *******************************************************************/
+
+static void end_frame() {
+    const ssd1306_emu_stats_t *f = &oled.frame;
+    oled.frames++;
+    oled.total.transactions += f->transactions;
+    oled.total.bytes += f->bytes;
+    oled.total.bus_us += f->bus_us;
+    oled.total.data_bytes += f->data_bytes;
+    oled.total.scroll_writes += f->scroll_writes;
+
+    if (oled.config.print_frames) {
+        printf("oled frame %u: %u transactions, %u bytes, %lld us on the bus, "
+               "%u RAM bytes\n", oled.frames, f->transactions, f->bytes,
+               (long long)f->bus_us, f->data_bytes);
+    }
+    if (f->scroll_writes) {
+        fprintf(stderr, "ssd1306: frame %u wrote %u bytes to RAM while scrolling\n",
+                oled.frames, f->scroll_writes);
+    }
+    if (oled.config.dump_dir) {
+        char path[512];
+        uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH];
+        snprintf(path, sizeof path, "%s/frame_%05u.pbm", oled.config.dump_dir, oled.frames);
+        render_at(oled.last_activity_us, pixels);
+        if (write_pbm(path, pixels) != 0)
+            fprintf(stderr, "ssd1306: can't write %s: %s\n", path, strerror(errno));
+    }
+
+    memset(&oled.frame, 0, sizeof oled.frame);
+    oled.in_frame = 0;
+}
+
+void ssd1306_emu_flush() {
+    pthread_mutex_lock(&oled.mutex);
+    if (oled.in_frame)
+        end_frame();
+    pthread_mutex_unlock(&oled.mutex);
+}
+
+void ssd1306_emu_totals(ssd1306_emu_stats_t *out, uint32_t *frames) {
+    pthread_mutex_lock(&oled.mutex);
+    *out = oled.total;
+    *frames = oled.frames;
+    pthread_mutex_unlock(&oled.mutex);
+}
+
+/*** Bus **********************************************************************/
+
+static void on_start(void *ctx) {
+    const int64_t now = host_time_us();
+    pthread_mutex_lock(&oled.mutex);
+    if (oled.in_frame && now - oled.last_activity_us >= SSD1306_EMU_FRAME_GAP_US)
+        end_frame();
+    oled.in_frame = 1;
+    oled.frame.transactions++;
+    oled.expect = EXPECT_CONTROL;
+}
+
+static void on_write(void *ctx, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t b = data[i];
+        if (oled.expect == EXPECT_CONTROL) {
+            oled.expect = (b & 0x80) ? EXPECT_SINGLE : EXPECT_STREAM;
+            oled.is_data = (b & 0x40) != 0;
+            continue;
+        }
+        if (oled.is_data)
+            data_byte(b);
+        else
+            command_byte(b);
+        if (oled.expect == EXPECT_SINGLE)
+            oled.expect = EXPECT_CONTROL;
+    }
+}
+
+static void on_stop(void *ctx, size_t bytes, int64_t bus_us) {
+    oled.frame.bytes += bytes;
+    oled.frame.bus_us += bus_us;
+    oled.last_activity_us = host_time_us() + bus_us;
+    pthread_mutex_unlock(&oled.mutex);
+}
+
+static const host_i2c_device_t ssd1306_device = {
+    .start = on_start,
+    .write = on_write,
+    .stop = on_stop,
+};
+
+// at exit, other tasks may be stuck anywhere, so don't wait for the lock
+static void at_exit() {
+    if (pthread_mutex_trylock(&oled.mutex) != 0)
+        return;
+    if (oled.in_frame)
+        end_frame();
+    if (oled.config.print_frames && oled.frames) {
+        printf("oled: %u frames, %u transactions, %u bytes, %lld us on the bus\n",
+               oled.frames, oled.total.transactions, oled.total.bytes,
+               (long long)oled.total.bus_us);
+    }
+    pthread_mutex_unlock(&oled.mutex);
+}
+
+void ssd1306_emu_attach(int port, uint8_t addr, const ssd1306_emu_config_t *config) {
+    oled.config = *config;
+    host_i2c_attach(port, addr, &ssd1306_device, NULL);
+    atexit(at_exit);
+}
@@ -0,0 +1,48 @@
+/*
+ * ssd1306_emu.h
+ *
+ * Emulated SSD1306 128x64 OLED on the simulated I2C bus.  It decodes the
+ * command stream (addressing modes, column and page pointers, scrolling,
+ * display on/off/invert/start line) and keeps the GDDRAM, so that what the
+ * firmware draws can be looked at and measured without the hat.
+ *
+ * The traffic is cut into frames at idle gaps on the bus: everything the
+ * firmware sends without pausing for SSD1306_EMU_FRAME_GAP_US is one
+ * redraw.  For each frame the emulator counts transactions, bytes and time
+ * on the wire, and can dump what the panel shows afterwards as a PBM image.
+ */
+
+#ifndef HOST_SHIM_SSD1306_EMU_H_
+#define HOST_SHIM_SSD1306_EMU_H_
+
+#include <stdint.h>
+
+#define SSD1306_EMU_WIDTH 128
+#define SSD1306_EMU_PAGES 8
+#define SSD1306_EMU_HEIGHT (SSD1306_EMU_PAGES * 8)
+#define SSD1306_EMU_FRAME_GAP_US 20000
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;          // on the wire, including address bytes
+    int64_t bus_us;          // time on the wire
+    uint32_t data_bytes;     // GDDRAM writes
+    uint32_t scroll_writes;  // GDDRAM writes while scrolling, which corrupt RAM
+} ssd1306_emu_stats_t;
+
+typedef struct {
+    int print_frames;      // print each frame's stats
+    const char *dump_dir;  // if set, write frame_NNNNN.pbm there after each frame
+} ssd1306_emu_config_t;
+
+// Attach the panel to the bus, at the address the hat uses
+void ssd1306_emu_attach(int port, uint8_t addr, const ssd1306_emu_config_t *config);
+// End the current frame now instead of at the next idle gap
+void ssd1306_emu_flush(void);
+// Stats of all frames so far, and their number
+void ssd1306_emu_totals(ssd1306_emu_stats_t *out, uint32_t *frames);
+// Render what the panel shows into pixels[y][x] (1 = lit)
+void ssd1306_emu_render(uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH]);
+int ssd1306_emu_write_pbm(const char *path);
+
+#endif /* HOST_SHIM_SSD1306_EMU_H_ */
@@ -0,0 +1,195 @@
+/*
+ * system.c
+ *
+ * The odds and ends of ESP-IDF the firmware calls once at startup, plus
+ * logging and timers.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/random.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_spi_flash.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "driver/gpio.h"
+
+#include "host.h"
+
+/*** Logging ******************************************************************/
+
+static esp_log_level_t log_level = ESP_LOG_VERBOSE;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    (void)tag;
+    log_level = level;
+}
+
+uint32_t esp_log_timestamp() {
+    return host_time_us() / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    (void)tag;
+    if (level > log_level)
+        return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+/*** System *******************************************************************/
+
+int64_t esp_timer_get_time() {
+    return host_time_us();
+}
+
+void esp_chip_info(esp_chip_info_t *out_info) {
+    out_info->model = CHIP_ESP32;
+    out_info->features = CHIP_FEATURE_WIFI_BGN | CHIP_FEATURE_BT | CHIP_FEATURE_BLE;
+    out_info->cores = 2;
+    out_info->revision = 1;
+}
+
+uint32_t esp_random() {
+    uint32_t r;
+    if (getrandom(&r, sizeof r, 0) != sizeof r)
+        r = rand();
+    return r;
+}
+
+void esp_restart() {
+    printf("esp_restart() called, exiting\n");
+    exit(0);
+}
+
+uint32_t spi_flash_get_chip_size() {
+    return 4 * 1024 * 1024;
+}
+
+/*** Timers *****************************************************************/
+
+// Armed timers are kept unsorted, there are only ever a few
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    int64_t deadline_us;  // 0: not armed
+    struct esp_timer *next;
+};
+
+static struct esp_timer *timers;
+static SemaphoreHandle_t timers_lock, timers_wake;
+
+static void timer_task(void *arg) {
+    while (1) {
+        xSemaphoreTake(timers_lock, portMAX_DELAY);
+        const int64_t now = host_time_us();
+        struct esp_timer *due = NULL;
+        int64_t next = 0;
+        for (struct esp_timer *t = timers; t; t = t->next) {
+            if (!t->deadline_us)
+                continue;
+            if (t->deadline_us <= now && !due)
+                due = t;
+            else if (!next || t->deadline_us < next)
+                next = t->deadline_us;
+        }
+        esp_timer_cb_t callback = NULL;
+        void *cb_arg = NULL;
+        if (due) {
+            due->deadline_us = 0;
+            callback = due->callback;
+            cb_arg = due->arg;
+        }
+        xSemaphoreGive(timers_lock);
+
+        if (callback) {
+            callback(cb_arg);
+            continue;
+        }
+        // until the next deadline or until a timer is (re)armed
+        const TickType_t wait = next ?
+            (next - now + 999) / 1000 / portTICK_PERIOD_MS + 1 : portMAX_DELAY;
+        xSemaphoreTake(timers_wake, wait);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+                           esp_timer_handle_t *out_handle) {
+    if (!timers_lock) {
+        timers_lock = xSemaphoreCreateMutex();
+        timers_wake = xSemaphoreCreateBinary();
+        xTaskCreate(&timer_task, "esp_timer", 3584, NULL, 22, NULL);
+    }
+    struct esp_timer *t = calloc(1, sizeof *t);
+    if (!t)
+        return ESP_ERR_NO_MEM;
+    t->callback = create_args->callback;
+    t->arg = create_args->arg;
+    xSemaphoreTake(timers_lock, portMAX_DELAY);
+    t->next = timers;
+    timers = t;
+    xSemaphoreGive(timers_lock);
+    *out_handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    xSemaphoreTake(timers_lock, portMAX_DELAY);
+    const int armed = timer->deadline_us != 0;
+    if (!armed)
+        timer->deadline_us = host_time_us() + timeout_us;
+    xSemaphoreGive(timers_lock);
+    if (armed)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(timers_wake);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    xSemaphoreTake(timers_lock, portMAX_DELAY);
+    const int armed = timer->deadline_us != 0;
+    timer->deadline_us = 0;
+    xSemaphoreGive(timers_lock);
+    return armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/*** GPIO *********************************************************************/
+
+void gpio_pad_select_gpio(uint8_t gpio_num) {
+    (void)gpio_num;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    return gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    return gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
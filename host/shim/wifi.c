@@ -0,0 +1,191 @@
+/*
+ * wifi.c
+ *
+ * Legacy event loop and a station with one AP on a fixed channel, see
+ * include/esp_wifi.h.  Scans take host_wifi.scan_ms per channel: a fast scan
+ * stops at the channel of the AP, a connect with sta.channel set only probes
+ * that one.  The AP can be out of reach for the first host_wifi.down_ms.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_event_loop.h"
+#include "esp_wifi.h"
+#include "tcpip_adapter.h"
+
+#include "host.h"
+
+host_wifi_config_t host_wifi = {
+    .scan_ms = 40,
+    .assoc_ms = 60,
+    .dhcp_ms = 400,
+    .channel = 6,
+};
+
+#define NUM_CHANNELS 13
+
+// what the simulated AP and DHCP server hand out, in network order
+static const uint8_t ap_bssid[6] = {0x02, 0x4b, 0x41, 0x57, 0x4c, 0x01};
+static const uint32_t sta_ip = 0x0a0a000a;       // 10.0.10.10
+static const uint32_t sta_netmask = 0x00ffffff;  // 255.255.255.0
+static const uint32_t sta_gw = 0x010a000a;       // 10.0.10.1
+
+static system_event_cb_t event_cb;
+static void *event_ctx;
+static QueueHandle_t event_queue;
+
+static wifi_config_t sta_config;
+static int started;
+static int dhcpc_stopped;
+static tcpip_adapter_ip_info_t static_ip;
+
+/*** Event loop ***************************************************************/
+
+static void event_task(void *arg) {
+    system_event_t event;
+    while (1) {
+        if (xQueueReceive(event_queue, &event, portMAX_DELAY) == pdTRUE && event_cb)
+            event_cb(event_ctx, &event);
+    }
+}
+
+esp_err_t esp_event_loop_init(system_event_cb_t cb, void *ctx) {
+    if (event_queue)
+        return ESP_FAIL;
+    event_cb = cb;
+    event_ctx = ctx;
+    event_queue = xQueueCreate(32, sizeof(system_event_t));
+    xTaskCreate(&event_task, "eventTask", 2304, NULL, 20, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_send(system_event_t *event) {
+    if (!event_queue)
+        return ESP_ERR_INVALID_STATE;
+    return xQueueSend(event_queue, event, portMAX_DELAY) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+/*** Station ******************************************************************/
+
+void tcpip_adapter_init() {
+}
+
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if) {
+    dhcpc_stopped = 0;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if) {
+    dhcpc_stopped = 1;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    const tcpip_adapter_ip_info_t *ip_info) {
+    if (!dhcpc_stopped)
+        return ESP_FAIL;  // like ESP_ERR_TCPIP_ADAPTER_DHCP_NOT_STOPPED
+    static_ip = *ip_info;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    tcpip_adapter_ip_info_t *ip_info) {
+    *ip_info = static_ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+    return mode == WIFI_MODE_STA ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf) {
+    if (interface != ESP_IF_WIFI_STA)
+        return ESP_ERR_INVALID_ARG;
+    sta_config = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf) {
+    if (interface != ESP_IF_WIFI_STA)
+        return ESP_ERR_INVALID_ARG;
+    *conf = sta_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start() {
+    started = 1;
+    system_event_t event = { .event_id = SYSTEM_EVENT_STA_START };
+    return esp_event_send(&event);
+}
+
+// scan, association and DHCP of one esp_wifi_connect()
+static void connect_task(void *arg) {
+    const wifi_sta_config_t *sta = &sta_config.sta;
+    system_event_t event;
+    memset(&event, 0, sizeof event);
+    size_t ssid_len = strnlen((const char*)sta->ssid, sizeof sta->ssid);
+
+    int channels = sta->channel ? 1 :
+                   sta->scan_method == WIFI_FAST_SCAN ? host_wifi.channel : NUM_CHANNELS;
+    vTaskDelay(channels * host_wifi.scan_ms / portTICK_PERIOD_MS);
+    const int found = host_time_us() / 1000 >= host_wifi.down_ms &&
+        (!sta->channel || sta->channel == host_wifi.channel) &&
+        (!sta->bssid_set || memcmp(sta->bssid, ap_bssid, sizeof ap_bssid) == 0);
+    if (!found) {
+        event.event_id = SYSTEM_EVENT_STA_DISCONNECTED;
+        memcpy(event.event_info.disconnected.ssid, sta->ssid, ssid_len);
+        event.event_info.disconnected.ssid_len = ssid_len;
+        event.event_info.disconnected.reason = WIFI_REASON_NO_AP_FOUND;
+        esp_event_send(&event);
+        vTaskDelete(NULL);
+    }
+
+    vTaskDelay(host_wifi.assoc_ms / portTICK_PERIOD_MS);
+    event.event_id = SYSTEM_EVENT_STA_CONNECTED;
+    memcpy(event.event_info.connected.ssid, sta->ssid, ssid_len);
+    event.event_info.connected.ssid_len = ssid_len;
+    memcpy(event.event_info.connected.bssid, ap_bssid, sizeof ap_bssid);
+    event.event_info.connected.channel = host_wifi.channel;
+    esp_event_send(&event);
+
+    memset(&event, 0, sizeof event);
+    event.event_id = SYSTEM_EVENT_STA_GOT_IP;
+    if (dhcpc_stopped) {
+        // static address, usable right away
+        event.event_info.got_ip.ip_info = static_ip;
+    } else {
+        vTaskDelay(host_wifi.dhcp_ms / portTICK_PERIOD_MS);
+        event.event_info.got_ip.ip_info.ip.addr = sta_ip;
+        event.event_info.got_ip.ip_info.netmask.addr = sta_netmask;
+        event.event_info.got_ip.ip_info.gw.addr = sta_gw;
+    }
+    event.event_info.got_ip.ip_changed = true;
+    esp_event_send(&event);
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_wifi_connect() {
+    if (!started)
+        return ESP_ERR_INVALID_STATE;
+    return xTaskCreate(&connect_task, "wifi_connect", 2048, NULL, 20, NULL) == pdPASS ?
+        ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_wifi_disconnect() {
+    system_event_t event = { .event_id = SYSTEM_EVENT_STA_DISCONNECTED };
+    memcpy(event.event_info.disconnected.bssid, ap_bssid, sizeof ap_bssid);
+    return esp_event_send(&event);
+}
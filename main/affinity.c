@@ -0,0 +1,62 @@
+/*
+ * affinity.c
+ *
+ * Per-subsystem core affinity presets, see affinity.h
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "soc/soc.h"
+
+#include "affinity.h"
+
+#define AFFINITY_MAGIC 0xaff10e57
+
+static const affinity_t presets[AFFINITY_NUM_PRESETS] = {
+    [AFFINITY_FLOAT] = { "float", tskNO_AFFINITY, tskNO_AFFINITY, tskNO_AFFINITY },
+    [AFFINITY_SPLIT] = { "split", PRO_CPU_NUM, APP_CPU_NUM, APP_CPU_NUM },
+    [AFFINITY_SHARED] = { "shared", PRO_CPU_NUM, PRO_CPU_NUM, PRO_CPU_NUM },
+};
+
+// not cleared by a software reset
+static RTC_NOINIT_ATTR uint32_t boot_magic, boot_preset;
+
+static affinity_preset_t current() {
+    if (boot_magic == AFFINITY_MAGIC && boot_preset < AFFINITY_NUM_PRESETS)
+        return boot_preset;
+    return AFFINITY_DEFAULT;
+}
+
+const affinity_t *affinity_get() {
+    return &presets[current()];
+}
+
+void affinity_request(affinity_preset_t preset) {
+    boot_magic = AFFINITY_MAGIC;
+    boot_preset = preset;
+}
+
+affinity_preset_t affinity_next() {
+    return (current() + 1) % AFFINITY_NUM_PRESETS;
+}
+
+static void put_core(char *buf, size_t len, BaseType_t core) {
+    if (core == tskNO_AFFINITY)
+        snprintf(buf, len, "-");
+    else
+        snprintf(buf, len, "%d", (int)core);
+}
+
+const char *affinity_describe(const affinity_t *a) {
+    static char desc[64];
+    char net[12], display[12], led[12];
+    put_core(net, sizeof net, a->net);
+    put_core(display, sizeof display, a->display);
+    put_core(led, sizeof led, a->led);
+    snprintf(desc, sizeof desc, "%s (net %s, display %s, led %s)",
+             a->name, net, display, led);
+    return desc;
+}
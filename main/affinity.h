@@ -0,0 +1,43 @@
+/*
+ * affinity.h
+ *
+ * Which core the firmware's tasks run on, per subsystem.  The Wi-Fi driver
+ * and lwIP tasks are pinned to PRO_CPU by sdkconfig, so "net" is the quote
+ * task with HTTP, TLS and parsing, "display" the OLED task and "led" the
+ * sort animation.
+ *
+ * Affinity is fixed when a task is created, so the preset is chosen per
+ * boot: affinity_request() selects one for the next boot after
+ * esp_restart(), otherwise AFFINITY_DEFAULT applies.  Compare the presets
+ * with the frame timing report (frame_timing.h), which names the preset.
+ */
+
+#ifndef MAIN_AFFINITY_H_
+#define MAIN_AFFINITY_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    const char *name;
+    BaseType_t net, display, led;  // core or tskNO_AFFINITY
+} affinity_t;
+
+typedef enum {
+    AFFINITY_FLOAT,   // no pinning, the scheduler picks
+    AFFINITY_SPLIT,   // networking on PRO_CPU with Wi-Fi, rendering on APP_CPU
+    AFFINITY_SHARED,  // everything on PRO_CPU, the worst case for the LEDs
+    AFFINITY_NUM_PRESETS
+} affinity_preset_t;
+
+#define AFFINITY_DEFAULT AFFINITY_SPLIT
+
+// Preset of this boot
+const affinity_t *affinity_get();
+// Use preset from the next boot on
+void affinity_request(affinity_preset_t preset);
+// The preset after this boot's, for cycling through them
+affinity_preset_t affinity_next();
+// "name (net 0, display 1, led 1)", "-" for no affinity
+const char *affinity_describe(const affinity_t *a);
+
+#endif /* MAIN_AFFINITY_H_ */
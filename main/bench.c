@@ -0,0 +1,90 @@
+/*
+ * bench.c
+ *
+ * Micro-benchmark harness, see bench.h
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "bench.h"
+
+#define BENCH_MAGIC 0xbe9c4b07
+
+// not cleared by a software reset
+static RTC_NOINIT_ATTR uint32_t boot_magic;
+
+static inline uint32_t cycles() {
+#if defined(__XTENSA__)
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+static void empty_kernel(void *arg) {
+    __asm__ __volatile__("" : : "r"(arg) : "memory");
+}
+
+typedef struct {
+    uint32_t cycles;  // of the fastest batch
+    int64_t us;       // of the fastest batch
+} batch_t;
+
+static batch_t time_batches(bench_fn_t fn, void *arg, uint32_t calls) {
+    batch_t best = { UINT32_MAX, 0 };
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        const int64_t start_us = esp_timer_get_time();
+        const uint32_t start = cycles();
+        for (uint32_t i = 0; i < calls; i++)
+            fn(arg);
+        const uint32_t elapsed = cycles() - start;
+        const int64_t elapsed_us = esp_timer_get_time() - start_us;
+        if (elapsed < best.cycles) {
+            best.cycles = elapsed;
+            best.us = elapsed_us;
+        }
+    }
+    return best;
+}
+
+void bench_header() {
+    printf("bench,kernel,calls,items,cycles_call,cycles_item,ns_call\n");
+}
+
+void bench_run(const char *kernel, bench_fn_t fn, void *arg, uint32_t calls, uint32_t items) {
+    // warm up caches and branch predictors, then take off the call overhead
+    fn(arg);
+    const batch_t overhead = time_batches(&empty_kernel, arg, calls);
+    const batch_t b = time_batches(fn, arg, calls);
+
+    const double c = b.cycles > overhead.cycles ?
+        (double)(b.cycles - overhead.cycles) / calls : 0;
+    const double ns = b.us > overhead.us ?
+        (double)(b.us - overhead.us) * 1000 / calls : 0;
+    printf("bench,%s,%u,%u,%.1f,%.2f,%.0f\n", kernel, calls, items, c,
+           items ? c / items : c, ns);
+}
+
+void bench_request_boot() {
+    boot_magic = BENCH_MAGIC;
+}
+
+int bench_boot_requested() {
+    const int requested = boot_magic == BENCH_MAGIC;
+    boot_magic = 0;
+    return requested;
+}
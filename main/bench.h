@@ -0,0 +1,45 @@
+/*
+ * bench.h
+ *
+ * Micro-benchmarks of the hot kernels.  bench_run() calls a kernel in
+ * BENCH_ROUNDS batches and prints one CSV line to the console:
+ *
+ *   bench,<kernel>,<calls>,<items>,<cycles_call>,<cycles_item>,<ns_call>
+ *
+ * <calls> is the batch size, <items> what one call processes (pixels,
+ * bytes, glyphs), <cycles_call> the cycles per call of the fastest batch
+ * minus the cost of calling an empty kernel, <cycles_item> that divided by
+ * <items>, and <ns_call> the same in wall-clock time.  bench_header() prints
+ * the column names, `grep ^bench,` pulls the table out of the log.
+ *
+ * Cycles are the CCOUNT register on the device and the time stamp counter
+ * on x86 hosts, which ticks at a fixed reference rate rather than the core
+ * clock; elsewhere they are nanoseconds.  They are read as 32 bits, so a
+ * batch must finish well within 2^32 cycles (17 s at 240 MHz, about 1 s on
+ * a host).
+ *
+ * The benchmarks run as a boot mode, so that nothing else competes for the
+ * CPU: bench_request_boot() leaves a mark in RTC memory that survives a
+ * software reset, and app_main() checks bench_boot_requested() before it
+ * starts any tasks.
+ */
+
+#ifndef MAIN_BENCH_H_
+#define MAIN_BENCH_H_
+
+#include <stdint.h>
+
+#define BENCH_ROUNDS 10
+
+typedef void (*bench_fn_t)(void *arg);
+
+void bench_header();
+// Time calls invocations of fn(arg), each processing items items
+void bench_run(const char *kernel, bench_fn_t fn, void *arg, uint32_t calls, uint32_t items);
+
+// Run the benchmarks on the next boot, after esp_restart()
+void bench_request_boot();
+// Was this boot requested to run the benchmarks?  Clears the request.
+int bench_boot_requested();
+
+#endif /* MAIN_BENCH_H_ */
@@ -0,0 +1,190 @@
+/*
+ * big_font.cpp
+ *
+ * Scaled digit and symbol glyphs, generated by the compiler, see big_font.h.
+ * C++ for constexpr; C++11 has no std::index_sequence, so there is a small
+ * one here, built in halves to stay within the template depth limit.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "big_font.h"
+
+#define FIRST_CHAR 0x20
+#define NUM_GLYPHS 32
+#define SPACING    1  // source columns after a narrow glyph
+#define NARROW_SPACE 3  // source columns of a narrow ' '
+
+// font8x8_basic by Marcel Sondaar (https://github.com/dhepper/font8x8), the
+// source of font8x8_basic_tr: a byte per row, bit 0 is the leftmost column
+static constexpr uint8_t font_source[NUM_GLYPHS][8] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // U+0020 ( )
+    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 },   // U+0021 (!)
+    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // U+0022 (")
+    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 },   // U+0023 (#)
+    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 },   // U+0024 ($)
+    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 },   // U+0025 (%)
+    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 },   // U+0026 (&)
+    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },   // U+0027 (')
+    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 },   // U+0028 (()
+    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 },   // U+0029 ())
+    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 },   // U+002A (*)
+    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 },   // U+002B (+)
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // U+002C (,)
+    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 },   // U+002D (-)
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // U+002E (.)
+    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 },   // U+002F (/)
+    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 },   // U+0030 (0)
+    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 },   // U+0031 (1)
+    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 },   // U+0032 (2)
+    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 },   // U+0033 (3)
+    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 },   // U+0034 (4)
+    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 },   // U+0035 (5)
+    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 },   // U+0036 (6)
+    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 },   // U+0037 (7)
+    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 },   // U+0038 (8)
+    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 },   // U+0039 (9)
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // U+003A (:)
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // U+003B (;)
+    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 },   // U+003C (<)
+    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 },   // U+003D (=)
+    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 },   // U+003E (>)
+    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 },   // U+003F (?)
+};
+
+/*** Index sequences **********************************************************/
+
+template <size_t... I> struct indices {};
+
+template <class A, class B> struct concat;
+template <size_t... I, size_t... J> struct concat<indices<I...>, indices<J...>> {
+    typedef indices<I..., (sizeof...(I) + J)...> type;
+};
+
+// 0 .. N-1, in log N template depth
+template <size_t N> struct make_indices {
+    typedef typename concat<typename make_indices<N / 2>::type,
+                            typename make_indices<N - N / 2>::type>::type type;
+};
+template <> struct make_indices<0> { typedef indices<> type; };
+template <> struct make_indices<1> { typedef indices<0> type; };
+
+/*** Scaled glyphs ************************************************************/
+
+// Byte k of the table at scale s: glyph k / (8 s s), then s pages of 8 s
+// columns.  Bit b of page p is row 8 p + b, which is source row
+// (8 p + b) / s, and column c is source column c / s.
+static constexpr uint8_t source_bit(int g, int row, int col) {
+    return (font_source[g][row] >> col) & 1;
+}
+
+static constexpr uint8_t scaled_bits(int s, int g, int page, int col, int b) {
+    return b == 8 ? 0 : (uint8_t)(source_bit(g, (page * 8 + b) / s, col / s) << b |
+                                  scaled_bits(s, g, page, col, b + 1));
+}
+
+static constexpr uint8_t scaled_byte(int s, size_t k) {
+    return scaled_bits(s, k / (8 * s * s), k / (8 * s) % s, k % (8 * s), 0);
+}
+
+template <int S> struct scaled_font {
+    static constexpr size_t glyph_bytes = 8 * S * S;
+    uint8_t bytes[NUM_GLYPHS * glyph_bytes];
+};
+
+template <int S, size_t... K>
+static constexpr scaled_font<S> make_font(indices<K...>) {
+    return scaled_font<S>{{ scaled_byte(S, K)... }};
+}
+
+template <int S> struct font_table {
+    static constexpr scaled_font<S> font =
+        make_font<S>(typename make_indices<NUM_GLYPHS * scaled_font<S>::glyph_bytes>::type());
+};
+template <int S> constexpr scaled_font<S> font_table<S>::font;
+
+// a 2x '1': source column 2 is set in rows 0..3, column 1 only in row 1
+static_assert(font_table<2>::font.bytes[17 * 32 + 4] == 0xFF, "2x '1', column 4");
+static_assert(font_table<2>::font.bytes[17 * 32 + 3] == 0x0C, "2x '1', column 3");
+// the bottom bar of a 3x '1', source row 6 at rows 18..20: page 2, bits 2..4
+static_assert(font_table<3>::font.bytes[17 * 72 + 2 * 24] == 0x1C, "3x '1', column 0");
+
+/*** Narrow variant ***********************************************************/
+
+// source columns a glyph uses, ORed over its rows
+static constexpr uint8_t used_columns(int g, int row = 0) {
+    return row == 8 ? 0 : font_source[g][row] | used_columns(g, row + 1);
+}
+
+static constexpr int first_column(uint8_t used, int c = 0) {
+    return c == 8 ? 0 : (used >> c) & 1 ? c : first_column(used, c + 1);
+}
+
+static constexpr int last_column(uint8_t used, int c = 7) {
+    return c < 0 ? -1 : (used >> c) & 1 ? c : last_column(used, c - 1);
+}
+
+// where a narrow glyph starts in its source, and how wide it is with spacing
+struct span_t {
+    uint8_t first, width;
+};
+
+static constexpr span_t make_span(int g) {
+    return used_columns(g) ? span_t{ (uint8_t)first_column(used_columns(g)),
+                                     (uint8_t)(last_column(used_columns(g)) -
+                                               first_column(used_columns(g)) + 1 + SPACING) }
+                           : span_t{ 0, NARROW_SPACE };
+}
+
+struct narrow_table {
+    span_t span[NUM_GLYPHS];
+};
+
+template <size_t... G>
+static constexpr narrow_table make_narrow(indices<G...>) {
+    return narrow_table{{ make_span(G)... }};
+}
+
+static constexpr narrow_table narrow = make_narrow(make_indices<NUM_GLYPHS>::type());
+
+static_assert(narrow.span['.' - FIRST_CHAR].width == 3, "'.' is two columns and spacing");
+static_assert(narrow.span['0' - FIRST_CHAR].width == 8, "'0' is seven columns and spacing");
+
+/*** Drawing ******************************************************************/
+
+static int glyph_index(char c) {
+    const int g = (uint8_t)c - FIRST_CHAR;
+    return g >= 0 && g < NUM_GLYPHS ? g : '?' - FIRST_CHAR;
+}
+
+// Source columns first..first + width of a glyph, the ones past the glyph
+// (spacing) stay as they are in the strip
+template <int S>
+static int draw(uint8_t *strip, int stride, int x, const char *text, int narrow_font) {
+    const scaled_font<S> &font = font_table<S>::font;
+    for (; *text; text++) {
+        const int g = glyph_index(*text);
+        const int first = narrow_font ? narrow.span[g].first : 0;
+        const int width = narrow_font ? narrow.span[g].width : 8;
+        const int glyph_cols = (width < 8 - first ? width : 8 - first) * S;
+        int cols = stride - x < glyph_cols ? stride - x : glyph_cols;
+        if (cols > 0 && strip) {
+            const uint8_t *src = &font.bytes[g * scaled_font<S>::glyph_bytes + first * S];
+            for (int p = 0; p < S; p++)
+                memcpy(strip + p * stride + x, src + p * 8 * S, cols);
+        }
+        x += width * S;
+    }
+    return x;
+}
+
+extern "C" int big_font_draw(uint8_t *strip, int stride, int x, const char *text, int scale,
+                             int narrow_font) {
+    return scale == 3 ? draw<3>(strip, stride, x, text, narrow_font)
+                      : draw<2>(strip, stride, x, text, narrow_font);
+}
+
+extern "C" int big_font_width(const char *text, int scale, int narrow_font) {
+    return big_font_draw(NULL, 0, 0, text, scale, narrow_font);
+}
@@ -0,0 +1,36 @@
+/*
+ * big_font.h
+ *
+ * Digits and symbols (U+0020 to U+003F) at two and three times the size of
+ * font8x8_basic_tr, for prices.  The glyphs are generated at compile time
+ * (big_font.cpp) from the row-major 8x8 source, already scaled and
+ * transposed into GDDRAM order: a glyph at scale s is s pages of 8 * s
+ * columns, so drawing one is a memcpy per page.
+ *
+ * The narrow variant is proportional: each glyph keeps only the columns
+ * its source uses plus one of spacing, which makes "1.14096" at 2x 94
+ * columns wide instead of 112.
+ */
+
+#ifndef MAIN_BIG_FONT_H_
+#define MAIN_BIG_FONT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Draw text at scale 2 or 3 into a strip of `scale` pages, page p starting
+// at strip + p * stride, from column x on.  Characters outside the font
+// come out as '?', anything past the strip's width is cut off.  Returns
+// the column after the text.
+int big_font_draw(uint8_t *strip, int stride, int x, const char *text, int scale, int narrow);
+// Columns text would take, without drawing it
+int big_font_width(const char *text, int scale, int narrow);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_BIG_FONT_H_ */
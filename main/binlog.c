@@ -0,0 +1,206 @@
+/*
+ * binlog.c
+ *
+ * Deferred binary logging, see binlog.h
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "binlog.h"
+
+typedef struct {
+    const binlog_fmt_t *fmt;
+    uint32_t seq;  // position + 1 once the record is complete
+    TickType_t ticks;
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_rec_t;
+
+// Writers reserve positions by advancing head, the flushing task consumes
+// them by advancing tail.  Positions are free-running, the slot is
+// position % BINLOG_RING_LEN.
+typedef struct {
+    uint32_t head, tail;
+    uint32_t dropped;
+    binlog_rec_t recs[BINLOG_RING_LEN];
+} binlog_ring_t;
+
+static binlog_ring_t rings[portNUM_PROCESSORS];
+
+static int is_conversion(char c) {
+    return strchr("diouxXcfFeEgGaAsp", c) != NULL;
+}
+
+static int is_float_conversion(char c) {
+    return strchr("fFeEgGaA", c) != NULL;
+}
+
+// Walk the conversions of fmt->format to find the argument types
+static void parse_format(binlog_fmt_t *fmt) {
+    uint8_t nargs = 0, floats = 0;
+    for (const char *p = fmt->format; *p; p++) {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+        while (*p && !is_conversion(*p))
+            p++;
+        if (!*p)
+            break;
+        if (nargs < BINLOG_MAX_ARGS) {
+            floats |= is_float_conversion(*p) << nargs;
+            nargs++;
+        }
+    }
+    fmt->nargs = nargs;
+    fmt->floats = floats;
+    // racing writers on the other core compute the same, that's fine
+    __atomic_store_n(&fmt->parsed, 1, __ATOMIC_RELEASE);
+}
+
+void binlog_write(binlog_fmt_t *fmt, ...) {
+    if (!__atomic_load_n(&fmt->parsed, __ATOMIC_ACQUIRE))
+        parse_format(fmt);
+
+    binlog_ring_t *ring = &rings[xPortGetCoreID()];
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    do {
+        if (pos - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= BINLOG_RING_LEN) {
+            __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    binlog_rec_t *rec = &ring->recs[pos % BINLOG_RING_LEN];
+    rec->fmt = fmt;
+    rec->ticks = xPortInIsrContext() ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+    va_list ap;
+    va_start(ap, fmt);
+    for (int i = 0; i < fmt->nargs; i++) {
+        if (fmt->floats & (1 << i)) {
+            float f = va_arg(ap, double);
+            memcpy(&rec->args[i], &f, sizeof f);
+        } else {
+            rec->args[i] = va_arg(ap, unsigned int);
+        }
+    }
+    va_end(ap);
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+// Format a record like printf would have, into out
+static void decode(const binlog_rec_t *rec, char *out, size_t size) {
+    const binlog_fmt_t *fmt = rec->fmt;
+    size_t len = 0;
+    int arg = 0;
+    for (const char *p = fmt->format; *p && len + 1 < size; ) {
+        if (*p != '%' || p[1] == '%') {
+            out[len++] = *p;
+            p += *p == '%' ? 2 : 1;
+            continue;
+        }
+        // copy the conversion spec without length modifiers, the
+        // arguments are all 32 bits now
+        char spec[16];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p && !is_conversion(*p)) {
+            if (!strchr("hlLqjzt", *p) && n < sizeof spec - 2)
+                spec[n++] = *p;
+            p++;
+        }
+        if (!*p)
+            break;
+        const char conv = *p++;
+        spec[n++] = conv;
+        spec[n] = 0;
+
+        int w;
+        if (conv == 's' || arg >= fmt->nargs) {
+            w = snprintf(out + len, size - len, "<?>");
+        } else if (fmt->floats & (1 << arg)) {
+            float f;
+            memcpy(&f, &rec->args[arg], sizeof f);
+            w = snprintf(out + len, size - len, spec, (double)f);
+        } else if (conv == 'p') {
+            w = snprintf(out + len, size - len, "0x%08x", rec->args[arg]);
+        } else {
+            w = snprintf(out + len, size - len, spec, rec->args[arg]);
+        }
+        arg++;
+        if (w > 0)
+            len += w;
+        if (len >= size)
+            len = size - 1;
+    }
+    out[len] = 0;
+}
+
+static void print(const binlog_rec_t *rec) {
+    static const char letters[] = "NEWIDV";
+    static const char *const colors[] = {
+        "", LOG_COLOR_E, LOG_COLOR_W, LOG_COLOR_I, LOG_COLOR_D, LOG_COLOR_V,
+    };
+    const binlog_fmt_t *fmt = rec->fmt;
+    char text[128];
+    decode(rec, text, sizeof text);
+    esp_log_write(fmt->level, fmt->log_tag, "%s%c (%u) %s: %s" LOG_RESET_COLOR "\n",
+                  colors[fmt->level], letters[fmt->level],
+                  (unsigned)(rec->ticks * portTICK_PERIOD_MS), fmt->log_tag, text);
+}
+
+// The ring's oldest complete record, NULL if there is none
+static const binlog_rec_t *peek(binlog_ring_t *ring) {
+    const uint32_t tail = ring->tail;
+    const binlog_rec_t *rec = &ring->recs[tail % BINLOG_RING_LEN];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1)
+        return NULL;
+    return rec;
+}
+
+// Take the records out in order of time, printing them if print_them
+static int drain(int print_them) {
+    int count = 0;
+    while (1) {
+        // merge the cores' rings by time
+        binlog_ring_t *next = NULL;
+        const binlog_rec_t *next_rec = NULL;
+        for (int i = 0; i < portNUM_PROCESSORS; i++) {
+            const binlog_rec_t *rec = peek(&rings[i]);
+            if (rec && (!next_rec || (int32_t)(rec->ticks - next_rec->ticks) < 0)) {
+                next = &rings[i];
+                next_rec = rec;
+            }
+        }
+        if (!next)
+            break;
+
+        // copy it out before handing the slot back to the writers
+        binlog_rec_t rec = *next_rec;
+        __atomic_store_n(&next->tail, next->tail + 1, __ATOMIC_RELEASE);
+        if (print_them)
+            print(&rec);
+        count++;
+    }
+    return count;
+}
+
+int binlog_flush() {
+    const int count = drain(1);
+
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        const uint32_t dropped = __atomic_exchange_n(&rings[i].dropped, 0, __ATOMIC_RELAXED);
+        if (dropped)
+            ESP_LOGW("binlog", "%u messages dropped on core %d", dropped, i);
+    }
+    return count;
+}
+
+int binlog_discard() {
+    return drain(0);
+}
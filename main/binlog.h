@@ -0,0 +1,68 @@
+/*
+ * binlog.h
+ *
+ * Deferred binary logging for the hot paths.  BINLOGx(tag, format, ...)
+ * formats nothing: it stores which message it is (the address of a static
+ * descriptor with level, tag and format) together with the tick count and
+ * the raw arguments in a ring buffer of the current core.  binlog_flush(),
+ * called from one low-priority task, decodes the records and prints them
+ * through esp_log_write() in the usual "L (ms) tag: message" format.
+ *
+ * The rings are lock-free (a compare-and-swap reserves a slot, a sequence
+ * number commits it), so BINLOG may also be used from interrupts.  When a
+ * ring is full, new messages are dropped and counted.
+ *
+ * Arguments are stored as 32-bit words, at most BINLOG_MAX_ARGS of them.
+ * Supported conversions are those of int (%d %i %u %x %X %o %c) and of
+ * floating point (%f %e %g, stored as float); %s is not, the string may be
+ * gone by the time the message is printed.  The format is parsed once, the
+ * first time a message is logged.
+ */
+
+#ifndef MAIN_BINLOG_H_
+#define MAIN_BINLOG_H_
+
+#include <stdint.h>
+
+#include "esp_log.h"
+
+#define BINLOG_MAX_ARGS 4
+#define BINLOG_RING_LEN 64  // records per core
+
+// Messages above this level are compiled out, like ESP_LOGx does with
+// LOG_LOCAL_LEVEL.  Raising it costs a few cycles per message rather than a
+// printf, so debug messages can stay on in time-critical code.
+#ifndef BINLOG_LEVEL
+#define BINLOG_LEVEL LOG_LOCAL_LEVEL
+#endif
+
+typedef struct {
+    esp_log_level_t level;
+    const char *log_tag;  // main.c #defines "tag"
+    const char *format;
+    // filled in on first use
+    uint8_t parsed;
+    uint8_t nargs;
+    uint8_t floats;  // bit i: argument i is floating point
+} binlog_fmt_t;
+
+void binlog_write(binlog_fmt_t *fmt, ...);
+// Print everything recorded so far, returns the number of messages
+int binlog_flush();
+// Drop everything recorded so far unprinted, returns the number of messages
+int binlog_discard();
+
+#define BINLOG(level, tag, format, ...) do {                                \
+        if (BINLOG_LEVEL >= level) {                                        \
+            static binlog_fmt_t binlog_fmt_ = { level, tag, format };       \
+            binlog_write(&binlog_fmt_, ##__VA_ARGS__);                      \
+        }                                                                   \
+    } while (0)
+
+#define BINLOGE(tag, format, ...) BINLOG(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
+#define BINLOGW(tag, format, ...) BINLOG(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
+#define BINLOGI(tag, format, ...) BINLOG(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
+#define BINLOGD(tag, format, ...) BINLOG(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
+#define BINLOGV(tag, format, ...) BINLOG(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif /* MAIN_BINLOG_H_ */
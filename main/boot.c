@@ -0,0 +1,84 @@
+/*
+ * boot.c
+ *
+ * Boot timeline, see boot.h
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "boot.h"
+
+static const char *const mark_names[BOOT_NUM_MARKS] = {
+    [BOOT_APP_MAIN] = "app_main",
+    [BOOT_NVS] = "nvs",
+    [BOOT_LEDS] = "leds",
+    [BOOT_WIFI_START] = "wifi_start",
+    [BOOT_DISPLAY] = "display",
+    [BOOT_TASKS] = "tasks",
+    [BOOT_FIRST_FRAME] = "first_frame",
+    [BOOT_CACHED_QUOTES] = "cached_quotes",
+    [BOOT_ASSOC] = "assoc",
+    [BOOT_GOT_IP] = "got_ip",
+    [BOOT_PORTAL] = "portal",
+    [BOOT_FIRST_QUOTE] = "first_quote",
+};
+
+static int64_t marks[BOOT_NUM_MARKS];  // 0: not reached yet
+static uint8_t report_pending;
+static portMUX_TYPE boot_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_mark(boot_mark_t mark) {
+    if (marks[mark])
+        return;  // the common case, called from loops
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&boot_mux);
+    if (!marks[mark]) {
+        marks[mark] = now ? now : 1;
+        if (mark == BOOT_FIRST_QUOTE)
+            report_pending = 1;
+    }
+    portEXIT_CRITICAL(&boot_mux);
+}
+
+int boot_report_due() {
+    portENTER_CRITICAL(&boot_mux);
+    const int due = report_pending;
+    report_pending = 0;
+    portEXIT_CRITICAL(&boot_mux);
+    return due;
+}
+
+void boot_report() {
+    int64_t copy[BOOT_NUM_MARKS];
+    portENTER_CRITICAL(&boot_mux);
+    for (int i = 0; i < BOOT_NUM_MARKS; i++)
+        copy[i] = marks[i];
+    portEXIT_CRITICAL(&boot_mux);
+
+    printf("boot:    ms     +ms  milestone\n");
+    // selection by time, there are only a handful
+    int64_t prev = 0;
+    uint32_t printed = 0;
+    for (int n = 0; n < BOOT_NUM_MARKS; n++) {
+        int next = -1;
+        for (int i = 0; i < BOOT_NUM_MARKS; i++) {
+            if (copy[i] && !(printed & (1u << i)) &&
+                (next < 0 || copy[i] < copy[next]))
+                next = i;
+        }
+        if (next < 0)
+            break;
+        printed |= 1u << next;
+        printf("  %8.1f %7.1f  %s\n", copy[next] / 1000.0,
+               prev ? (copy[next] - prev) / 1000.0 : 0.0, mark_names[next]);
+        prev = copy[next];
+    }
+
+    if (copy[BOOT_FIRST_FRAME] && copy[BOOT_FIRST_QUOTE]) {
+        printf("boot: first frame after %.1f ms, first quote after %.1f ms\n",
+               copy[BOOT_FIRST_FRAME] / 1000.0, copy[BOOT_FIRST_QUOTE] / 1000.0);
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * boot.h
+ *
+ * Boot timeline.  Each startup milestone is timestamped the first time it
+ * is reached (esp_timer_get_time(), in us since the timer started early in
+ * the ESP-IDF startup code, so ROM and bootloader time isn't included).
+ * Once the first quote is on the display, the console task prints the
+ * milestones in the order they happened:
+ *
+ *   boot:    ms     +ms  milestone
+ *        12.3     0.4  nvs
+ *
+ * followed by the two numbers that matter, time to first LED frame and
+ * time to first quote.  Milestones of concurrent tasks interleave, so +ms
+ * is only the gap to the line above, not how long that step took.
+ */
+
+#ifndef MAIN_BOOT_H_
+#define MAIN_BOOT_H_
+
+typedef enum {
+    BOOT_APP_MAIN,      // app_main() entered
+    BOOT_NVS,           // nvs_flash_init() done
+    BOOT_LEDS,          // RMT set up, strand reset
+    BOOT_WIFI_START,    // esp_wifi_start() returned, association under way
+    BOOT_DISPLAY,       // OLED initialised and cleared
+    BOOT_TASKS,         // app_main() done starting tasks
+    BOOT_FIRST_FRAME,   // first sort frame handed to the LED driver
+    BOOT_CACHED_QUOTES, // quotes restored from flash on the display
+    BOOT_ASSOC,         // associated with the AP
+    BOOT_GOT_IP,        // DHCP lease
+    BOOT_PORTAL,        // past the captive portal
+    BOOT_FIRST_QUOTE,   // first quote page on the display
+    BOOT_NUM_MARKS
+} boot_mark_t;
+
+// Timestamp a milestone, later calls for the same one are ignored
+void boot_mark(boot_mark_t mark);
+// Print the timeline so far
+void boot_report();
+// Has the first quote been shown since the last call?  For printing once.
+int boot_report_due();
+
+#endif /* MAIN_BOOT_H_ */
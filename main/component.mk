@@ -6,3 +6,8 @@
 # in the build directory. This behaviour is entirely configurable,
 # please read the ESP-IDF documents if you need to do this.
 #
+
+# The LED driver only needs the encoder for the hat's strand (see
+# esp32_digital_led_lib.h), which saves the IRAM of the other eight.
+# main/CMakeLists.txt sets the same for the CMake build.
+CXXFLAGS += -DDIGITALLEDS_TYPES="(1 << LED_SK6812W_V1)"
@@ -0,0 +1,56 @@
+/*
+ * compositor.c
+ *
+ * LED layer blending, see compositor.h
+ */
+
+#include <string.h>
+
+#include "compositor.h"
+
+// 8.8 alpha of pixel i, already scaled by the layer's opacity
+static inline uint32_t pixel_alpha(const uint16_t *alpha, uint32_t opacity, int i) {
+    const uint32_t a = alpha[i] * opacity >> 8;
+    return a < COMP_OPAQUE ? a : COMP_OPAQUE;
+}
+
+// The four combinations of colour source and alpha source get their own
+// loop, so that neither is decided per pixel
+static void blend_layer(uint32_t *out, const comp_layer_t *l, int n) {
+    const uint32_t opacity = l->opacity < COMP_OPAQUE ? l->opacity : COMP_OPAQUE;
+    if (!l->alpha && !opacity)
+        return;
+
+    if (l->pixels && l->alpha) {
+        for (int i = 0; i < n; i++) {
+            const uint32_t a = pixel_alpha(l->alpha, opacity, i);
+            if (a)
+                out[i] = comp_lerp(out[i], l->pixels[i], a);
+        }
+    } else if (l->alpha) {
+        for (int i = 0; i < n; i++) {
+            const uint32_t a = pixel_alpha(l->alpha, opacity, i);
+            if (a)
+                out[i] = comp_lerp(out[i], l->colour, a);
+        }
+    } else if (l->pixels) {
+        for (int i = 0; i < n; i++)
+            out[i] = comp_lerp(out[i], l->pixels[i], opacity);
+    } else {
+        for (int i = 0; i < n; i++)
+            out[i] = comp_lerp(out[i], l->colour, opacity);
+    }
+}
+
+void comp_render(uint32_t *out, const comp_layer_t *layers, int count, int n) {
+    if (count < 1)
+        return;
+    if (layers[0].pixels) {
+        memcpy(out, layers[0].pixels, n * sizeof *out);
+    } else {
+        for (int i = 0; i < n; i++)
+            out[i] = layers[0].colour;
+    }
+    for (int l = 1; l < count; l++)
+        blend_layer(out, &layers[l], n);
+}
@@ -0,0 +1,44 @@
+/*
+ * compositor.h
+ *
+ * Stacks LED effect layers into one frame.  The bottom layer is opaque, each
+ * one above is blended over what is below it by an 8.8 fixed-point alpha
+ * (0x100 is opaque): per pixel, from the layer's own alpha array, times the
+ * layer's opacity.
+ *
+ * Pixels are the 32-bit words of pixelColor_t (esp32_digital_led_lib.h),
+ * and the blend works on a whole word at a time: two bytes per 32-bit
+ * multiply, with 16 bits of room each, so a pixel takes four multiplies
+ * whatever the channel order.  Pixels where a layer's alpha is 0 are
+ * skipped, so a narrow effect costs little more than copying the base.
+ */
+
+#ifndef MAIN_COMPOSITOR_H_
+#define MAIN_COMPOSITOR_H_
+
+#include <stdint.h>
+
+#define COMP_OPAQUE 0x100
+
+typedef struct {
+    const uint32_t *pixels;  // a colour per pixel, or NULL for `colour` everywhere
+    uint32_t colour;
+    const uint16_t *alpha;   // 8.8 per pixel, or NULL for `opacity` everywhere
+    uint16_t opacity;        // 8.8, scales alpha
+} comp_layer_t;
+
+// One pixel: d + (s - d) * a, a from 0 to COMP_OPAQUE.  Even and odd bytes
+// are blended in separate lanes, neither sum can carry into the next byte
+// because the two weights add up to 0x100.
+static inline uint32_t comp_lerp(uint32_t d, uint32_t s, uint32_t a) {
+    const uint32_t na = COMP_OPAQUE - a;
+    const uint32_t even = ((d & 0x00FF00FF) * na + (s & 0x00FF00FF) * a) >> 8;
+    const uint32_t odd = (d >> 8 & 0x00FF00FF) * na + (s >> 8 & 0x00FF00FF) * a;
+    return (even & 0x00FF00FF) | (odd & 0xFF00FF00);
+}
+
+// Composite count layers of n pixels into out, layers[0] at the bottom.
+// Its alpha and opacity are ignored.
+void comp_render(uint32_t *out, const comp_layer_t *layers, int count, int n);
+
+#endif /* MAIN_COMPOSITOR_H_ */
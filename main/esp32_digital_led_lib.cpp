@@ -1,5 +1,5 @@
 /* 
- * Library for driving digital RGB(W) LEDs using the ESP32's RMT peripheral
+ * Library for driving digital RGB(W) LEDs using the ESP32's RMT or SPI peripheral
  *
  * Modifications Copyright (c) 2017 Martin F. Falatic
  *
@@ -38,13 +38,19 @@ extern "C" {
   #include "esp_intr.h"
   #include "driver/gpio.h"
   #include "driver/rmt.h"
+  #include "driver/spi_master.h"
   #include "driver/periph_ctrl.h"
+  #include "esp_heap_caps.h"
+  #include "esp_timer.h"
   #include "freertos/semphr.h"
   #include "soc/rmt_struct.h"
 #elif defined(ESP_PLATFORM)
   #include <esp_intr.h>
   #include <driver/gpio.h>
   #include <driver/rmt.h>
+  #include <driver/spi_master.h>
+  #include <esp_heap_caps.h>
+  #include <esp_timer.h>
   #include <freertos/FreeRTOS.h>
   #include <freertos/semphr.h>
   #include <soc/dport_reg.h>
@@ -63,9 +69,20 @@ extern char * digitalLeds_debugBuffer;
 extern int digitalLeds_debugBufferSz;
 #endif
 
-static DRAM_ATTR const uint16_t MAX_PULSES = 32;  // A channel has a 64 "pulse" buffer - we use half per pass
-static DRAM_ATTR const uint16_t DIVIDER    =  4;  // 8 still seems to work, but timings become marginal
-static DRAM_ATTR const double   RMT_DURATION_NS = 12.5;  // Minimum time of a single RMT duration based on clock ns
+#include <stddef.h>
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+static constexpr uint16_t MAX_PULSES = 32;  // A channel has a 64 "pulse" buffer - we use half per pass
+static constexpr uint16_t DIVIDER    =  4;  // 8 still seems to work, but timings become marginal
+static constexpr double   RMT_DURATION_NS = 12.5;  // Minimum time of a single RMT duration based on clock ns
+
+static constexpr uint32_t APB_CLK_HZ = 80000000;  // SPI clocks are this divided by an integer
+static constexpr uint32_t SPI_TOLERANCE_NS = 100;  // per high or low time, datasheets allow 150
+static constexpr uint32_t SPI_DIVIDER_MAX = 64;  // 800 ns per SPI bit, the longest worth trying
+static constexpr uint32_t SPI_DIVIDER_MIN = 4;  // 20 MHz
+static constexpr uint32_t SPI_MAX_SLOTS = 8;  // SPI bits per LED bit, so that each makes at most one byte
 
 // LUT for mapping bits in RMT.int_<op>.ch<n>_tx_thr_event
 static DRAM_ATTR const uint32_t tx_thr_event_offsets [] = {
@@ -102,21 +119,202 @@ typedef union {
 } rmtPulsePair;
 
 typedef struct {
-  uint8_t * buf_data;
-  uint16_t buf_pos, buf_len, buf_half, buf_isDirty;
+  uint16_t buf_pos, buf_len, buf_half, buf_isDirty;  // in bytes on the wire
+  uint8_t bytesPerPixel;
+  volatile uint8_t busy;  // transmitting, sem is given when done
   xSemaphoreHandle sem;
-  rmtPulsePair pulsePairMap[2];
+  StaticSemaphore_t semBuffer;
+  bool (*encodeHalf)(strand_t * pStrand);  // Strand<ledType>::encodeHalf
+  // The schedule of the frame in flight, in RMT ticks from frameStartUs
+  int64_t frameStartUs;
+  uint32_t halfTicks[2];  // of the items in each half
+  uint32_t eventTicks;  // when the RMT is done with the next half
+  uint32_t frameRefills;
+  portMUX_TYPE statsMux;
+  digitalLeds_stats_t stats;
 } digitalLeds_stateData;
 
-static strand_t * localStrands;
-static int localStrandCnt = 0;
+// A strand sent by SPI: the frame is encoded into buf, and DMA sends it
+typedef struct {
+  spi_device_handle_t dev;
+  spi_transaction_t trans;
+  uint8_t * buf;
+  uint8_t busy;  // trans is queued, its result not collected yet
+  size_t (*encodeSpi)(const pixelColor_t * pixels, int numPixels, uint8_t * out);
+} digitalLeds_spiState;
+
+static constexpr uint32_t rmtTicks(uint32_t ns)
+{
+  return static_cast<uint32_t>(ns / (RMT_DURATION_NS * DIVIDER));
+}
 
-static intr_handle_t rmt_intr_handle = nullptr;
+static constexpr int64_t rmtTicksToUs(uint32_t ticks)
+{
+  return static_cast<int64_t>(ticks) * static_cast<int64_t>(RMT_DURATION_NS * 2 * DIVIDER) / 2000;
+}
+
+static inline uint32_t cycleCount()
+{
+#if defined(__XTENSA__)
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+  return ccount;
+#elif defined(__x86_64__) || defined(__i386__)
+  return static_cast<uint32_t>(__rdtsc());
+#else
+  return static_cast<uint32_t>(esp_timer_get_time());
+#endif
+}
+
+// rmtPulsePair.val of a high and a low level
+static constexpr uint32_t rmtPulse(uint32_t highNs, uint32_t lowNs)
+{
+  return rmtTicks(highNs) | 1u << 15 | rmtTicks(lowNs) << 16;
+}
+
+// A duration in SPI bits ("slots") of APB_CLK_HZ / divider, rounded, at
+// least one.  A slot is 25 * divider half nanoseconds.
+static constexpr uint32_t spiSlots(uint32_t ns, uint32_t divider)
+{
+  return (4 * ns + 25 * divider) / (50 * divider) ? (4 * ns + 25 * divider) / (50 * divider) : 1;
+}
+
+static constexpr bool spiFits(uint32_t ns, uint32_t divider)
+{
+  return spiSlots(ns, divider) * 25 * divider <= 2 * (ns + SPI_TOLERANCE_NS) &&
+         spiSlots(ns, divider) * 25 * divider + 2 * SPI_TOLERANCE_NS >= 2 * ns;
+}
+
+// The slowest SPI clock, for the smallest buffer, at which all four
+// durations of p are within SPI_TOLERANCE_NS.  0 if there is none.
+static constexpr uint32_t spiDividerFor(const ledParams_t & p, uint32_t divider = SPI_DIVIDER_MAX)
+{
+  return divider < SPI_DIVIDER_MIN ? 0 :
+         spiFits(p.T0H, divider) && spiFits(p.T0L, divider) &&
+         spiFits(p.T1H, divider) && spiFits(p.T1L, divider) &&
+         spiSlots(p.T0H, divider) + spiSlots(p.T0L, divider) <= SPI_MAX_SLOTS &&
+         spiSlots(p.T1H, divider) + spiSlots(p.T1L, divider) <= SPI_MAX_SLOTS ? divider :
+         spiDividerFor(p, divider - 1);
+}
+
+// SPI bits of a high and a low level, lowest bit last on the wire
+static constexpr uint32_t spiSymbol(uint32_t highSlots, uint32_t lowSlots)
+{
+  return ((1u << highSlots) - 1) << lowSlots;
+}
+
+// Byte offsets in pixelColor_t of the channels in the order they are sent,
+// lowest byte first
+static constexpr uint32_t ORDER_GRBW =
+  offsetof(pixelColor_t, g) | offsetof(pixelColor_t, r) << 8 |
+  offsetof(pixelColor_t, b) << 16 | offsetof(pixelColor_t, w) << 24;
+
+// Everything the encoder needs to know about an LED type, at compile time
+template <int Type>
+struct LedTraits {
+  static constexpr int width = ledParamsAll[Type].bytesPerPixel;
+  // every type in ledParamsAll takes G, R, B (W), like pixelColor_t
+  static constexpr uint32_t order = ORDER_GRBW;
+  static constexpr uint32_t pulse0 = rmtPulse(ledParamsAll[Type].T0H, ledParamsAll[Type].T0L);
+  static constexpr uint32_t pulse1 = rmtPulse(ledParamsAll[Type].T1H, ledParamsAll[Type].T1L);
+  static constexpr uint32_t resetTicks = rmtTicks(ledParamsAll[Type].TRS);
+  // of a 0 and a 1, and of their low level
+  static constexpr uint32_t ticks0 = rmtTicks(ledParamsAll[Type].T0H) + rmtTicks(ledParamsAll[Type].T0L);
+  static constexpr uint32_t ticks1 = rmtTicks(ledParamsAll[Type].T1H) + rmtTicks(ledParamsAll[Type].T1L);
+  static constexpr uint32_t lowTicks0 = rmtTicks(ledParamsAll[Type].T0L);
+  static constexpr uint32_t lowTicks1 = rmtTicks(ledParamsAll[Type].T1L);
+
+  // SPI: a 0 is spiLen0 bits spiSymbol0 at APB_CLK_HZ / spiDivider, a 1 spiLen1
+  // bits spiSymbol1
+  static constexpr uint32_t spiDivider = spiDividerFor(ledParamsAll[Type]);
+  static constexpr uint32_t spiHigh0 = spiSlots(ledParamsAll[Type].T0H, spiDivider);
+  static constexpr uint32_t spiLow0 = spiSlots(ledParamsAll[Type].T0L, spiDivider);
+  static constexpr uint32_t spiHigh1 = spiSlots(ledParamsAll[Type].T1H, spiDivider);
+  static constexpr uint32_t spiLow1 = spiSlots(ledParamsAll[Type].T1L, spiDivider);
+  static constexpr uint32_t spiLen0 = spiHigh0 + spiLow0, spiLen1 = spiHigh1 + spiLow1;
+  static constexpr uint32_t spiSymbol0 = spiSymbol(spiHigh0, spiLow0);
+  static constexpr uint32_t spiSymbol1 = spiSymbol(spiHigh1, spiLow1);
+  static constexpr uint32_t spiResetBits = (2 * ledParamsAll[Type].TRS + 25 * spiDivider - 1) / (25 * spiDivider);
+  static constexpr uint32_t spiBitsPerPixel = 8 * width * (spiLen0 > spiLen1 ? spiLen0 : spiLen1);
+
+  static_assert(width == 3 || width == 4, "pixels are 3 or 4 bytes");
+  static_assert(rmtTicks(ledParamsAll[Type].T0L) < 0x8000 &&
+                rmtTicks(ledParamsAll[Type].T1L) < 0x8000 && resetTicks < 0x8000,
+                "RMT durations are 15 bits");
+  static_assert(spiDivider != 0, "an SPI clock fits the timing");
+  static_assert(spiResetBits >= 8, "the reset covers the last byte's padding");
+};
+
+// A strand of one LED type.  Only the encoder depends on the type, the C
+// functions below pick the instantiation for strand_t.ledType at init.
+template <int Type>
+struct Strand {
+  typedef LedTraits<Type> Traits;
+
+  static bool encodeHalf(strand_t * pStrand);
+  static size_t encodeSpi(const pixelColor_t * pixels, int numPixels, uint8_t * out);
+};
 
 // Forward declarations of local functions
-static void copyToRmtBlock_half(strand_t * pStrand);
+static void waitIdle(digitalLeds_stateData * pState);
 static void handleInterrupt(void *arg);
 
+static int spiInit(strand_t * pStrand);
+static int spiUpdatePixels(strand_t * pStrand);
+static void spiWaitIdle(digitalLeds_spiState * pState);
+
+// The encoders of a type and the SPI format they produce
+typedef struct {
+  bool (*encodeHalf)(strand_t * pStrand);
+  size_t (*encodeSpi)(const pixelColor_t * pixels, int numPixels, uint8_t * out);
+  uint32_t spiDivider;
+  uint32_t spiBitsPerPixel;  // at most
+  uint32_t spiResetBits;
+} ledEncoder;
+
+// The encoders of a type, if DIGITALLEDS_TYPES has it, without instantiating
+// the others
+template <int Type, bool = ((DIGITALLEDS_TYPES >> Type) & 1) != 0>
+struct EncoderFor {
+  typedef LedTraits<Type> Traits;
+  static constexpr ledEncoder value() {
+    return ledEncoder{Strand<Type>::encodeHalf, Strand<Type>::encodeSpi,
+                      Traits::spiDivider, Traits::spiBitsPerPixel, Traits::spiResetBits};
+  }
+};
+
+template <int Type>
+struct EncoderFor<Type, false> {
+  static constexpr ledEncoder value() {
+    return ledEncoder{nullptr, nullptr, 0, 0, 0};
+  }
+};
+
+// Still must match order of `led_types`
+static const ledEncoder encoders[] = {
+  EncoderFor<LED_WS2812_V1>::value(),
+  EncoderFor<LED_WS2812B_V1>::value(),
+  EncoderFor<LED_WS2812B_V2>::value(),
+  EncoderFor<LED_WS2812B_V3>::value(),
+  EncoderFor<LED_WS2813_V1>::value(),
+  EncoderFor<LED_WS2813_V2>::value(),
+  EncoderFor<LED_WS2813_V3>::value(),
+  EncoderFor<LED_SK6812_V1>::value(),
+  EncoderFor<LED_SK6812W_V1>::value(),
+};
+static_assert(sizeof encoders / sizeof encoders[0] == sizeof ledParamsAll / sizeof ledParamsAll[0],
+              "an encoder for every LED type");
+
+// One per RMT channel, so that no strand needs heap for its state
+static digitalLeds_stateData stateAll[8];
+// One per SPI host, HSPI_HOST and VSPI_HOST
+static digitalLeds_spiState spiStateAll[2];
+
+static strand_t * localStrands;
+static int localStrandCnt = 0;
+
+static intr_handle_t rmt_intr_handle = nullptr;
+
 
 int digitalLeds_initStrands(strand_t strands [], int numStrands)
 {
@@ -137,27 +335,45 @@ int digitalLeds_initStrands(strand_t strands [], int numStrands)
   RMT.apb_conf.fifo_mask = 1;  // Enable memory access, instead of FIFO mode
   RMT.apb_conf.mem_tx_wrap_en = 1;  // Wrap around when hitting end of buffer
 
+  int rmtStrandCnt = 0;
   for (int i = 0; i < localStrandCnt; i++) {
     strand_t * pStrand = &localStrands[i];
-    ledParams_t ledParams = ledParamsAll[pStrand->ledType];
 
-    pStrand->pixels = static_cast<pixelColor_t*>(malloc(pStrand->numPixels * sizeof(pixelColor_t)));
-    if (pStrand->pixels == nullptr) {
+    if (pStrand->ledType < 0 || pStrand->ledType >= static_cast<int>(sizeof encoders / sizeof encoders[0]) ||
+        encoders[pStrand->ledType].encodeHalf == nullptr) {
       return -1;
     }
 
-    pStrand->_stateVars = static_cast<digitalLeds_stateData*>(malloc(sizeof(digitalLeds_stateData)));
-    if (pStrand->_stateVars == nullptr) {
-      return -1;
+    if (pStrand->pixels == nullptr) {
+      pStrand->pixels = static_cast<pixelColor_t*>(malloc(pStrand->numPixels * sizeof(pixelColor_t)));
+      if (pStrand->pixels == nullptr) {
+        return -1;
+      }
+    }
+
+    if (pStrand->spiHost) {
+      if (spiInit(pStrand)) {
+        return -1;
+      }
+      continue;
     }
-    digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
 
-    pState->buf_len = (pStrand->numPixels * ledParams.bytesPerPixel);
-    pState->buf_data = static_cast<uint8_t*>(malloc(pState->buf_len));
-    if (pState->buf_data == nullptr) {
+    if (pStrand->rmtChannel < 0 || pStrand->rmtChannel >= 8) {
       return -1;
     }
-    pState->sem = nullptr;
+    rmtStrandCnt++;
+
+    pStrand->_stateVars = &stateAll[pStrand->rmtChannel];
+    digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
+
+    pState->bytesPerPixel = ledParamsAll[pStrand->ledType].bytesPerPixel;
+    pState->buf_len = 0;
+    pState->encodeHalf = encoders[pStrand->ledType].encodeHalf;
+    // created once, not per frame, so that updates don't touch the heap
+    pState->sem = xSemaphoreCreateBinaryStatic(&pState->semBuffer);
+    pState->busy = 0;
+    vPortCPUInitializeMutex(&pState->statsMux);
+    memset(&pState->stats, 0, sizeof pState->stats);
 
     rmt_set_pin(
       static_cast<rmt_channel_t>(pStrand->rmtChannel),
@@ -178,24 +394,14 @@ int digitalLeds_initStrands(strand_t strands [], int numStrands)
     RMT.conf_ch[pStrand->rmtChannel].conf1.idle_out_lv = 0;
   
     RMT.tx_lim_ch[pStrand->rmtChannel].limit = MAX_PULSES;
-  
-    // RMT config for transmitting a '0' bit val to this LED strand
-    pState->pulsePairMap[0].level0 = 1;
-    pState->pulsePairMap[0].level1 = 0;
-    pState->pulsePairMap[0].duration0 = ledParams.T0H / (RMT_DURATION_NS * DIVIDER);
-    pState->pulsePairMap[0].duration1 = ledParams.T0L / (RMT_DURATION_NS * DIVIDER);
-    
-    // RMT config for transmitting a '0' bit val to this LED strand
-    pState->pulsePairMap[1].level0 = 1;
-    pState->pulsePairMap[1].level1 = 0;
-    pState->pulsePairMap[1].duration0 = ledParams.T1H / (RMT_DURATION_NS * DIVIDER);
-    pState->pulsePairMap[1].duration1 = ledParams.T1L / (RMT_DURATION_NS * DIVIDER);
 
     RMT.int_ena.val |= tx_thr_event_offsets[pStrand->rmtChannel];  // RMT.int_ena.ch<n>_tx_thr_event = 1;
     RMT.int_ena.val |= tx_end_offsets[pStrand->rmtChannel];  // RMT.int_ena.ch<n>_tx_end = 1;
   }
   
-  esp_intr_alloc(ETS_RMT_INTR_SOURCE, 0, handleInterrupt, nullptr, &rmt_intr_handle);
+  if (rmtStrandCnt) {
+    esp_intr_alloc(ETS_RMT_INTR_SOURCE, 0, handleInterrupt, nullptr, &rmt_intr_handle);
+  }
 
   for (int i = 0; i < localStrandCnt; i++) {
     strand_t * pStrand = &localStrands[i];
@@ -207,49 +413,45 @@ int digitalLeds_initStrands(strand_t strands [], int numStrands)
 
 void digitalLeds_resetPixels(strand_t * pStrand)
 {
+  digitalLeds_waitIdle(pStrand);
   memset(pStrand->pixels, 0, pStrand->numPixels * sizeof(pixelColor_t));
+  pStrand->dirtyEnd = pStrand->numPixels;
   digitalLeds_updatePixels(pStrand);
 }
 
-int IRAM_ATTR digitalLeds_updatePixels(strand_t * pStrand)
+// The number of pixels to send, up to the last changed one, since the ones
+// after it keep their colour.  Resets dirtyEnd.
+static inline int takeDirty(strand_t * pStrand)
 {
-  digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
+  int dirty = pStrand->dirtyEnd;
+  if (dirty > pStrand->numPixels) {
+    dirty = pStrand->numPixels;
+  }
+  pStrand->dirtyEnd = 0;
+  return dirty > 0 ? dirty : 0;
+}
 
-  if (pState->sem) {
-    // Wait for any previously updating pixels.
-    xSemaphoreTake(pState->sem, portMAX_DELAY);
-    vSemaphoreDelete(pState->sem);
-    pState->sem = nullptr;
+int IRAM_ATTR digitalLeds_updatePixels(strand_t * pStrand)
+{
+  if (pStrand->spiHost) {
+    return spiUpdatePixels(pStrand);
   }
 
-  ledParams_t ledParams = ledParamsAll[pStrand->ledType];
+  digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
+
+  waitIdle(pState);
 
-  // Pack pixels into transmission buffer
-  if (ledParams.bytesPerPixel == 3) {
-    for (uint16_t i = 0; i < pStrand->numPixels; i++) {
-      // Color order is translated from RGB to GRB
-      pState->buf_data[0 + i * 3] = pStrand->pixels[i].g;
-      pState->buf_data[1 + i * 3] = pStrand->pixels[i].r;
-      pState->buf_data[2 + i * 3] = pStrand->pixels[i].b;
-    }
-  }
-  else if (ledParams.bytesPerPixel == 4) {
-    for (uint16_t i = 0; i < pStrand->numPixels; i++) {
-      // Color order is translated from RGBW to GRBW
-      pState->buf_data[0 + i * 4] = pStrand->pixels[i].g;
-      pState->buf_data[1 + i * 4] = pStrand->pixels[i].r;
-      pState->buf_data[2 + i * 4] = pStrand->pixels[i].b;
-      pState->buf_data[3 + i * 4] = pStrand->pixels[i].w;
-    }    
-  }
-  else {
-    return -1;
+  const int dirty = takeDirty(pStrand);
+  if (!dirty) {
+    return 0;  // the LEDs show this frame already
   }
+  pState->buf_len = dirty * pState->bytesPerPixel;
 
   pState->buf_pos = 0;
   pState->buf_half = 0;
+  pState->halfTicks[0] = pState->halfTicks[1] = 0;
 
-  copyToRmtBlock_half(pStrand);
+  pState->encodeHalf(pStrand);
 
   if (pState->buf_pos < pState->buf_len) {
     // Fill the other half of the buffer block
@@ -257,10 +459,17 @@ int IRAM_ATTR digitalLeds_updatePixels(strand_t * pStrand)
       snprintf(digitalLeds_debugBuffer, digitalLeds_debugBufferSz,
                "%s# ", digitalLeds_debugBuffer);
     #endif
-    copyToRmtBlock_half(pStrand);
+    pState->encodeHalf(pStrand);
   }
 
-  pState->sem = xSemaphoreCreateBinary();
+  pState->busy = 1;
+
+  pState->eventTicks = pState->halfTicks[0];
+  pState->frameRefills = 0;
+  portENTER_CRITICAL(&pState->statsMux);
+  pState->stats.frames++;
+  portEXIT_CRITICAL(&pState->statsMux);
+  pState->frameStartUs = esp_timer_get_time();
 
   RMT.conf_ch[pStrand->rmtChannel].conf1.mem_rd_rst = 1;
   RMT.conf_ch[pStrand->rmtChannel].conf1.tx_start = 1;
@@ -268,18 +477,177 @@ int IRAM_ATTR digitalLeds_updatePixels(strand_t * pStrand)
   return 0;
 }
 
-static IRAM_ATTR void copyToRmtBlock_half(strand_t * pStrand)
+void digitalLeds_waitIdle(strand_t * pStrand)
+{
+  if (pStrand->spiHost) {
+    spiWaitIdle(static_cast<digitalLeds_spiState*>(pStrand->_stateVars));
+  } else {
+    waitIdle(static_cast<digitalLeds_stateData*>(pStrand->_stateVars));
+  }
+}
+
+void digitalLeds_encodeHalf(strand_t * pStrand)
+{
+  if (pStrand->spiHost) {
+    return;
+  }
+  digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
+
+  waitIdle(pState);
+  // the whole strand, whatever the last update sent
+  pState->buf_len = pStrand->numPixels * pState->bytesPerPixel;
+  if (pState->buf_pos >= pState->buf_len) {
+    pState->buf_pos = 0;  // start over, so that every call encodes data
+  }
+  pState->encodeHalf(pStrand);
+}
+
+void digitalLeds_getStats(strand_t * pStrand, digitalLeds_stats_t * stats, int clear)
+{
+  if (pStrand->spiHost) {
+    memset(stats, 0, sizeof *stats);
+    return;
+  }
+  digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
+  portENTER_CRITICAL(&pState->statsMux);
+  *stats = pState->stats;
+  if (clear) {
+    memset(&pState->stats, 0, sizeof pState->stats);
+  }
+  portEXIT_CRITICAL(&pState->statsMux);
+}
+
+static bool typeValid(int ledType)
+{
+  return ledType >= 0 && ledType < static_cast<int>(sizeof encoders / sizeof encoders[0]) &&
+         encoders[ledType].encodeSpi != nullptr;
+}
+
+uint32_t digitalLeds_spiClockHz(int ledType)
+{
+  return typeValid(ledType) ? APB_CLK_HZ / encoders[ledType].spiDivider : 0;
+}
+
+size_t digitalLeds_spiBufferSize(int ledType, int numPixels)
+{
+  if (!typeValid(ledType)) {
+    return 0;
+  }
+  // the last byte of data is padded with the first bits of the reset
+  const ledEncoder & enc = encoders[ledType];
+  return (numPixels * enc.spiBitsPerPixel + enc.spiResetBits + 7) / 8 + 1;
+}
+
+size_t digitalLeds_encodeSpi(int ledType, const pixelColor_t * pixels, int numPixels, uint8_t * out)
+{
+  return typeValid(ledType) ? encoders[ledType].encodeSpi(pixels, numPixels, out) : 0;
+}
+
+static int spiInit(strand_t * pStrand)
+{
+  if (pStrand->spiHost != HSPI_HOST && pStrand->spiHost != VSPI_HOST) {
+    return -1;
+  }
+  const ledEncoder & enc = encoders[pStrand->ledType];
+  digitalLeds_spiState * pState = &spiStateAll[pStrand->spiHost - HSPI_HOST];
+  const size_t bufSize = digitalLeds_spiBufferSize(pStrand->ledType, pStrand->numPixels);
+
+  // DMA can only read internal RAM
+  pState->buf = static_cast<uint8_t*>(heap_caps_malloc(bufSize, MALLOC_CAP_DMA));
+  if (pState->buf == nullptr) {
+    return -1;
+  }
+
+  // MOSI only, the LEDs need neither clock nor chip select
+  spi_bus_config_t bus = {};
+  bus.mosi_io_num = pStrand->gpioNum;
+  bus.miso_io_num = -1;
+  bus.sclk_io_num = -1;
+  bus.quadwp_io_num = -1;
+  bus.quadhd_io_num = -1;
+  bus.max_transfer_sz = bufSize;
+  // DMA channel 1 for HSPI, 2 for VSPI
+  const spi_host_device_t host = static_cast<spi_host_device_t>(pStrand->spiHost);
+  if (spi_bus_initialize(host, &bus, pStrand->spiHost) != ESP_OK) {
+    return -1;
+  }
+
+  spi_device_interface_config_t dev = {};
+  dev.mode = 0;
+  dev.clock_speed_hz = APB_CLK_HZ / enc.spiDivider;
+  dev.spics_io_num = -1;
+  dev.queue_size = 1;
+  if (spi_bus_add_device(host, &dev, &pState->dev) != ESP_OK) {
+    return -1;
+  }
+
+  pState->encodeSpi = enc.encodeSpi;
+  pState->busy = 0;
+  pStrand->_stateVars = pState;
+  return 0;
+}
+
+static int spiUpdatePixels(strand_t * pStrand)
 {
-  // This fills half an RMT block
+  digitalLeds_spiState * pState = static_cast<digitalLeds_spiState*>(pStrand->_stateVars);
+
+  spiWaitIdle(pState);
+
+  const int dirty = takeDirty(pStrand);
+  if (!dirty) {
+    return 0;
+  }
+
+  memset(&pState->trans, 0, sizeof pState->trans);
+  pState->trans.length = 8 * pState->encodeSpi(pStrand->pixels, dirty, pState->buf);
+  pState->trans.tx_buffer = pState->buf;
+  if (spi_device_queue_trans(pState->dev, &pState->trans, portMAX_DELAY) != ESP_OK) {
+    return -1;
+  }
+  pState->busy = 1;
+  return 0;
+}
+
+static void spiWaitIdle(digitalLeds_spiState * pState)
+{
+  if (pState->busy) {
+    spi_transaction_t * trans;
+    spi_device_get_trans_result(pState->dev, &trans, portMAX_DELAY);
+    pState->busy = 0;
+  }
+}
+
+static IRAM_ATTR void waitIdle(digitalLeds_stateData * pState)
+{
+  if (pState->busy) {
+    // Wait for any previously updating pixels.
+    xSemaphoreTake(pState->sem, portMAX_DELAY);
+    pState->busy = 0;
+  }
+}
+
+template <int Type>
+IRAM_ATTR bool Strand<Type>::encodeHalf(strand_t * pStrand)
+{
+  // This fills half an RMT block, and returns whether it had to write to it
   // When wraparound is happening, we want to keep the inactive half of the RMT block filled
 
   digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
-  ledParams_t ledParams = ledParamsAll[pStrand->ledType];
+  volatile rmt_item32_t * items = RMTMEM.chan[pStrand->rmtChannel].data32;
+
+  // locals, so that they are immediates rather than loads
+  constexpr int width = Traits::width;
+  constexpr uint32_t order = Traits::order;
+  constexpr uint32_t pulse0 = Traits::pulse0, pulseDiff = Traits::pulse0 ^ Traits::pulse1;
+  constexpr uint32_t lowTicks0 = Traits::lowTicks0, lowTicks1 = Traits::lowTicks1;
 
   uint16_t i, j, offset, len, byteval;
+  uint32_t bitmask = 0, ones = 0;
+  const int half = pState->buf_half;
 
-  offset = pState->buf_half * MAX_PULSES;
-  pState->buf_half = !pState->buf_half;
+  offset = half * MAX_PULSES;
+  pState->buf_half = !half;
+  pState->halfTicks[half] = 0;
 
   len = pState->buf_len - pState->buf_pos;
   if (len > (MAX_PULSES / 8))
@@ -287,19 +655,27 @@ static IRAM_ATTR void copyToRmtBlock_half(strand_t * pStrand)
 
   if (!len) {
     if (!pState->buf_isDirty) {
-      return;
+      return false;
     }
     // Clear the channel's data block and return
     for (i = 0; i < MAX_PULSES; i++) {
-      RMTMEM.chan[pStrand->rmtChannel].data32[i + offset].val = 0;
+      items[i + offset].val = 0;
     }
     pState->buf_isDirty = 0;
-    return;
+    return true;
   }
   pState->buf_isDirty = 1;
 
+  // The pixels are in wire order already, send their bytes as they are
+  const uint8_t * pixel = reinterpret_cast<const uint8_t*>(&pStrand->pixels[pState->buf_pos / width]);
+  int channel = pState->buf_pos % width;
+
   for (i = 0; i < len; i++) {
-    byteval = pState->buf_data[i + pState->buf_pos];
+    byteval = pixel[(order >> (8 * channel)) & 0xff];
+    if (++channel == width) {
+      channel = 0;
+      pixel += sizeof(pixelColor_t);
+    }
 
     #if DEBUG_ESP32_DIGITAL_LED_LIB
       snprintf(digitalLeds_debugBuffer, digitalLeds_debugBufferSz,
@@ -309,12 +685,13 @@ static IRAM_ATTR void copyToRmtBlock_half(strand_t * pStrand)
     // Shift bits out, MSB first, setting RMTMEM.chan[n].data32[x] to
     // the rmtPulsePair value corresponding to the buffered bit value
     for (j = 0; j < 8; j++, byteval <<= 1) {
-      int bitval = (byteval >> 7) & 0x01;
-      int data32_idx = i * 8 + offset + j;
-      RMTMEM.chan[pStrand->rmtChannel].data32[data32_idx].val = pState->pulsePairMap[bitval].val;
+      // without a branch, the bits are as good as random
+      bitmask = -static_cast<uint32_t>((byteval >> 7) & 0x01);
+      items[i * 8 + offset + j].val = pulse0 ^ (pulseDiff & bitmask);
+      ones -= bitmask;
       #if DEBUG_ESP32_DIGITAL_LED_LIB
         snprintf(digitalLeds_debugBuffer, digitalLeds_debugBufferSz,
-                 "%s%d", digitalLeds_debugBuffer, bitval);
+                 "%s%d", digitalLeds_debugBuffer, (byteval >> 7) & 0x01);
       #endif
     }
     #if DEBUG_ESP32_DIGITAL_LED_LIB
@@ -324,8 +701,8 @@ static IRAM_ATTR void copyToRmtBlock_half(strand_t * pStrand)
 
     // Handle the reset bit by stretching duration1 for the final bit in the stream
     if (i + pState->buf_pos == pState->buf_len - 1) {
-      RMTMEM.chan[pStrand->rmtChannel].data32[i * 8 + offset + 7].duration1 =
-        ledParams.TRS / (RMT_DURATION_NS * DIVIDER);
+      items[i * 8 + offset + 7].duration1 = Traits::resetTicks;
+      pState->halfTicks[half] += Traits::resetTicks - (bitmask ? lowTicks1 : lowTicks0);
       #if DEBUG_ESP32_DIGITAL_LED_LIB
         snprintf(digitalLeds_debugBuffer, digitalLeds_debugBufferSz,
                  "%sRESET ", digitalLeds_debugBuffer);
@@ -335,17 +712,62 @@ static IRAM_ATTR void copyToRmtBlock_half(strand_t * pStrand)
 
   // Clear the remainder of the channel's data not set above
   for (i *= 8; i < MAX_PULSES; i++) {
-    RMTMEM.chan[pStrand->rmtChannel].data32[i + offset].val = 0;
+    items[i + offset].val = 0;
   }
   
   pState->buf_pos += len;
+  // how long the RMT takes for the half, for the interrupt's statistics
+  pState->halfTicks[half] += (8 * len - ones) * Traits::ticks0 + ones * Traits::ticks1;
 
   #if DEBUG_ESP32_DIGITAL_LED_LIB
     snprintf(digitalLeds_debugBuffer, digitalLeds_debugBufferSz,
              "%s ", digitalLeds_debugBuffer);
   #endif
 
-  return;
+  return true;
+}
+
+template <int Type>
+size_t Strand<Type>::encodeSpi(const pixelColor_t * pixels, int numPixels, uint8_t * out)
+{
+  constexpr int width = Traits::width;
+  constexpr uint32_t order = Traits::order;
+  constexpr uint32_t symbol0 = Traits::spiSymbol0, symbolDiff = Traits::spiSymbol0 ^ Traits::spiSymbol1;
+  constexpr uint32_t len0 = Traits::spiLen0, lenDiff = Traits::spiLen0 ^ Traits::spiLen1;
+
+  uint8_t * const start = out;
+  uint32_t bits = 0;  // the lowest pending of them are still to be written
+  uint32_t pending = 0;
+
+  for (int p = 0; p < numPixels; p++) {
+    const uint8_t * pixel = reinterpret_cast<const uint8_t*>(&pixels[p]);
+    for (int channel = 0; channel < width; channel++) {
+      uint32_t byteval = pixel[(order >> (8 * channel)) & 0xff];
+      // MSB first, and like encodeHalf() without a branch on the bit
+      for (int j = 0; j < 8; j++, byteval <<= 1) {
+        const uint32_t bitmask = -((byteval >> 7) & 0x01);
+        const uint32_t len = len0 ^ (lenDiff & bitmask);
+        bits = bits << len | (symbol0 ^ (symbolDiff & bitmask));
+        pending += len;
+        // a symbol is at most SPI_MAX_SLOTS = 8 bits, so at most one byte is full
+        if (pending >= 8) {
+          pending -= 8;
+          *out++ = bits >> pending;
+        }
+      }
+    }
+  }
+
+  // The reset, low for at least TRS, starts in the last byte of data
+  uint32_t resetBits = Traits::spiResetBits;
+  if (pending) {
+    *out++ = bits << (8 - pending);
+    resetBits -= 8 - pending;
+  }
+  memset(out, 0, (resetBits + 7) / 8);
+  out += (resetBits + 7) / 8;
+
+  return out - start;
 }
 
 static IRAM_ATTR void handleInterrupt(void *arg)
@@ -359,15 +781,47 @@ static IRAM_ATTR void handleInterrupt(void *arg)
 
   for (int i = 0; i < localStrandCnt; i++) {
     strand_t * pStrand = &localStrands[i];
+    if (pStrand->spiHost) {
+      continue;
+    }
     digitalLeds_stateData * pState = static_cast<digitalLeds_stateData*>(pStrand->_stateVars);
 
     if (RMT.int_st.val & tx_thr_event_offsets[pStrand->rmtChannel])
     {  // tests RMT.int_st.ch<n>_tx_thr_event
-      copyToRmtBlock_half(pStrand);
+      const int64_t entryUs = esp_timer_get_time();
+      const uint32_t entryCycles = cycleCount();
+      const int half = pState->buf_half;  // the one the RMT just finished
+      const bool wrote = pState->encodeHalf(pStrand);
       RMT.int_clr.val |= tx_thr_event_offsets[pStrand->rmtChannel];  // set RMT.int_clr.ch<n>_tx_thr_event
+
+      // The RMT started on the other half at eventTicks, and gets to this
+      // one when that is done
+      const int64_t eventUs = pState->frameStartUs + rmtTicksToUs(pState->eventTicks);
+      pState->eventTicks += pState->halfTicks[!half];
+      const bool late = wrote &&
+        esp_timer_get_time() > pState->frameStartUs + rmtTicksToUs(pState->eventTicks);
+      const uint32_t latencyUs = entryUs > eventUs ? entryUs - eventUs : 0;
+      const uint32_t cycles = cycleCount() - entryCycles;
+
+      portENTER_CRITICAL_ISR(&pState->statsMux);
+      digitalLeds_stats_t * stats = &pState->stats;
+      stats->refills++;
+      if (++pState->frameRefills > stats->refillsMax) {
+        stats->refillsMax = pState->frameRefills;
+      }
+      stats->underruns += late;
+      stats->latencySumUs += latencyUs;
+      if (latencyUs > stats->latencyMaxUs) {
+        stats->latencyMaxUs = latencyUs;
+      }
+      stats->isrCyclesSum += cycles;
+      if (cycles > stats->isrCyclesMax) {
+        stats->isrCyclesMax = cycles;
+      }
+      portEXIT_CRITICAL_ISR(&pState->statsMux);
     }
-    else if (RMT.int_st.val & tx_end_offsets[pStrand->rmtChannel] && pState->sem)
-    {  // tests RMT.int_st.ch<n>_tx_end and semaphore
+    else if (RMT.int_st.val & tx_end_offsets[pStrand->rmtChannel] && pState->busy)
+    {  // tests RMT.int_st.ch<n>_tx_end and whether a frame is in flight
       xSemaphoreGiveFromISR(pState->sem, &xHigherPriorityTaskWoken);
       RMT.int_clr.val |= tx_end_offsets[pStrand->rmtChannel];  // set RMT.int_clr.ch<n>_tx_end 
       if (xHigherPriorityTaskWoken == pdTRUE)
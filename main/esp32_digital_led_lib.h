@@ -1,5 +1,5 @@
 /*
- * Library for driving digital RGB(W) LEDs using the ESP32's RMT peripheral
+ * Library for driving digital RGB(W) LEDs using the ESP32's RMT or SPI peripheral
  *
  * Modifications Copyright (c) 2017 Martin F. Falatic
  *
@@ -34,18 +34,22 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define DEBUG_ESP32_DIGITAL_LED_LIB 0
 
+// Laid out in the order the LEDs take their data (G, R, B, then W for RGBW
+// types), so that the driver sends the pixels as they are, without packing
+// them into a transmit buffer first
 typedef union {
   struct __attribute__ ((packed)) {
-    uint8_t r, g, b, w;
+    uint8_t g, r, b, w;
   };
   uint32_t num;
 } pixelColor_t;
 
-inline pixelColor_t pixelFromRGB(uint8_t r, uint8_t g, uint8_t b)
+static inline pixelColor_t pixelFromRGB(uint8_t r, uint8_t g, uint8_t b)
 {
   pixelColor_t v;
   v.r = r;
@@ -55,7 +59,7 @@ inline pixelColor_t pixelFromRGB(uint8_t r, uint8_t g, uint8_t b)
   return v;
 }
 
-inline pixelColor_t pixelFromRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
+static inline pixelColor_t pixelFromRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
 {
   pixelColor_t v;
   v.r = r;
@@ -65,16 +69,44 @@ inline pixelColor_t pixelFromRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
   return v;
 }
 
+// pixels may point to caller-provided (e.g. static) storage, otherwise
+// digitalLeds_initStrands() allocates it.  The driver reads the pixels while
+// a frame is sent, so wait with digitalLeds_waitIdle() before changing them.
+//
+// An update only sends pixels [0, dirtyEnd): the LEDs past the last changed
+// one keep what they latched before, and if nothing changed, nothing is
+// sent.  digitalLeds_setPixel() keeps dirtyEnd up to date; code that writes
+// pixels directly raises it itself.
+//
+// A strand is sent by one of two backends.  With spiHost 0, RMT channel
+// rmtChannel streams it, and an interrupt encodes the next four bytes every
+// 32 bits on the wire, which is fine for a few hundred LEDs but falls behind
+// on long strips when Wi-Fi keeps the CPU busy.  With spiHost HSPI_HOST or
+// VSPI_HOST, an update encodes the whole frame into a DMA buffer, and the
+// SPI peripheral sends it from there on its MOSI pin (gpioNum) without the
+// CPU.  The buffer takes 8 to 32 bytes per pixel, see
+// digitalLeds_spiBufferSize().
 typedef struct {
   int rmtChannel;
+  int spiHost;  // 0: RMT
   int gpioNum;
   int ledType;
   int brightLimit;
   int numPixels;
   pixelColor_t * pixels;
+  int dirtyEnd;  // one past the highest pixel changed since the last update
   void * _stateVars;
 } strand_t;
 
+static inline void digitalLeds_setPixel(strand_t * pStrand, int i, pixelColor_t color)
+{
+  if (pStrand->pixels[i].num != color.num) {
+    pStrand->pixels[i] = color;
+    if (i >= pStrand->dirtyEnd)
+      pStrand->dirtyEnd = i + 1;
+  }
+}
+
 typedef struct {
   int bytesPerPixel;
   uint32_t T0H;
@@ -96,7 +128,20 @@ enum led_types {
   LED_SK6812W_V1,
 };
 
-const ledParams_t ledParamsAll[] = {  // Still must match order of `led_types`
+// The LED types digitalLeds_initStrands() accepts, as a mask of bits
+// (1 << led_types).  Each one costs an encoder in IRAM, so builds that know
+// their LEDs narrow it down (see main/component.mk).
+#ifndef DIGITALLEDS_TYPES
+#define DIGITALLEDS_TYPES 0xffffffff
+#endif
+
+// constexpr in C++, so that the driver can specialise on the LED type
+#ifdef __cplusplus
+constexpr
+#else
+const
+#endif
+ledParams_t ledParamsAll[] = {  // Still must match order of `led_types`
   [LED_WS2812_V1]  = { .bytesPerPixel = 3, .T0H = 350, .T1H = 700, .T0L = 800, .T1L = 600, .TRS =  50000},
   [LED_WS2812B_V1] = { .bytesPerPixel = 3, .T0H = 350, .T1H = 900, .T0L = 900, .T1L = 350, .TRS =  50000}, // Older datasheet
   [LED_WS2812B_V2] = { .bytesPerPixel = 3, .T0H = 400, .T1H = 850, .T0L = 850, .T1L = 400, .TRS =  50000}, // 2016 datasheet
@@ -109,8 +154,50 @@ const ledParams_t ledParamsAll[] = {  // Still must match order of `led_types`
 };
 
 extern int digitalLeds_initStrands(strand_t strands [], int numStrands);
+// Send the changed part of the strand, see strand_t.dirtyEnd
 extern int digitalLeds_updatePixels(strand_t * strand);
 extern void digitalLeds_resetPixels(strand_t * pStrand);
+// Wait until the frame in flight is out, after which pixels may change
+extern void digitalLeds_waitIdle(strand_t * pStrand);
+
+// How well the RMT interrupt keeps up with a strand.  The interrupt refills
+// half of the channel's 64-item block while the RMT sends the other half;
+// if it is so late that the RMT has moved on into the half being refilled,
+// the LEDs get stale bits, and that refill counts as an underrun.  Latency
+// runs from when the RMT finished a half (known from the pulse lengths and
+// the start of the frame) to when the interrupt starts on it, in us of
+// esp_timer_get_time().  Cycles are the CPU's while the interrupt works on
+// the strand, on the host the time stamp counter's.
+typedef struct {
+  uint32_t frames;
+  uint32_t refills;
+  uint32_t refillsMax;    // in one frame
+  uint32_t underruns;
+  uint32_t latencySumUs;
+  uint32_t latencyMaxUs;
+  uint32_t isrCyclesSum;
+  uint32_t isrCyclesMax;
+} digitalLeds_stats_t;
+
+// Copy the strand's counters, and with clear start them over, e.g. once per
+// report.  All zero for SPI strands, which have no interrupt.
+extern void digitalLeds_getStats(strand_t * pStrand, digitalLeds_stats_t * stats, int clear);
+
+// The SPI backend's encoder.  The LED waveform is cut into SPI bits at
+// digitalLeds_spiClockHz(), so that each high and low time is within 100 ns
+// of ledParamsAll, and a bit on the wire is 2 to 8 SPI bits, MSB first.  The
+// reset follows the last pixel as zeros.  encodeSpi() writes pixels
+// [0, numPixels) to out, which holds digitalLeds_spiBufferSize() bytes, and
+// returns the length.  All three return 0 for types not in DIGITALLEDS_TYPES.
+extern uint32_t digitalLeds_spiClockHz(int ledType);
+extern size_t digitalLeds_spiBufferSize(int ledType, int numPixels);
+extern size_t digitalLeds_encodeSpi(int ledType, const pixelColor_t * pixels, int numPixels,
+                                    uint8_t * out);
+
+// What the interrupt does per refill, for benchmarking: encode the next
+// (wrapping around) half RMT block of the pixels.  Waits for a transmission
+// in flight, and doesn't start one.  Does nothing for SPI strands.
+extern void digitalLeds_encodeHalf(strand_t * pStrand);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,61 @@
+/*
+ * frame_timing.c
+ *
+ * LED frame interval jitter, see frame_timing.h
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "frame_timing.h"
+#include "hist.h"
+
+static uint32_t period;
+static int64_t last_frame;  // 0: no frame yet
+static hist_t jitter;
+static uint32_t late, since_report;
+static portMUX_TYPE frame_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void frame_timing_init(uint32_t period_us) {
+    period = period_us;
+}
+
+void frame_timing_mark() {
+    const int64_t now = esp_timer_get_time();
+    if (last_frame) {
+        const int64_t interval = now - last_frame;
+        const int64_t dev = interval - period;
+        portENTER_CRITICAL(&frame_mux);
+        hist_add(&jitter, (uint32_t)(dev < 0 ? -dev : dev));
+        if (dev > portTICK_PERIOD_MS * 1000)
+            late++;
+        since_report++;
+        portEXIT_CRITICAL(&frame_mux);
+    }
+    last_frame = now;
+}
+
+int frame_timing_report_due() {
+    portENTER_CRITICAL(&frame_mux);
+    int due = since_report >= FRAME_REPORT_EVERY;
+    if (due)
+        since_report = 0;
+    portEXIT_CRITICAL(&frame_mux);
+    return due;
+}
+
+void frame_timing_report(const char *config) {
+    static hist_t copy;
+    portENTER_CRITICAL(&frame_mux);
+    copy = jitter;
+    const uint32_t late_copy = late;
+    portEXIT_CRITICAL(&frame_mux);
+
+    printf("frames: %s, %u intervals of %.1f ms\n", config, copy.count, period / 1000.0);
+    printf("  jitter us      p50      p90      p99    p99.9      max  late\n");
+    printf("           %9u%9u%9u%9u%9u%6u\n",
+           hist_percentile(&copy, 500), hist_percentile(&copy, 900),
+           hist_percentile(&copy, 990), hist_percentile(&copy, 999), copy.max, late_copy);
+}
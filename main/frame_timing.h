@@ -0,0 +1,37 @@
+/*
+ * frame_timing.h
+ *
+ * Frame pacing of the LED animation.  The LED task marks each frame right
+ * before digitalLeds_updatePixels(); the interval to the previous frame is
+ * compared against the nominal frame period, and the deviation goes into a
+ * histogram.  A frame that stutters because the LED task didn't get the CPU
+ * in time shows up in the tail:
+ *
+ *   frames: split (net 0, display 1, led 1), 600 intervals of 100.0 ms
+ *     jitter us      p50      p90      p99    p99.9      max  late
+ *                   110      220      900     1800     2400     3
+ *
+ * "late" counts intervals more than a tick (1 ms) over the period.  The
+ * pause between two sorts is made of frames too (they carry the quote-tick
+ * pulse), so its intervals count like all others.  The numbers cover the
+ * whole boot, so they belong to one affinity preset.
+ */
+
+#ifndef MAIN_FRAME_TIMING_H_
+#define MAIN_FRAME_TIMING_H_
+
+#include <stdint.h>
+
+// Print the report every this many frames (1 min at 10 frames per second)
+#define FRAME_REPORT_EVERY 600
+
+// Nominal interval between frames
+void frame_timing_init(uint32_t period_us);
+// A frame is about to go out
+void frame_timing_mark();
+// Print the percentiles, labelled with the given configuration
+void frame_timing_report(const char *config);
+// Has a report become due since the last call?  For periodic printing.
+int frame_timing_report_due();
+
+#endif /* MAIN_FRAME_TIMING_H_ */
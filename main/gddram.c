@@ -0,0 +1,107 @@
+/*
+ * gddram.c
+ *
+ * SSD1306 display RAM model, see gddram.h.  Page numbers refer to the
+ * SSD1306 datasheet rev 1.1, like the comments in ssd1366.h.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "gddram.h"
+
+// argument bytes that follow a command byte
+static int command_args(uint8_t cmd) {
+    switch (cmd) {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27: case 0x2C: case 0x2D:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+// One column left (0x2D) or right (0x2C) within the window, the column
+// pushed out wraps around
+static void content_scroll(gddram_t *g, const uint8_t *c) {
+    const int col_start = c[5] & 0x7F, col_end = c[6] & 0x7F;
+    if (col_end <= col_start)
+        return;
+    const int n = col_end - col_start;
+    for (int p = c[2] & 0x07; p <= (c[4] & 0x07); p++) {
+        uint8_t *row = &g->ram[p][col_start];
+        if (c[0] == 0x2D) {
+            const uint8_t out = row[0];
+            memmove(row, row + 1, n);
+            row[n] = out;
+        } else {
+            const uint8_t out = row[n];
+            memmove(row + 1, row, n);
+            row[0] = out;
+        }
+    }
+}
+
+// Only what moves the RAM pointers or the RAM itself
+static void execute(gddram_t *g, const uint8_t *c) {
+    if (c[0] <= 0x0F) {  // lower column nibble, page mode (p30)
+        g->col = (g->col & 0xF0) | c[0];
+    } else if (c[0] <= 0x1F) {  // upper column nibble
+        g->col = ((c[0] & 0x07) << 4) | (g->col & 0x0F);
+    } else if (c[0] >= 0xB0 && c[0] <= 0xB7) {  // page, page mode
+        g->page = c[0] & 0x07;
+    } else if (c[0] == 0x20) {
+        if ((c[1] & 0x03) != 0x03)
+            g->mode = c[1] & 0x03;
+    } else if (c[0] == 0x21) {
+        g->col_start = g->col = c[1] & 0x7F;
+        g->col_end = c[2] & 0x7F;
+    } else if (c[0] == 0x22) {
+        g->page_start = g->page = c[1] & 0x07;
+        g->page_end = c[2] & 0x07;
+    } else if (c[0] == 0x2C || c[0] == 0x2D) {
+        content_scroll(g, c);
+    }
+}
+
+const uint8_t *gddram_command_byte(gddram_t *g, uint8_t b) {
+    if (g->cmd_len == 0)
+        g->cmd_need = 1 + command_args(b);
+    g->cmd[g->cmd_len++] = b;
+    if (g->cmd_len < g->cmd_need)
+        return NULL;
+    g->cmd_len = 0;
+    execute(g, g->cmd);
+    return g->cmd;
+}
+
+// pointer increments, p34f
+void gddram_data_byte(gddram_t *g, uint8_t b) {
+    g->ram[g->page][g->col] = b;
+    switch (g->mode) {
+    case GDDRAM_PAGE:
+        if (++g->col > GDDRAM_WIDTH - 1)
+            g->col = g->col_start;
+        break;
+    case GDDRAM_HORIZONTAL:
+        if (g->col++ == g->col_end) {
+            g->col = g->col_start;
+            if (g->page++ == g->page_end)
+                g->page = g->page_start;
+        }
+        break;
+    case GDDRAM_VERTICAL:
+        if (g->page++ == g->page_end) {
+            g->page = g->page_start;
+            if (g->col++ == g->col_end)
+                g->col = g->col_start;
+        }
+        break;
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * gddram.h
+ *
+ * Model of the SSD1306's display RAM and how commands and data move through
+ * it: the page, horizontal and vertical addressing modes, the column and
+ * page pointers and ranges, and the one-column content scroll of datasheet
+ * rev 1.5.  Display settings (contrast, inversion, continuous scrolling and
+ * so on) are left to the caller, which sees every complete command.
+ *
+ * The mirror (mirror.h) keeps a copy of GDDRAM with it, and so does the
+ * host build's emulated panel, so both follow the same rules.
+ */
+
+#ifndef MAIN_GDDRAM_H_
+#define MAIN_GDDRAM_H_
+
+#include <stdint.h>
+
+#define GDDRAM_WIDTH 128
+#define GDDRAM_PAGES 8
+
+// addressing modes, the argument of command 0x20
+enum {
+    GDDRAM_HORIZONTAL = 0,
+    GDDRAM_VERTICAL = 1,
+    GDDRAM_PAGE = 2,
+};
+
+typedef struct {
+    uint8_t ram[GDDRAM_PAGES][GDDRAM_WIDTH];
+    uint8_t mode;
+    uint8_t col, page;
+    uint8_t col_start, col_end, page_start, page_end;
+    // the command being collected
+    uint8_t cmd[8];
+    uint8_t cmd_len, cmd_need;
+} gddram_t;
+
+// The reset state (p28ff), as an initializer
+#define GDDRAM_INIT { .mode = GDDRAM_PAGE, .col_end = GDDRAM_WIDTH - 1, .page_end = GDDRAM_PAGES - 1 }
+
+// A byte of a command stream.  Returns the command once its last argument
+// is in, after applying what it does to the RAM and its pointers, NULL
+// until then.
+const uint8_t *gddram_command_byte(gddram_t *g, uint8_t b);
+// A byte of display data: into RAM at the pointers, which move on
+void gddram_data_byte(gddram_t *g, uint8_t b);
+
+#endif /* MAIN_GDDRAM_H_ */
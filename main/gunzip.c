@@ -0,0 +1,166 @@
+/*
+ * gunzip.c
+ *
+ * Streaming gzip decoder, see gunzip.h.  The gzip framing (RFC 1952) is
+ * handled here, the deflate data itself goes to the ROM's tinfl with a
+ * wrapping 32 KB output window.
+ */
+
+#include <string.h>
+
+#include "esp32/rom/crc.h"
+
+#include "gunzip.h"
+
+enum {
+    GZ_HEADER,     // fixed 10 byte header
+    GZ_EXTRA_LEN,  // optional fields, in the order they appear in the stream
+    GZ_EXTRA,
+    GZ_NAME,
+    GZ_COMMENT,
+    GZ_HCRC,
+    GZ_BODY,       // deflate data
+    GZ_TRAILER,    // CRC32 and ISIZE
+    GZ_DONE,
+    GZ_ERROR,
+};
+
+// header FLG bits
+#define GZ_FHCRC    0x02
+#define GZ_FEXTRA   0x04
+#define GZ_FNAME    0x08
+#define GZ_FCOMMENT 0x10
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// first state from `state` on whose optional header field is present
+static uint8_t next_header_state(gunzip_t *gz, uint8_t state) {
+    gz->hdr_len = 0;
+    if (state <= GZ_EXTRA_LEN && (gz->flags & GZ_FEXTRA))
+        return GZ_EXTRA_LEN;
+    if (state <= GZ_NAME && (gz->flags & GZ_FNAME))
+        return GZ_NAME;
+    if (state <= GZ_COMMENT && (gz->flags & GZ_FCOMMENT))
+        return GZ_COMMENT;
+    if (state <= GZ_HCRC && (gz->flags & GZ_FHCRC)) {
+        gz->skip = 2;
+        return GZ_HCRC;
+    }
+    return GZ_BODY;
+}
+
+void gunzip_init(gunzip_t *gz) {
+    tinfl_init(&gz->inflator);
+    gz->dict_ofs = 0;
+    gz->state = GZ_HEADER;
+    gz->flags = 0;
+    gz->skip = 0;
+    gz->hdr_len = 0;
+    gz->crc = 0;
+    gz->size = 0;
+}
+
+static int inflate_chunk(gunzip_t *gz, const uint8_t **in, size_t *len,
+                         gunzip_sink_t sink, void *ctx) {
+    tinfl_status status;
+    do {
+        size_t in_size = *len;
+        size_t out_size = GUNZIP_DICT_SIZE - gz->dict_ofs;
+        uint8_t *out = gz->dict + gz->dict_ofs;
+
+        status = tinfl_decompress(&gz->inflator, *in, &in_size, gz->dict, out,
+                                  &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+        *in += in_size;
+        *len -= in_size;
+
+        if (out_size > 0) {
+            gz->crc = crc32_le(gz->crc, out, out_size);
+            gz->size += out_size;
+            sink(ctx, (const char*)out, out_size);
+            gz->dict_ofs = (gz->dict_ofs + out_size) & (GUNZIP_DICT_SIZE - 1);
+        }
+    } while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+    if (status == TINFL_STATUS_DONE) {
+        // tinfl reads ahead, so the start of the trailer may already be in
+        // its bit buffer, after the bits left of the last deflate byte
+        uint32_t bits = gz->inflator.m_num_bits;
+        uint64_t buf = (uint64_t)gz->inflator.m_bit_buf >> (bits & 7);
+        gz->hdr_len = 0;
+        for (bits &= ~7u; bits > 0 && gz->hdr_len < 8; bits -= 8, buf >>= 8)
+            gz->hdr[gz->hdr_len++] = (uint8_t)buf;
+        gz->state = gz->hdr_len == 8 ? GZ_DONE : GZ_TRAILER;
+    } else if (status < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int gunzip_feed(gunzip_t *gz, const uint8_t *in, size_t len,
+                gunzip_sink_t sink, void *ctx) {
+    while (len > 0) {
+        switch (gz->state) {
+        case GZ_HEADER:
+            gz->hdr[gz->hdr_len++] = *in++; len--;
+            if (gz->hdr_len == 10) {
+                // magic and CM = deflate
+                if (gz->hdr[0] != 0x1f || gz->hdr[1] != 0x8b || gz->hdr[2] != 8) {
+                    gz->state = GZ_ERROR;
+                    return -1;
+                }
+                gz->flags = gz->hdr[3];
+                gz->state = next_header_state(gz, GZ_EXTRA_LEN);
+            }
+            break;
+        case GZ_EXTRA_LEN:
+            gz->hdr[gz->hdr_len++] = *in++; len--;
+            if (gz->hdr_len == 2) {
+                gz->skip = gz->hdr[0] | (gz->hdr[1] << 8);
+                gz->state = gz->skip ? GZ_EXTRA : next_header_state(gz, GZ_NAME);
+            }
+            break;
+        case GZ_EXTRA:
+        case GZ_HCRC: {
+            size_t n = len < gz->skip ? len : gz->skip;
+            in += n; len -= n;
+            gz->skip -= n;
+            if (gz->skip == 0)
+                gz->state = next_header_state(gz, gz->state + 1);
+            break;
+        }
+        case GZ_NAME:
+        case GZ_COMMENT:
+            // zero-terminated strings
+            len--;
+            if (*in++ == 0)
+                gz->state = next_header_state(gz, gz->state + 1);
+            break;
+        case GZ_BODY:
+            if (inflate_chunk(gz, &in, &len, sink, ctx) != 0) {
+                gz->state = GZ_ERROR;
+                return -1;
+            }
+            break;
+        case GZ_TRAILER:
+            gz->hdr[gz->hdr_len++] = *in++; len--;
+            if (gz->hdr_len == 8)
+                gz->state = GZ_DONE;
+            break;
+        case GZ_DONE:
+            // ignore anything after the member
+            return 0;
+        default:
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// A stream without its whole trailer is as bad as one that doesn't check out
+int gunzip_finish(const gunzip_t *gz) {
+    if (gz->state != GZ_DONE)
+        return -1;
+    return le32(gz->hdr) == gz->crc && le32(gz->hdr + 4) == gz->size ? 0 : -1;
+}
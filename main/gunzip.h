@@ -0,0 +1,47 @@
+/*
+ * gunzip.h
+ *
+ * Streaming gzip decoder on top of the ROM's tinfl.  Compressed input is fed
+ * in arbitrary chunks, decompressed data is passed on to a sink as soon as
+ * it is available.  Only the 32 KB deflate window is kept, never the whole
+ * decompressed body.
+ */
+
+#ifndef MAIN_GUNZIP_H_
+#define MAIN_GUNZIP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp32/rom/miniz.h"
+
+// Must cover the largest distance the compressor may use, which for gzip
+// streams from arbitrary servers is the full 32 KB
+#define GUNZIP_DICT_SIZE TINFL_LZ_DICT_SIZE
+
+// receives decompressed data
+typedef void (*gunzip_sink_t)(void *ctx, const char *data, int len);
+
+typedef struct {
+    tinfl_decompressor inflator;
+    uint8_t dict[GUNZIP_DICT_SIZE];
+    size_t dict_ofs;
+
+    uint8_t state;    // see gunzip.c
+    uint8_t flags;    // gzip header FLG
+    uint16_t skip;    // header bytes left to skip in the current state
+    uint8_t hdr[10];  // fixed header, then the trailer
+    uint8_t hdr_len;
+
+    uint32_t crc, size;  // of the decompressed data so far
+} gunzip_t;
+
+void gunzip_init(gunzip_t *gz);
+// Returns 0 on success, -1 if the stream is corrupt
+int gunzip_feed(gunzip_t *gz, const uint8_t *in, size_t len,
+                gunzip_sink_t sink, void *ctx);
+// Returns 0 if the stream ended with its whole trailer and its CRC and size
+// check out
+int gunzip_finish(const gunzip_t *gz);
+
+#endif /* MAIN_GUNZIP_H_ */
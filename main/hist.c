@@ -0,0 +1,57 @@
+/*
+ * hist.c
+ *
+ * Fixed-size log-linear histogram, see hist.h
+ */
+
+#include <string.h>
+
+#include "hist.h"
+
+#define HIST_SUB (1 << HIST_SUB_BITS)
+
+static int bucket_of(uint32_t v) {
+    if (v < 2 * HIST_SUB)
+        return v;  // small values get a bucket each
+    int e = 31 - __builtin_clz(v);
+    int sub = (v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+static uint32_t bucket_upper(int i) {
+    if (i < 2 * HIST_SUB)
+        return i;
+    int e = i / HIST_SUB + HIST_SUB_BITS - 1;
+    int sub = i % HIST_SUB;
+    uint64_t lower = (uint64_t)(HIST_SUB + sub) << (e - HIST_SUB_BITS);
+    return (uint32_t)(lower + ((uint64_t)1 << (e - HIST_SUB_BITS)) - 1);
+}
+
+void hist_reset(hist_t *h) {
+    memset(h, 0, sizeof *h);
+}
+
+void hist_add(hist_t *h, uint32_t value) {
+    h->bucket[bucket_of(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+uint32_t hist_percentile(const hist_t *h, int permille) {
+    if (h->count == 0)
+        return 0;
+    uint32_t target = ((uint64_t)h->count * permille + 999) / 1000;
+    if (target == 0)
+        target = 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= target) {
+            uint32_t upper = bucket_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
@@ -0,0 +1,29 @@
+/*
+ * hist.h
+ *
+ * Fixed-size log-linear histogram for durations and the like.  Every power of
+ * two is split into 2^HIST_SUB_BITS buckets, so percentiles are accurate to
+ * within about 1/2^HIST_SUB_BITS of the value, from 0 up to 2^32 - 1.
+ */
+
+#ifndef MAIN_HIST_H_
+#define MAIN_HIST_H_
+
+#include <stdint.h>
+
+#define HIST_SUB_BITS 2
+#define HIST_BUCKETS  ((33 - HIST_SUB_BITS) << HIST_SUB_BITS)
+
+typedef struct {
+    uint32_t bucket[HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+} hist_t;
+
+void hist_reset(hist_t *h);
+void hist_add(hist_t *h, uint32_t value);
+// Upper bound of the value below which `permille`/1000 of the samples lie
+uint32_t hist_percentile(const hist_t *h, int permille);
+
+#endif /* MAIN_HIST_H_ */
@@ -0,0 +1,65 @@
+/*
+ * i2c_pool.c
+ *
+ * Preallocated I2C command links, see i2c_pool.h
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "i2c_pool.h"
+
+#ifdef I2C_LINK_RECOMMENDED_SIZE
+
+typedef struct {
+    uint8_t buffer[I2C_LINK_RECOMMENDED_SIZE(I2C_POOL_WRITES)];
+    i2c_cmd_handle_t cmd;  // non-NULL while handed out
+} pool_link_t;
+
+static pool_link_t links[I2C_POOL_LINKS];
+static portMUX_TYPE pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+i2c_cmd_handle_t i2c_pool_get() {
+    pool_link_t *link = NULL;
+    portENTER_CRITICAL(&pool_mux);
+    for (int i = 0; i < I2C_POOL_LINKS && !link; i++) {
+        if (!links[i].cmd) {
+            link = &links[i];
+            // claim it before leaving the critical section
+            link->cmd = (i2c_cmd_handle_t)link;
+        }
+    }
+    portEXIT_CRITICAL(&pool_mux);
+
+    if (!link) {
+        ESP_LOGW("i2c_pool", "all %d links in use, allocating one", I2C_POOL_LINKS);
+        return i2c_cmd_link_create();
+    }
+    link->cmd = i2c_cmd_link_create_static(link->buffer, sizeof link->buffer);
+    return link->cmd;
+}
+
+void i2c_pool_put(i2c_cmd_handle_t cmd) {
+    for (int i = 0; i < I2C_POOL_LINKS; i++) {
+        if (links[i].cmd == cmd) {
+            i2c_cmd_link_delete_static(cmd);
+            portENTER_CRITICAL(&pool_mux);
+            links[i].cmd = NULL;
+            portEXIT_CRITICAL(&pool_mux);
+            return;
+        }
+    }
+    i2c_cmd_link_delete(cmd);
+}
+
+#else
+
+i2c_cmd_handle_t i2c_pool_get() {
+    return i2c_cmd_link_create();
+}
+
+void i2c_pool_put(i2c_cmd_handle_t cmd) {
+    i2c_cmd_link_delete(cmd);
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * i2c_pool.h
+ *
+ * I2C command links from a preallocated pool, so that display updates don't
+ * go to the heap where the driver allows it.  A link is good for one
+ * transaction of up to I2C_POOL_WRITES writes (START and STOP come on top),
+ * write multi-byte payloads with i2c_master_write() rather than byte by
+ * byte.
+ *
+ * This needs i2c_cmd_link_create_static() (ESP-IDF v4.4 and later, and the
+ * host build with TBHUT_I2C_STATIC).  With older drivers, including the v4.0
+ * this tree builds with, which allocate every command of a link from the
+ * heap, each i2c_pool_get() is an i2c_cmd_link_create().
+ */
+
+#ifndef MAIN_I2C_POOL_H_
+#define MAIN_I2C_POOL_H_
+
+#include "driver/i2c.h"
+
+#define I2C_POOL_LINKS  2  // transactions in flight at the same time
+#define I2C_POOL_WRITES 4
+
+// A link from the pool; if they're all taken, a heap-allocated one
+i2c_cmd_handle_t i2c_pool_get();
+// Return a link, after i2c_master_cmd_begin()
+void i2c_pool_put(i2c_cmd_handle_t cmd);
+
+#endif /* MAIN_I2C_POOL_H_ */
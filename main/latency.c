@@ -0,0 +1,75 @@
+/*
+ * latency.c
+ *
+ * Fetch-to-pixel latency histograms, see latency.h
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "latency.h"
+
+static const char *const stage_names[LAT_NUM_STAGES] = {
+    [LAT_STAGE_REQUEST] = "request",
+    [LAT_STAGE_DOWNLOAD] = "download",
+    [LAT_STAGE_PARSE] = "parse",
+    [LAT_STAGE_DISPLAY] = "display",
+    [LAT_STAGE_TOTAL] = "total",
+};
+
+static hist_t stages[LAT_NUM_STAGES];
+static uint32_t since_report;
+static portMUX_TYPE lat_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void latency_mark(latency_sample_t *s, latency_point_t point) {
+    s->t[point] = esp_timer_get_time();
+}
+
+void latency_record(const latency_sample_t *s) {
+    portENTER_CRITICAL(&lat_mux);
+    for (int i = 0; i < LAT_STAGE_TOTAL; i++) {
+        hist_add(&stages[i], (uint32_t)(s->t[i + 1] - s->t[i]));
+    }
+    hist_add(&stages[LAT_STAGE_TOTAL],
+             (uint32_t)(s->t[LAT_FLUSH_DONE] - s->t[LAT_REQUEST_START]));
+    since_report++;
+    portEXIT_CRITICAL(&lat_mux);
+}
+
+void latency_get(latency_stage_t stage, hist_t *out) {
+    portENTER_CRITICAL(&lat_mux);
+    *out = stages[stage];
+    portEXIT_CRITICAL(&lat_mux);
+}
+
+int latency_report_due() {
+    portENTER_CRITICAL(&lat_mux);
+    int due = since_report >= LAT_REPORT_EVERY;
+    if (due)
+        since_report = 0;
+    portEXIT_CRITICAL(&lat_mux);
+    return due;
+}
+
+void latency_report() {
+    // copy out first, printing is far too slow to do in the critical section
+    static hist_t copy[LAT_NUM_STAGES];
+    portENTER_CRITICAL(&lat_mux);
+    for (int i = 0; i < LAT_NUM_STAGES; i++) {
+        copy[i] = stages[i];
+    }
+    portEXIT_CRITICAL(&lat_mux);
+
+    const hist_t *total = &copy[LAT_STAGE_TOTAL];
+    printf("latency: %u updates, us     p50      p90      p99      max  share\n",
+           total->count);
+    for (int i = 0; i < LAT_NUM_STAGES; i++) {
+        const hist_t *h = &copy[i];
+        unsigned share = total->sum ? (unsigned)(100 * h->sum / total->sum) : 0;
+        printf("  %-22s %8u %8u %8u %8u %5u%%\n", stage_names[i],
+               hist_percentile(h, 500), hist_percentile(h, 900),
+               hist_percentile(h, 990), h->max, share);
+    }
+}
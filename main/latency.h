@@ -0,0 +1,53 @@
+/*
+ * latency.h
+ *
+ * Fetch-to-pixel latency of quote updates.  Each update carries a
+ * latency_sample_t with timestamps (esp_timer_get_time(), in us) of the
+ * points below; once the update is on the display, the time spent between
+ * consecutive points is added to one histogram per stage.
+ */
+
+#ifndef MAIN_LATENCY_H_
+#define MAIN_LATENCY_H_
+
+#include <stdint.h>
+
+#include "hist.h"
+
+typedef enum {
+    LAT_REQUEST_START,  // before opening the request
+    LAT_FIRST_BYTE,     // response headers are in
+    LAT_LAST_BYTE,      // body completely read
+    LAT_PARSE_DONE,     // book is updated
+    LAT_FLUSH_DONE,     // I2C transfer to the display finished
+    LAT_NUM_POINTS
+} latency_point_t;
+
+// Stage i lasts from point i to point i + 1, the last one is the total
+typedef enum {
+    LAT_STAGE_REQUEST,   // connect + time to first byte
+    LAT_STAGE_DOWNLOAD,  // first to last byte, includes incremental parsing
+    LAT_STAGE_PARSE,     // finishing the parse
+    LAT_STAGE_DISPLAY,   // waiting for the display task + I2C flush
+    LAT_STAGE_TOTAL,
+    LAT_NUM_STAGES
+} latency_stage_t;
+
+typedef struct {
+    int64_t t[LAT_NUM_POINTS];
+} latency_sample_t;
+
+// Print the report every this many samples (~1 min at one quote per second)
+#define LAT_REPORT_EVERY 60
+
+void latency_mark(latency_sample_t *s, latency_point_t point);
+// Add a complete sample to the histograms
+void latency_record(const latency_sample_t *s);
+// Copy of a stage's histogram, for querying from other tasks
+void latency_get(latency_stage_t stage, hist_t *out);
+// Print p50/p90/p99/max and each stage's share of the total
+void latency_report();
+// Has a report become due since the last call?  For periodic printing.
+int latency_report_due();
+
+#endif /* MAIN_LATENCY_H_ */
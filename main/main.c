@@ -7,12 +7,14 @@
  *   to 1 minute or so) to prevent weekend API hammering
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 
 #include "esp_wifi.h"
@@ -21,7 +23,9 @@
 #include "esp_event_loop.h"
 #include "esp_log.h"
 #include "esp_spi_flash.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "tcpip_adapter.h"
 
 #include "esp_http_client.h"
 
@@ -29,6 +33,7 @@
 // display stuff
 #include "driver/gpio.h"
 #include "driver/i2c.h"
+#include "driver/spi_master.h"
 
 #define SDA_PIN GPIO_NUM_4
 #define SCL_PIN GPIO_NUM_18
@@ -38,9 +43,108 @@
 #include "ssd1366.h"
 
 // display string
-#define STRINGSIZE 120
+#define STRINGSIZE 160
 char string[STRINGSIZE];
 
+/*=================================================*/
+// quote stuff
+
+#include "quotes.h"
+#include "latency.h"
+#include "gunzip.h"
+#include "traffic.h"
+#include "monitor.h"
+#include "binlog.h"
+#include "bench.h"
+#include "boot.h"
+#include "quote_store.h"
+#include "wifi_cache.h"
+#include "affinity.h"
+#include "frame_timing.h"
+#include "sort_view.h"
+#include "sparkline.h"
+#include "big_font.h"
+#include "compositor.h"
+#include "mirror.h"
+
+// currency pairs to show, in display order (at most QUOTE_MAX_PAIRS)
+static const char *const watchlist[] = {
+    "EUR/USD", "GBP/USD", "USD/JPY", "EUR/GBP",
+};
+#define WATCHLIST_LEN ((int)(sizeof(watchlist) / sizeof(watchlist[0])))
+
+// Paged mode shows two pairs with bid and ask per page and flips pages every
+// QUOTE_PAGE_MS.  Scroll mode shows one line per pair (bid only) and lets the
+// panel scroll them by itself, see ssd1306_vscroll_start().
+#define QUOTE_DISPLAY_SCROLL 0
+#define QUOTE_PAGE_MS 4000
+// In paged mode, a chart of the pair's last 128 mid prices (sparkline.h) in
+// the lower half of the panel, which leaves room for one pair per page
+#define QUOTE_SPARKLINE 1
+// The bid in the digits of big_font.h, 2 or 3 times the size (and pages) of
+// the text, 0 for text.  Also one pair per page, with the ask below the bid.
+#define QUOTE_BIG_SCALE 2
+#define QUOTES_PER_PAGE (QUOTE_SPARKLINE || QUOTE_BIG_SCALE ? 1 : 2)
+// Move the chart along with the panel's one-column content scroll, which
+// needs an SSD1306 of datasheet rev 1.5 or later.  0 redraws all of it.
+#define QUOTE_SPARK_SCROLL 1
+#define SPARK_FIRST_PAGE (8 - SPARK_PAGES)
+_Static_assert(!QUOTE_BIG_SCALE || 2 + QUOTE_BIG_SCALE <= (QUOTE_SPARKLINE ? SPARK_FIRST_PAGE : 8),
+               "pair, bid and ask don't fit above the chart");
+// ticker rows below the header, and how often to redraw them.  56 rows at one
+// row per 25 frames take about 14 s at the default frame rate.
+#define QUOTE_TICKER_ROWS 56
+#define QUOTE_TICKER_MS 14000
+// Show the LED sort as a bar chart instead of the quotes, see sort_view.h.
+// The console's s key switches between the two.
+#define DISPLAY_SORT_BARS 0
+
+// Quotes are polled every QUOTE_PERIOD_MS on an absolute schedule.  A fetch
+// that isn't done within QUOTE_DEADLINE_MS is abandoned and retried once on a
+// fresh connection, which has until the end of the period.
+#define QUOTE_PERIOD_MS 1000
+#define QUOTE_DEADLINE_MS 600
+
+// where to get quotes from, e.g. tools/truefx_standin.py for testing
+#define QUOTE_URL "https://webrates.truefx.com/rates/connect.html"
+
+// size of the chunks the quote response is read in
+#define QUOTE_CHUNK 256
+
+// Mid prices are sampled into the history every QUOTE_HISTORY_MS, and quotes
+// and history are saved to flash at most every QUOTE_STORE_MS.  See
+// quote_store.h for what that costs in flash wear.
+#define QUOTE_HISTORY_MS (60 * 1000)
+#define QUOTE_STORE_MS (10 * 60 * 1000)
+
+// Validators of the last complete quote response, sent back as If-None-Match
+// and If-Modified-Since so that an unchanged feed costs just a 304.  Headers
+// of the response in flight go to quote_hdrs and are only committed to
+// quote_validators once its body was parsed completely.
+typedef struct {
+    char etag[64];
+    char last_modified[32];
+    int gzip;  // Content-Encoding: gzip, only used for the response in flight
+} quote_validators_t;
+static quote_validators_t quote_validators, quote_hdrs;
+
+// a quote update on its way from the fetcher to the display
+typedef struct {
+    quote_book_t book;
+    latency_sample_t lat;
+} quote_msg_t;
+
+// fetcher -> display task, holds only the latest update (xQueueOverwrite)
+static QueueHandle_t quote_queue;
+
+// What the display task waits for
+static EventGroupHandle_t display_events;
+#define DISPLAY_QUOTES  BIT0  // new update in quote_queue
+#define DISPLAY_BARS    BIT1  // sort bars changed
+#define DISPLAY_MODE    BIT2  // display_sort_bars toggled
+#define DISPLAY_REPAINT BIT3  // draw the panel from scratch (mirror started)
+static volatile uint8_t display_sort_bars = DISPLAY_SORT_BARS;
+
 
 /*=================================================*/
 // wifi stuff
@@ -48,6 +152,15 @@ char string[STRINGSIZE];
 #define WIFI_SSID "KA-WLAN"
 #define WIFI_PASS ""
 
+// Reconnects: after a failed attempt, wait this long before the next one,
+// doubling up to the maximum until an attempt gets an IP
+#define WIFI_BACKOFF_MIN_MS 100
+#define WIFI_BACKOFF_MAX_MS (10 * 1000)
+// Use the cached DHCP lease as a static address instead of asking for one.
+// Saves the DHCP exchange on every boot, but only safe where the DHCP server
+// keeps leases stable, an address that was handed out again goes unnoticed.
+#define WIFI_REUSE_LEASE 0
+
 /* FreeRTOS event group to signal when we are connected & ready to make a request */
 static EventGroupHandle_t wifi_event_group;
 
@@ -56,15 +169,34 @@ static EventGroupHandle_t wifi_event_group;
    to the AP with an IP? */
 const int CONNECTED_BIT = BIT0;
 
-static const char *TAG = "tbhut";
+// an array, so BINLOG can put it in a static initializer
+static const char TAG[] = "tbhut";
 
-// wifi quote buffer
-#define BUFSIZE 5000
-char buf[BUFSIZE];
+// captive portal login
+#include "portal_scan.h"
+
+#define PORTAL_CHUNK 256
 
 char post_data[120];
 
-TickType_t quote_lastwake;
+// AP and IP of the current association, set by event_handler
+static uint8_t wifi_bssid[6];
+static uint32_t wifi_ip;
+// bumped on every SYSTEM_EVENT_STA_GOT_IP
+static volatile uint32_t wifi_assoc_gen;
+
+// The portal session is bound to our MAC and IP, so after reassociating with
+// the same AP and getting the same lease we are still logged in.  This
+// remembers where the last successful login happened.
+typedef struct {
+    int valid;
+    uint8_t bssid[6];
+    uint32_t ip;
+} portal_session_t;
+static portal_session_t portal_session;
+
+// re-check the portal after this many quote fetches failed in a row
+#define PORTAL_RECHECK_FAILS 3
 
 /***************************************************/
 // LED stuff
@@ -83,10 +215,34 @@ TickType_t quote_lastwake;
 #define BR_NORM 0.1
 #define BR_FLASH 0.5
 
+// one sort step per frame
+#define LED_FRAME_MS 100
+// frames without sorting between two sorts
+#define LED_PAUSE_MS 2000
+
+// When the mid of this watchlist slot (EUR/USD) moves between two fetches,
+// a pulse runs along the strip over the sort: green from the first pixel
+// when it went up, red from the last when it went down.  0 turns it off.
+#define LED_PULSE 1
+#define LED_PULSE_SLOT   0
+#define LED_PULSE_FRAMES 12    // to cross the strip
+#define LED_PULSE_HALF   6     // pixels from the peak to where it fades out
+#define LED_PULSE_PEAK   0xC0  // alpha at the peak, 8.8
+
+// 0: send the frames with RMT channel 1, which suits the hat's 41 LEDs.  For
+// long strips HSPI_HOST or VSPI_HOST, which send each frame from a DMA
+// buffer of 16 bytes per pixel without interrupts (esp32_digital_led_lib.h).
+#define LED_SPI_HOST 0
+
+// static, so that the LED driver doesn't need the heap.  With RMT, the
+// driver sends these as they are, there is no separate transmit buffer.
+static pixelColor_t led_pixels[LED_LEN];
+
+// The LED type must be in DIGITALLEDS_TYPES of main/component.mk
 strand_t STRANDS[] = { // Avoid using any of the strapping pins on the ESP32
-    {.rmtChannel = 1, .gpioNum = LED_PIN, .ledType = LED_SK6812W_V1,
+    {.rmtChannel = 1, .spiHost = LED_SPI_HOST, .gpioNum = LED_PIN, .ledType = LED_SK6812W_V1,
      .brightLimit = (int)(BR_NORM * 255), .numPixels = LED_LEN,
-     .pixels = nullptr, ._stateVars = nullptr},
+     .pixels = led_pixels, ._stateVars = nullptr},
 };
 strand_t *strand = &STRANDS[0];
 
@@ -94,7 +250,24 @@ int STRANDCNT = sizeof(STRANDS)/sizeof(STRANDS[0]);
 
 int arr[LED_LEN];
 float colours[LED_LEN];
+// Each element's pixel, plain and highlighted, converted once per sort by
+// init_sort() and moved along with the element by swap()
+static pixelColor_t pix_norm[LED_LEN], pix_flash[LED_LEN];
 int flash1 = -1, flash2 = -1;
+// highlighted in the last frame, to be set back to plain
+static int flashed1 = -1, flashed2 = -1;
+
+// The sort as it would be shown alone, and the pulse over it (compositor.h).
+// Only while a pulse runs does the strand get the composite.
+static uint32_t sort_layer[LED_LEN], led_frame[LED_LEN];
+static uint16_t pulse_alpha[LED_LEN];
+static comp_layer_t led_layers[] = {
+    { .pixels = sort_layer },
+    { .alpha = pulse_alpha, .opacity = COMP_OPAQUE },
+};
+// +1 or -1 from quote_task, taken by the LED task at the next frame
+static volatile int8_t led_pulse_request;
+static int pulse_dir, pulse_frame;
 
 TickType_t led_lastwake;
 
@@ -121,19 +294,19 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
     switch(evt->event_id) {
         case HTTP_EVENT_ERROR:
-            ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
+            BINLOGD(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            BINLOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
             break;
         case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
+            BINLOGD(TAG, "HTTP_EVENT_HEADER_SENT");
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
             break;
         case HTTP_EVENT_ON_DATA:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+            BINLOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
             if (!esp_http_client_is_chunked_response(evt->client)) {
                 // Write out data
                 // printf("%.*s", evt->data_len, (char*)evt->data);
@@ -141,10 +314,10 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 
             break;
         case HTTP_EVENT_ON_FINISH:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
+            BINLOGD(TAG, "HTTP_EVENT_ON_FINISH");
             break;
         case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
+            BINLOGD(TAG, "HTTP_EVENT_DISCONNECTED");
             break;
     }
     return ESP_OK;
@@ -173,57 +346,42 @@ static int wifi_login()
              esp_http_client_get_status_code(client),
              esp_http_client_get_content_length(client));
 
-    // read data
-    int read_index = 0, total_len = 0;
-    while (1) {
-        int read_len = esp_http_client_read(client, buf + read_index, BUFSIZE - read_index);
-        ESP_LOGI(TAG, "Read %d bytes", read_len);
+    // scan the page as it comes in, until we know what we need
+    portal_scan_t scan;
+    portal_scan_init(&scan);
+
+    char chunk[PORTAL_CHUNK];
+    int total_len = 0;
+    portal_result_t result = PORTAL_SCANNING;
+    while (result == PORTAL_SCANNING) {
+        int read_len = esp_http_client_read(client, chunk, PORTAL_CHUNK);
+        BINLOGD(TAG, "Read %d bytes", read_len);
         if (read_len <= 0) {
             break;
         }
-        read_index += read_len;
         total_len += read_len;
-        buf[read_index] = 0;
+        result = portal_scan_feed(&scan, chunk, read_len);
     }
     if (total_len <= 0) {
         ESP_LOGE(TAG, "Invalid length of the response");
         goto _exit;
     }
 
-    ESP_LOGD(TAG, "Data=%s", buf);
-
-    // extract login information
-    const char done_needle[] = "Sie sind erfolgreich eingeloggt.";
-
-    if (strstr(buf, done_needle) != NULL) {
+    if (result == PORTAL_LOGGED_IN) {
         // we're already logged in
         ESP_LOGI(TAG, "already logged in, aborting");
         status = 0;
         goto _exit;
+    } else if (result != PORTAL_FORM) {
+        ESP_LOGE(TAG, "No login form in the %d byte portal page", total_len);
+        goto _exit;
     }
 
-    const char mac_needle[] = "<input type=\"hidden\" name=\"username\" type=\"text\" value=\"";
-    const char pw_needle[] = "<input type=\"hidden\" name=\"password\" type=\"password\" value=\"";
-
-    char* mac_begin = strstr(buf, mac_needle) + strlen(mac_needle);
-    char* mac_end = mac_begin + 17;
-
-    char* pw_begin = strstr(buf, pw_needle) + strlen(pw_needle);
-    char* pw_end = strstr(pw_begin, "\"");
-
-    ESP_LOGI(TAG, "Found MAC address at %d - %d, password at %d - %d",
-             mac_begin - buf, mac_end - buf, pw_begin - buf, pw_end - buf);
-
-    *mac_end = 0;
-    *pw_end = 0;
+    const char *mac = scan.username, *pw = scan.password;
+    ESP_LOGI(TAG, "MAC: %s, Pass: %s (after %d bytes)", mac, pw, total_len);
 
-    char mac[18];
-    char pw[32];
-
-    strncpy(mac, mac_begin, 18);
-    strncpy(pw, pw_begin, 32);
-
-    ESP_LOGI(TAG, "MAC: %s, Pass: %s", mac, pw);
+    // the rest of the page is still pending on this connection
+    esp_http_client_close(client);
 
     // assemble POST request
     //int post_data_len = 55 /* default params */ + 17 /* mac */ + strlen(pw);
@@ -253,101 +411,394 @@ _exit:
     return status;
 }
 
+static void copy_header(char *dest, size_t size, const char *value) {
+    if (strlen(value) >= size) {
+        // truncated validators would never match, better not send them
+        dest[0] = 0;
+        return;
+    }
+    strcpy(dest, value);
+}
+
+esp_err_t _quote_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        traffic_add_bytes(strlen(evt->header_key) + strlen(evt->header_value) + 4);
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            copy_header(quote_hdrs.etag, sizeof quote_hdrs.etag, evt->header_value);
+        } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+            copy_header(quote_hdrs.last_modified, sizeof quote_hdrs.last_modified,
+                        evt->header_value);
+        } else if (strcasecmp(evt->header_key, "Content-Encoding") == 0) {
+            quote_hdrs.gzip = strcasecmp(evt->header_value, "gzip") == 0;
+        }
+    }
+    return _http_event_handler(evt);
+}
+
 static esp_http_client_handle_t get_quote_client() {
     esp_http_client_config_t config = {
-        .url = "https://webrates.truefx.com/rates/connect.html",
-        .event_handler = _http_event_handler,
+        .url = QUOTE_URL,
+        .event_handler = _quote_event_handler,
+        .timeout_ms = QUOTE_DEADLINE_MS,
     };
     esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Accept-Encoding", "gzip");
     return client;
 }
 
-static void update_quote(esp_http_client_handle_t client) {
-    /* Step 1: fetch new quote */
+// (Re)set a request header, or remove it if value is empty
+static void set_header(esp_http_client_handle_t client, const char *key,
+                       const char *value) {
+    if (value[0]) {
+        esp_http_client_set_header(client, key, value);
+    } else {
+        esp_http_client_delete_header(client, key);
+    }
+}
+
+static void quote_parser_sink(void *ctx, const char *data, int len) {
+    quote_parser_feed((quote_parser_t*)ctx, data, len);
+}
+
+// has the tick count `deadline` passed?  Safe across tick counter wraparound.
+static int deadline_passed(TickType_t deadline) {
+    return (int32_t)(xTaskGetTickCount() - deadline) >= 0;
+}
+
+// Fetch one quote response and parse it into book, timestamping the steps
+// in lat.  Gives up with ESP_ERR_TIMEOUT once the tick count `deadline` has
+// passed, in which case book is left untouched.  *modified is cleared if the
+// server says nothing changed since the last complete response.
+static esp_err_t update_quote(esp_http_client_handle_t client,
+                              quote_book_t *book, latency_sample_t *lat,
+                              TickType_t deadline, int *modified) {
+    // 43 KB, mostly the deflate window, so keep it off the stack
+    static gunzip_t gz;
+
+    /* Step 1: fetch new quote, unless it didn't change */
+    set_header(client, "If-None-Match", quote_validators.etag);
+    set_header(client, "If-Modified-Since", quote_validators.last_modified);
+    memset(&quote_hdrs, 0, sizeof quote_hdrs);
+
+    latency_mark(lat, LAT_REQUEST_START);
     esp_err_t err = esp_http_client_open(client, 0);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP GET error requesting quote: %s",
                  esp_err_to_name(err));
-        return;
+        return err;
     }
     esp_http_client_fetch_headers(client);
+    latency_mark(lat, LAT_FIRST_BYTE);
+
+    int status = esp_http_client_get_status_code(client);
+    if (status == 304) {
+        traffic_add_response(1);
+        *modified = 0;
+        return ESP_OK;
+    } else if (status != 200) {
+        ESP_LOGE(TAG, "HTTP GET Status = %d requesting quote", status);
+        return ESP_FAIL;
+    }
+    *modified = 1;
+
+    /* Step 2: parse it while it comes in, inflating it first if need be */
+    quote_parser_t parser;
+    quote_parser_init(&parser, watchlist, WATCHLIST_LEN);
+    const int gzip = quote_hdrs.gzip;
+    if (gzip) {
+        gunzip_init(&gz);
+    }
 
-    // read data
-    int read_index = 0, total_len = 0;
+    char chunk[QUOTE_CHUNK];
+    int total_len = 0;
     while (1) {
-        int read_len = esp_http_client_read(client, buf + read_index, BUFSIZE - read_index);
-        ESP_LOGI(TAG, "Read %d bytes", read_len);
+        if (deadline_passed(deadline)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        int read_len = esp_http_client_read(client, chunk, QUOTE_CHUNK);
+        BINLOGD(TAG, "Read %d bytes", read_len);
         if (read_len <= 0) {
             break;
         }
-        read_index += read_len;
+        if (!gzip) {
+            quote_parser_feed(&parser, chunk, read_len);
+        } else if (gunzip_feed(&gz, (const uint8_t*)chunk, read_len,
+                               quote_parser_sink, &parser) != 0) {
+            ESP_LOGE(TAG, "Corrupt gzip data in quote response");
+            return ESP_FAIL;
+        }
         total_len += read_len;
-        buf[read_index] = 0;
     }
+    latency_mark(lat, LAT_LAST_BYTE);
+    traffic_add_bytes(total_len);
+    traffic_add_response(0);
     if (total_len <= 0) {
         ESP_LOGE(TAG, "Invalid length of the response");
+        return ESP_FAIL;
+    }
+    if (gzip && gunzip_finish(&gz) != 0) {
+        ESP_LOGE(TAG, "Truncated or corrupt gzip quote response");
+        return ESP_FAIL;
+    }
+
+    int updated = quote_parser_finish(&parser, book);
+    latency_mark(lat, LAT_PARSE_DONE);
+    if (updated < book->count) {
+        ESP_LOGW(TAG, "Only %d of %d watched pairs in the response",
+                 updated, book->count);
+    }
+    strcpy(quote_validators.etag, quote_hdrs.etag);
+    strcpy(quote_validators.last_modified, quote_hdrs.last_modified);
+    return ESP_OK;
+}
+
+// Render the given page of the watchlist into string (paged mode).  With
+// QUOTE_BIG_SCALE, the lines for the bid are left empty for draw_big_bid().
+static void render_quote_page(const quote_book_t *book, int page) {
+    memset(string, 0, STRINGSIZE);
+
+    char* dest = string;
+    if (QUOTE_BIG_SCALE) {
+        const quote_t *q = &book->q[page];
+        dest += sprintf(dest, "%-8s%8s", q->pair, q->stale ? "(stale)" : "");
+        for (int i = 0; i <= QUOTE_BIG_SCALE; i++)
+            *dest++ = '\n';
+        sprintf(dest, "Ask: %-11s", q->valid ? q->ask : "?");
         return;
     }
+    dest += sprintf(dest, "%-16s\n", quotes_any_stale(book) ? "TB Forex (stale)" : "TB Forex Rates");
+
+    // lines are padded to full width to overwrite the previous page
+    for (int slot = 0; slot < QUOTES_PER_PAGE; slot++) {
+        const int i = page * QUOTES_PER_PAGE + slot;
+        if (slot > 0)
+            dest += sprintf(dest, "\n\n");
+        if (i < book->count) {
+            const quote_t *q = &book->q[i];
+            dest += sprintf(dest, "%-16s\nBid: %-11s\nAsk: %-11s", q->pair,
+                            q->valid ? q->bid : "?", q->valid ? q->ask : "?");
+        } else {
+            dest += sprintf(dest, "%16s\n%16s\n%16s", "", "", "");
+        }
+    }
+    ESP_LOGD(TAG, "Quote page %d:\n%s", page, string);
+}
 
-    ESP_LOGD(TAG, "Response: %s", buf);
+// The bid of the page's pair in big digits, right-aligned below the pair
+// name, as one strip of full pages
+static void draw_big_bid(const quote_book_t *book, int page) {
+    static uint8_t strip[QUOTE_BIG_SCALE ? QUOTE_BIG_SCALE : 1][128];
+    memset(strip, 0, sizeof strip);
+    const quote_t *q = &book->q[page];
+    const char *bid = q->valid ? q->bid : "?";
+    const int x = sizeof strip[0] - big_font_width(bid, QUOTE_BIG_SCALE, 1);
+    big_font_draw(strip[0], sizeof strip[0], x < 0 ? 0 : x, bid, QUOTE_BIG_SCALE, 1);
+    for (int p = 0; p < QUOTE_BIG_SCALE; p++)
+        ssd1306_write_at(1 + p, 0, strip[p], sizeof strip[p]);
+}
 
+// Render one line per pair into string (scroll mode)
+static void render_quote_ticker(const quote_book_t *book) {
     memset(string, 0, STRINGSIZE);
 
     char* dest = string;
-    sprintf(dest, "TB Forex Rates\n");
-    dest += 15; // hack
-
-    // EUR/USD
-    memcpy(dest, buf, 7);
-    sprintf(dest + 7, "         \nBid: ");
-    memcpy(dest + 22, buf + 70, 4);
-    memcpy(dest + 26, buf + 110, 3);
-    sprintf(dest + 29, "\nAsk: ");
-    memcpy(dest + 35, buf + 140, 4);
-    memcpy(dest + 39, buf + 180, 3);
-    dest[42] = '\n';
-    dest[43] = '\n';
-
-    // GBP/USD
-    memcpy(dest + 44, buf + 14, 7);
-    sprintf(dest + 51, "         \nBid: ");
-    memcpy(dest + 66, buf + 78, 4);
-    memcpy(dest + 70, buf + 116, 3);
-    sprintf(dest + 73, "\nAsk: ");
-    memcpy(dest + 79, buf + 148, 4);
-    memcpy(dest + 83, buf + 186, 3);
-    dest[86] = 0;
-
-    ESP_LOGI(TAG, "Quote: %s", dest);
+    dest += sprintf(dest, "%-16s", quotes_any_stale(book) ? "TB Forex (stale)" : "TB Forex Rates");
+    for (int i = 0; i < book->count && i < QUOTE_TICKER_ROWS / 8; i++) {
+        const quote_t *q = &book->q[i];
+        dest += sprintf(dest, "\n%s %-8s", q->pair, q->valid ? q->bid : "?");
+    }
 }
 
-static void quote_task(void* pvParam) {
-    // Wait for the callback to set the CONNECTED_BIT in the event group.
-    ESP_LOGI(TAG, "Waiting for WiFi connection...");
+// Price charts of the watchlist, fed by the display task with every update
+static spark_t sparks[QUOTE_MAX_PAIRS];
 
-    int dots = 0;
-    EventBits_t bits;
-    do {
-        memset(string, 0, STRINGSIZE);
-        sprintf(string, "Connecting\nto WiFi");
-        for (int i = 0; i < dots; ++i) {
-            sprintf(string + strlen(string), ".");
+static void draw_spark(const spark_t *s) {
+    static uint8_t rows[SPARK_PAGES][SPARK_LEN];
+    uint8_t col[SPARK_PAGES];
+    for (int x = 0; x < SPARK_LEN; x++) {
+        spark_column(s, x, col);
+        for (int p = 0; p < SPARK_PAGES; p++)
+            rows[p][x] = col[p];
+    }
+    for (int p = 0; p < SPARK_PAGES; p++)
+        ssd1306_write_at(SPARK_FIRST_PAGE + p, 0, rows[p], SPARK_LEN);
+}
+
+// Just the newest sample: move the chart left, draw the last column
+static void tick_spark(const spark_t *s) {
+    uint8_t col[SPARK_PAGES];
+    ssd1306_scroll_left_one(SPARK_FIRST_PAGE, 7, 0, SPARK_LEN - 1);
+    spark_column(s, SPARK_LEN - 1, col);
+    for (int p = 0; p < SPARK_PAGES; p++)
+        ssd1306_write_at(SPARK_FIRST_PAGE + p, SPARK_LEN - 1, &col[p], 1);
+}
+
+// Add a fresh book to the charts.  Returns what the shown pair's chart
+// needs now, given what it needed before (see display_task()).
+static int sample_sparks(const quote_book_t *book, int shown, int update) {
+    for (int i = 0; i < book->count; i++) {
+        if (!book->q[i].valid || book->q[i].stale)
+            continue;
+        const int rescaled = spark_push(&sparks[i], quote_mid_points(&book->q[i]));
+        // one column can be scrolled in, more than that is a full redraw
+        if (i == shown)
+            update = update == 0 && !rescaled && QUOTE_SPARK_SCROLL ? 1 : -1;
+    }
+    return update;
+}
+
+// Owns the display once quotes are being fetched.  Redraws whenever a new
+// book arrives from the fetcher, and flips pages in between.  In sort bar
+// mode it draws the bars that changed instead and keeps the book for later.
+static void display_task(void* pvParam) {
+    static quote_msg_t msg;
+    quote_book_t *book = &msg.book;
+    quotes_book_init(book, watchlist, WATCHLIST_LEN);
+
+    const int pages = (book->count + QUOTES_PER_PAGE - 1) / QUOTES_PER_PAGE;
+    const TickType_t flip_ticks = (QUOTE_DISPLAY_SCROLL ? QUOTE_TICKER_MS :
+                                   QUOTE_PAGE_MS) / portTICK_PERIOD_MS;
+    int page = 0;
+    TickType_t next_flip = xTaskGetTickCount() + flip_ticks;
+    int redraw = 1, shown_quotes = 0, bars = 0, repaint = 0;
+    int lat_pending = 0;  // msg.lat still needs its flush timestamp
+    // the shown pair's chart: -1 needs drawing in full, 1 a new column
+    int spark_update = -1;
+    for (int i = 0; i < book->count; i++)
+        spark_init(&sparks[i]);
+
+    ssd1306_display_clear();
+
+    while (1) {
+        if (bars != display_sort_bars || repaint) {
+            // bars are drawn in horizontal addressing mode, text in page
+            // mode, and neither covers all of what the other leaves behind.
+            // A repaint sets up everything too, for the mirror's model.
+            bars = display_sort_bars;
+            repaint = 0;
+            ssd1306_scroll_stop();
+            ssd1306_set_addressing(0x02);
+            ssd1306_display_clear();
+            if (bars) {
+                ssd1306_set_addressing(0x00);
+                sort_view_invalidate();
+            }
+            redraw = 1;
+            spark_update = -1;
         }
-        // clearing
-        for (int i = dots; i < 5; ++i) {
-            sprintf(string + strlen(string), " ");
+
+        if (bars) {
+            sort_view_bar_t bar;
+            while (sort_view_next(&bar)) {
+                ssd1306_write_window(bar.col_start, bar.col_end, 0, SORT_VIEW_PAGES - 1,
+                                     bar.data, bar.len);
+            }
+        } else if (redraw) {
+            if (QUOTE_DISPLAY_SCROLL) {
+                // RAM can't be written while the panel scrolls
+                ssd1306_scroll_stop();
+                render_quote_ticker(book);
+                ssd1306_display_text(string);
+                ssd1306_vscroll_start(8, QUOTE_TICKER_ROWS, 1, 7, 0x06);
+            } else {
+                render_quote_page(book, page);
+                ssd1306_display_text(string);
+                if (QUOTE_BIG_SCALE)
+                    draw_big_bid(book, page);
+                if (QUOTE_SPARKLINE && spark_update < 0)
+                    draw_spark(&sparks[page]);
+                else if (QUOTE_SPARKLINE && spark_update > 0)
+                    tick_spark(&sparks[page]);
+                spark_update = 0;
+            }
+            redraw = 0;
+
+            if (book->stale) {
+                boot_mark(BOOT_CACHED_QUOTES);
+            }
+            if (lat_pending) {
+                boot_mark(BOOT_FIRST_QUOTE);
+                latency_mark(&msg.lat, LAT_FLUSH_DONE);
+                latency_record(&msg.lat);
+                lat_pending = 0;
+            }
         }
 
-        xTaskCreate(&task_ssd1306_display_text, "ssd1306_display_text", 2048,
-                    string, 6, NULL);
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = bars ? portMAX_DELAY :
+                          (int32_t)(next_flip - now) > 0 ? next_flip - now : 0;
+        const EventBits_t woke = xEventGroupWaitBits(
+            display_events, DISPLAY_QUOTES | DISPLAY_MODE | DISPLAY_REPAINT |
+            (bars ? DISPLAY_BARS : 0), pdTRUE, pdFALSE, wait);
+        repaint = (woke & DISPLAY_REPAINT) != 0;
+        const int was_stale = quotes_any_stale(book);
+        if ((woke & DISPLAY_QUOTES) && xQueueReceive(quote_queue, &msg, 0) == pdTRUE) {
+            // in scroll mode, new prices wait for the next ticker redraw,
+            // unless they replace the last stale ones from flash
+            redraw = !QUOTE_DISPLAY_SCROLL || !shown_quotes ||
+                     was_stale != quotes_any_stale(book);
+            shown_quotes = 1;
+            // restored quotes come without a fetch to measure, and behind
+            // the bars nobody sees the fetched ones
+            lat_pending = !book->stale && !bars;
+            if (QUOTE_SPARKLINE && !book->stale)
+                spark_update = sample_sparks(book, page, spark_update);
+        }
+        if (!bars && deadline_passed(next_flip)) {
+            page = (page + 1) % pages;
+            next_flip = xTaskGetTickCount() + flip_ticks;
+            redraw = 1;
+            spark_update = -1;
+        }
+    }
 
-        dots = (dots + 1) % 5;
+    vTaskDelete(NULL);
+}
 
-        bits = xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT, false,
-                                   true, 1000 / portTICK_PERIOD_MS);
+// Hand a book to the display task
+static void post_quotes(const quote_msg_t *msg) {
+    xQueueOverwrite(quote_queue, msg);
+    xEventGroupSetBits(display_events, DISPLAY_QUOTES);
+}
 
-    } while (!(bits & CONNECTED_BIT));
-    ESP_LOGI(TAG, "Connected to AP");
+// One polling period: fetch with a deadline, hedge once on a new connection
+// if that is missed, and hand the result to the display task
+static esp_err_t fetch_quotes(esp_http_client_handle_t client, quote_msg_t *msg,
+                              TickType_t period_start) {
+    const TickType_t deadline = period_start + QUOTE_DEADLINE_MS / portTICK_PERIOD_MS;
+    const TickType_t period_end = period_start + QUOTE_PERIOD_MS / portTICK_PERIOD_MS;
+    int modified = 0;
+
+    esp_err_t err = update_quote(client, &msg->book, &msg->lat, deadline, &modified);
+    if (err != ESP_OK && !deadline_passed(period_end)) {
+        ESP_LOGW(TAG, "Quote fetch failed (%s), retrying", esp_err_to_name(err));
+        // the old connection may still be stuck in the middle of a response
+        esp_http_client_close(client);
+        err = update_quote(client, &msg->book, &msg->lat, period_end, &modified);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Giving up on this quote update: %s", esp_err_to_name(err));
+        esp_http_client_close(client);
+        return err;
+    }
+
+    if (modified) {
+        post_quotes(msg);
+    } else {
+        BINLOGD(TAG, "Quotes not modified");
+    }
+    return ESP_OK;
+}
+
+// Make sure we're past the captive portal on the current association.  The
+// portal round trip is skipped if we logged in on this AP with this IP before.
+static void ensure_portal_login() {
+    if (portal_session.valid && portal_session.ip == wifi_ip &&
+        memcmp(portal_session.bssid, wifi_bssid, sizeof wifi_bssid) == 0) {
+        ESP_LOGI(TAG, "Same AP and lease as the last login, skipping portal");
+        return;
+    }
 
     // Try to log into KA-WLAN
     int connectDelay = 1000;
@@ -358,27 +809,125 @@ static void quote_task(void* pvParam) {
         connectDelay *= 1.5;
     }
 
-    memset(string, 0, STRINGSIZE);
-    xTaskCreate(&task_ssd1306_display_clear, "ssd1306_display_clear", 2048,
-                NULL, 6, NULL);
+    portal_session.valid = 1;
+    portal_session.ip = wifi_ip;
+    memcpy(portal_session.bssid, wifi_bssid, sizeof wifi_bssid);
+}
+
+// From here on, the display task owns the display
+static void start_display_task() {
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(quote_msg_t)];
+    quote_queue = xQueueCreateStatic(1, sizeof(quote_msg_t), queue_storage, &queue_buf);
+    // page layout (sprintf), big digits and the charts take about 2.6 KB
+    // on the host (`m`), see the monitor's stack_free
+    static StackType_t display_stack[4096];
+    static StaticTask_t display_tcb;
+    xTaskCreateStaticPinnedToCore(&display_task, "display_task", sizeof display_stack,
+                                  NULL, 6, display_stack, &display_tcb,
+                                  affinity_get()->display);
+}
+
+// Ask the LED task for a pulse if the pulse pair's mid moved since the
+// last fetch
+static void pulse_on_quotes(const quote_book_t *book) {
+    static int32_t last_mid;
+    const quote_t *q = &book->q[LED_PULSE_SLOT];
+    if (!LED_PULSE || !q->valid || q->stale)
+        return;
+    const int32_t mid = quote_mid_points(q);
+    if (last_mid && mid != last_mid)
+        led_pulse_request = mid > last_mid ? 1 : -1;
+    last_mid = mid;
+}
+
+static void quote_task(void* pvParam) {
+    // Initialise display, this overlaps with the association
+    i2c_master_init();
+    ssd1306_init();
+    ssd1306_display_clear();
+    boot_mark(BOOT_DISPLAY);
+
+    static quote_msg_t msg;
+    quotes_book_init(&msg.book, watchlist, WATCHLIST_LEN);
+    quote_store_init(QUOTE_HISTORY_MS, QUOTE_STORE_MS);
+    // show the quotes from before the reboot while we connect
+    const int restored = quote_store_load(&msg.book) > 0;
+    if (restored) {
+        start_display_task();
+        post_quotes(&msg);
+    }
+
+    // Wait for the callback to set the CONNECTED_BIT in the event group.
+    ESP_LOGI(TAG, "Waiting for WiFi connection...");
+
+    int dots = 0;
+    EventBits_t bits;
+    do {
+        // unless it shows the restored quotes, nobody else uses the
+        // display yet
+        if (!restored) {
+            memset(string, 0, STRINGSIZE);
+            sprintf(string, "Connecting\nto WiFi");
+            for (int i = 0; i < dots; ++i) {
+                sprintf(string + strlen(string), ".");
+            }
+            // clearing
+            for (int i = dots; i < 5; ++i) {
+                sprintf(string + strlen(string), " ");
+            }
+            ssd1306_display_text(string);
+            dots = (dots + 1) % 5;
+        }
+
+        bits = xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT, false,
+                                   true, 1000 / portTICK_PERIOD_MS);
 
+    } while (!(bits & CONNECTED_BIT));
+    ESP_LOGI(TAG, "Connected to AP");
+
+    uint32_t assoc_gen = wifi_assoc_gen;
+    ensure_portal_login();
+    boot_mark(BOOT_PORTAL);
+
+    if (!restored)
+        start_display_task();
 
     // get http client for quote fetching
     esp_http_client_handle_t client = get_quote_client();
 
-    while (1) {
-        ESP_LOGI(TAG, "fetching updated quote...");
-        update_quote(client);
+    const TickType_t period = QUOTE_PERIOD_MS / portTICK_PERIOD_MS;
+    TickType_t next_wake = xTaskGetTickCount();
 
-        /* update text */
-        xTaskCreate(&task_ssd1306_display_text, "ssd1306_display_text", 2048,
-                    string, 6, NULL);
+    int fails = 0;
 
-        quote_lastwake = xTaskGetTickCount();
+    while (1) {
+        // after a reconnect, log in again unless the session survived
+        xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT, false, true,
+                            portMAX_DELAY);
+        if (assoc_gen != wifi_assoc_gen) {
+            assoc_gen = wifi_assoc_gen;
+            ensure_portal_login();
+        }
+
+        BINLOGI(TAG, "fetching updated quote...");
+        if (fetch_quotes(client, &msg, next_wake) == ESP_OK) {
+            quote_store_update(&msg.book);
+            pulse_on_quotes(&msg.book);
+            fails = 0;
+        } else if (++fails == PORTAL_RECHECK_FAILS) {
+            // maybe the portal session expired after all
+            portal_session.valid = 0;
+            ensure_portal_login();
+            fails = 0;
+        }
 
-        taskYIELD();
-        /* delay */
-        safe_sleep(1000, &quote_lastwake);
+        // if we fell more than a period behind, skip the missed slots
+        // instead of fetching back to back to catch up
+        if ((int32_t)(xTaskGetTickCount() - next_wake) >= (int32_t)period) {
+            next_wake = xTaskGetTickCount();
+        }
+        vTaskDelayUntil(&next_wake, period);
     }
 
     vTaskDelete(NULL);
@@ -388,21 +937,120 @@ static void quote_task(void* pvParam) {
 /******************************************************************************/
 /*** WiFi Authentication ******************************************************/
 
+// The last good association (wifi_cache.h).  A connect attempt is either
+// directed, to the cached AP on its channel, or a scan of all channels.
+// After a directed attempt fails, the next one scans; after an association
+// is lost, the next attempt is directed again.
+static wifi_cache_t wifi_cache;
+static uint8_t wifi_directed, wifi_has_ip;
+static uint32_t wifi_attempt, wifi_backoff_ms = WIFI_BACKOFF_MIN_MS;
+static int64_t wifi_connect_us, wifi_assoc_us;
+static esp_timer_handle_t wifi_retry_timer;
+
+// Aim the next esp_wifi_connect() at the cached AP or at any AP
+static void wifi_set_target(int directed)
+{
+    wifi_config_t wifi_config;
+    esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config);
+    directed = directed && wifi_cache.channel;
+    wifi_config.sta.bssid_set = directed;
+    if (directed)
+        memcpy(wifi_config.sta.bssid, wifi_cache.bssid, sizeof wifi_cache.bssid);
+    wifi_config.sta.channel = directed ? wifi_cache.channel : 0;
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+#if WIFI_REUSE_LEASE
+    if (directed && wifi_cache.ip) {
+        tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+        tcpip_adapter_ip_info_t ip_info = {
+            .ip = { wifi_cache.ip },
+            .netmask = { wifi_cache.netmask },
+            .gw = { wifi_cache.gw },
+        };
+        tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
+    } else {
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    }
+#endif
+    wifi_directed = directed;
+}
+
+static void wifi_connect(void *arg)
+{
+    wifi_attempt++;
+    wifi_connect_us = esp_timer_get_time();
+    esp_wifi_connect();
+}
+
+static const char *wifi_attempt_kind()
+{
+    return wifi_directed ? "directed" : "scan";
+}
+
 esp_err_t event_handler(void *ctx, system_event_t *event)
 {
+    const int64_t now = esp_timer_get_time();
     switch(event->event_id) {
     case SYSTEM_EVENT_STA_START:
-        esp_wifi_connect();
+        wifi_connect(NULL);
+        break;
+    case SYSTEM_EVENT_STA_CONNECTED: {
+        const system_event_sta_connected_t *c = &event->event_info.connected;
+        boot_mark(BOOT_ASSOC);
+        wifi_assoc_us = now;
+        memcpy(wifi_bssid, c->bssid, sizeof wifi_bssid);
+        ESP_LOGI(TAG, "Wi-Fi attempt %u (%s): associated with %02x:%02x:%02x:%02x:%02x:%02x "
+                 "on channel %d after %d ms", wifi_attempt, wifi_attempt_kind(),
+                 c->bssid[0], c->bssid[1], c->bssid[2], c->bssid[3], c->bssid[4],
+                 c->bssid[5], c->channel, (int)((now - wifi_connect_us) / 1000));
+        memcpy(wifi_cache.bssid, c->bssid, sizeof wifi_cache.bssid);
+        wifi_cache.channel = c->channel;
         break;
-    case SYSTEM_EVENT_STA_GOT_IP:
+    }
+    case SYSTEM_EVENT_STA_GOT_IP: {
+        const tcpip_adapter_ip_info_t *ip = &event->event_info.got_ip.ip_info;
+        boot_mark(BOOT_GOT_IP);
+        wifi_ip = ip->ip.addr;
+        wifi_assoc_gen++;
+        wifi_has_ip = 1;
+        wifi_backoff_ms = WIFI_BACKOFF_MIN_MS;
         xEventGroupSetBits(wifi_event_group, CONNECTED_BIT);
+        ESP_LOGI(TAG, "Wi-Fi attempt %u (%s): IP %d.%d.%d.%d %d ms after association, "
+                 "%d ms after connect", wifi_attempt, wifi_attempt_kind(),
+                 (int)(wifi_ip & 0xff), (int)((wifi_ip >> 8) & 0xff),
+                 (int)((wifi_ip >> 16) & 0xff), (int)(wifi_ip >> 24),
+                 (int)((now - wifi_assoc_us) / 1000), (int)((now - wifi_connect_us) / 1000));
+        wifi_cache.ip = ip->ip.addr;
+        wifi_cache.netmask = ip->netmask.addr;
+        wifi_cache.gw = ip->gw.addr;
+        wifi_cache_save(&wifi_cache);
         break;
-    case SYSTEM_EVENT_STA_DISCONNECTED:
-        /* This is a workaround as ESP32 WiFi libs don't currently
-           auto-reassociate. */
-        esp_wifi_connect();
+    }
+    case SYSTEM_EVENT_STA_DISCONNECTED: {
         xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
+        uint32_t delay_ms;
+        if (wifi_has_ip) {
+            // lost a working association, the AP is most likely still there
+            ESP_LOGW(TAG, "Wi-Fi disconnected, reason %d",
+                     event->event_info.disconnected.reason);
+            wifi_set_target(1);
+            delay_ms = WIFI_BACKOFF_MIN_MS;
+        } else {
+            ESP_LOGW(TAG, "Wi-Fi attempt %u (%s) failed after %d ms, reason %d, "
+                     "retry in %u ms", wifi_attempt, wifi_attempt_kind(),
+                     (int)((now - wifi_connect_us) / 1000),
+                     event->event_info.disconnected.reason, wifi_backoff_ms);
+            if (wifi_directed)
+                wifi_set_target(0);
+            delay_ms = wifi_backoff_ms;
+            wifi_backoff_ms = wifi_backoff_ms * 2 < WIFI_BACKOFF_MAX_MS ?
+                              wifi_backoff_ms * 2 : WIFI_BACKOFF_MAX_MS;
+        }
+        wifi_has_ip = 0;
+        /* The ESP32 WiFi libs don't reassociate by themselves.  Not right
+           away, that would spin against an AP that is down. */
+        esp_timer_start_once(wifi_retry_timer, delay_ms * 1000);
         break;
+    }
     default:
         break;
     }
@@ -412,7 +1060,8 @@ esp_err_t event_handler(void *ctx, system_event_t *event)
 static void initialise_wifi(void)
 {
     tcpip_adapter_init();
-    wifi_event_group = xEventGroupCreate();
+    static StaticEventGroup_t wifi_event_group_buf;
+    wifi_event_group = xEventGroupCreateStatic(&wifi_event_group_buf);
     ESP_ERROR_CHECK( esp_event_loop_init(event_handler, NULL) );
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK( esp_wifi_init(&cfg) );
@@ -426,6 +1075,16 @@ static void initialise_wifi(void)
     ESP_LOGI(TAG, "Setting WiFi configuration SSID %s...", wifi_config.sta.ssid);
     ESP_ERROR_CHECK( esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK( esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config) );
+
+    const esp_timer_create_args_t retry_args = {
+        .callback = &wifi_connect,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK( esp_timer_create(&retry_args, &wifi_retry_timer) );
+    // the first attempt goes to the AP of the last boot, if there is one
+    wifi_cache_load(&wifi_cache);
+    wifi_set_target(1);
+
     ESP_ERROR_CHECK( esp_wifi_start() );
 }
 
@@ -497,52 +1156,130 @@ pixelColor_t hsv_to_rgb(float h, float s, float v) {
         return pixelFromRGB(m, n, v);
         //return long(v ) << 16 | long(m) << 8 | long(n);
     }
-    ESP_LOGE(TAG, "hsv_to_rgb error: default case reached!");
+    BINLOGE(TAG, "hsv_to_rgb error: default case reached!");
     return pixelFromRGB(0, 0, 0);
 }
 
 
 void init_sort() {
+    // the strand still shows the last frame of the previous sort
+    digitalLeds_waitIdle(strand);
     for (int i = 0; i < LED_LEN; i++) {
         arr[i] = rand();
         colours[i] = (float)arr[i] / (float)(RAND_MAX/6.0);
-        ESP_LOGD("sort", "arr[%d] = %d, hue: %f", i, arr[i], colours[i]);
+        pix_norm[i] = hsv_to_rgb(colours[i], 1.0, BR_NORM);
+        pix_flash[i] = hsv_to_rgb(colours[i], 1.0, BR_FLASH);
+        sort_layer[i] = pix_norm[i].num;
+        digitalLeds_setPixel(strand, i, pix_norm[i]);
+        sort_view_set(i, arr[i], RAND_MAX);
+        BINLOGD("sort", "arr[%d] = %d, hue: %f", i, arr[i], colours[i]);
     }
+    flashed1 = -1; flashed2 = -1;
 }
 
-static void led_update() {
+// Move the pulse on by a frame, starting a new one if quote_task asked for
+// it.  Returns 1 if the strand needs the composite this frame, which
+// includes the frame after the pulse has left, to take it off again.
+static int led_pulse_step() {
+    // a request that comes in between these two lines is lost, which only
+    // means a pulse less
+    const int8_t request = led_pulse_request;
+    led_pulse_request = 0;
+    if (request) {
+        pulse_dir = request;
+        pulse_frame = 0;
+        const uint8_t level = (uint8_t)(BR_FLASH * 255);
+        led_layers[1].colour = (request > 0 ? pixelFromRGB(0, level, 0)
+                                            : pixelFromRGB(level, 0, 0)).num;
+    }
+    if (!pulse_dir)
+        return 0;
+
+    if (pulse_frame == LED_PULSE_FRAMES) {
+        memset(pulse_alpha, 0, sizeof pulse_alpha);
+        pulse_dir = 0;
+        return 1;
+    }
+    // the peak goes from just before the first pixel to just past the last
+    const int travel = LED_LEN - 1 + 2 * LED_PULSE_HALF;
+    int peak = pulse_frame * travel / (LED_PULSE_FRAMES - 1) - LED_PULSE_HALF;
+    if (pulse_dir < 0)
+        peak = LED_LEN - 1 - peak;
     for (int i = 0; i < LED_LEN; i++) {
-        strand->pixels[i] = hsv_to_rgb(colours[i], 1.0, BR_NORM);
+        const int d = abs(i - peak);
+        pulse_alpha[i] = d < LED_PULSE_HALF ?
+            (LED_PULSE_HALF - d) * LED_PULSE_PEAK / LED_PULSE_HALF : 0;
     }
+    pulse_frame++;
+    return 1;
+}
+
+// Pixel i of the sort, straight onto the strand unless it is composited
+static void set_sort_pixel(int i, pixelColor_t px, int composited) {
+    sort_layer[i] = px.num;
+    if (!composited)
+        digitalLeds_setPixel(strand, i, px);
+}
+
+// Only the pixels that change are touched: the last frame's highlighted pair
+// goes back to plain, and the pair swapped since (if any) is highlighted.
+// While a pulse runs, every pixel is composited and set instead, and the
+// driver still only sends the ones that changed.
+static void led_update() {
+    // long done at 10 frames per second, but the driver reads the pixels
+    digitalLeds_waitIdle(strand);
 
-    ESP_LOGD("sort", "led_update: flashing pixels %d and %d", flash1, flash2);
+    BINLOGD("sort", "led_update: flashing pixels %d and %d", flash1, flash2);
     if (flash1 >= LED_LEN || flash2 >= LED_LEN) {
-        ESP_LOGE("sort", "out of bounds flash index: %d %d", flash1, flash2);
+        BINLOGE("sort", "out of bounds flash index: %d %d", flash1, flash2);
     }
+    const int composited = led_pulse_step();
+    if (flashed1 >= 0)
+        set_sort_pixel(flashed1, pix_norm[flashed1], composited);
+    if (flashed2 >= 0)
+        set_sort_pixel(flashed2, pix_norm[flashed2], composited);
     if (flash1 >= 0)
-        strand->pixels[flash1] = hsv_to_rgb(colours[flash1], 1.0, BR_FLASH);
+        set_sort_pixel(flash1, pix_flash[flash1], composited);
     if (flash2 >= 0)
-        strand->pixels[flash2] = hsv_to_rgb(colours[flash2], 1.0, BR_FLASH);
+        set_sort_pixel(flash2, pix_flash[flash2], composited);
+    flashed1 = flash1; flashed2 = flash2;
+
+    if (composited) {
+        comp_render(led_frame, led_layers, 2, LED_LEN);
+        for (int i = 0; i < LED_LEN; i++) {
+            pixelColor_t px;
+            px.num = led_frame[i];
+            digitalLeds_setPixel(strand, i, px);
+        }
+    }
 
 
+    frame_timing_mark();
     digitalLeds_updatePixels(strand);
+    boot_mark(BOOT_FIRST_FRAME);
 
     flash1 = -1; flash2 = -1;
 
     // voluntarily yield CPU to other tasks (for wifi stuff)
     //taskYIELD();
-    safe_sleep(100, &led_lastwake);
+    safe_sleep(LED_FRAME_MS, &led_lastwake);
 }
 
 static void swap(int a, int b) {
     if (a >= LED_LEN || b >= LED_LEN)
-        ESP_LOGE("sort", "out of bounds swap: %d %d", a, b);
+        BINLOGE("sort", "out of bounds swap: %d %d", a, b);
 
     float temp_colour = colours[a];
     int temp_val = arr[a];
     colours[a] = colours[b]; arr[a] = arr[b];
     colours[b] = temp_colour; arr[b] = temp_val;
 
+    pixelColor_t temp_pix = pix_norm[a];
+    pix_norm[a] = pix_norm[b]; pix_norm[b] = temp_pix;
+    temp_pix = pix_flash[a];
+    pix_flash[a] = pix_flash[b]; pix_flash[b] = temp_pix;
+
+    sort_view_swap(a, b);
     flash1 = a; flash2 = b;
 
     led_update();
@@ -572,7 +1309,7 @@ static int partition (int low, int high)
 static void quickSort(int level, int low, int high) {
     if (low < high) {
         int pi = partition(low, high);
-        ESP_LOGD("sort", "level %d, pivot: %d -> %d / %f",
+        BINLOGD("sort", "level %d, pivot: %d -> %d / %f",
                  level, pi, arr[pi], colours[pi]);
 
         quickSort(level + 1, low, pi - 1);
@@ -583,48 +1320,247 @@ static void quickSort(int level, int low, int high) {
 static void LED_task(void *pvParameters) {
     led_lastwake = xTaskGetTickCount();
     while (1) {
-        ESP_LOGI("sort", "initialising...");
+        BINLOGI("sort", "initialising...");
         init_sort();
         led_update();
 
-        ESP_LOGI("sort", "starting quicksort");
+        BINLOGI("sort", "starting quicksort");
         quickSort(0, 0, LED_LEN - 1);
 
         led_update();
 
-        ESP_LOGI("sort", "done, short pause");
-        safe_sleep(2000, &led_lastwake);
+        BINLOGI("sort", "done, short pause");
+        // frames go on for the pulse, the unchanged ones aren't sent
+        for (int i = 0; i < LED_PAUSE_MS / LED_FRAME_MS; i++)
+            led_update();
     }
 
     vTaskDelete(NULL);
 }
 
 /******************************************************************************/
-/*** Main Logic ***************************************************************/
+/*** Benchmarks ***************************************************************/
+
+// A complete feed response for ten pairs, in the format of quotes.h
+static const char bench_feed[] =
+    "EUR/USDUSD/JPYGBP/USDEUR/GBPUSD/CHFEUR/JPYEUR/CHFUSD/CADAUD/USDGBP/JPY"
+    "1.14110.1.300.870.99125.1.121.300.72143."
+    "096123456461012642975521843651"
+    "1.14110.1.300.870.99125.1.121.300.72143."
+    "099126459464015645978524846654\n";
+
+static int bench_hsv_idx;
+
+static void bench_hsv(void *arg) {
+    led_pixels[bench_hsv_idx] = hsv_to_rgb(colours[bench_hsv_idx], 1.0, BR_NORM);
+    if (++bench_hsv_idx == LED_LEN)
+        bench_hsv_idx = 0;
+}
 
-void app_main(void)
-{
-    /* Print chip information */
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
-    printf("This is ESP32 chip with %d CPU cores, WiFi%s%s, ",
-           chip_info.cores,
-           (chip_info.features & CHIP_FEATURE_BT) ? "/BT" : "",
-           (chip_info.features & CHIP_FEATURE_BLE) ? "/BLE" : "");
+static void bench_encode(void *arg) {
+    digitalLeds_encodeHalf((strand_t *)arg);
+}
 
-    printf("silicon revision %d, ", chip_info.revision);
+static void bench_encode_spi(void *arg) {
+    digitalLeds_encodeSpi(strand->ledType, strand->pixels, strand->numPixels, arg);
+}
 
-    printf("%dMB %s flash\n", spi_flash_get_chip_size() / (1024 * 1024),
-           (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external");
-    ESP_ERROR_CHECK( nvs_flash_init() );
+// What ssd1306_display_text() does per line, minus the I2C transfer
+static uint8_t bench_page[128];
+static void bench_glyphs(void *arg) {
+    const char *text = arg;
+    for (int i = 0; i < 16; i++)
+        memcpy(&bench_page[i * 8], font8x8_basic_tr[(uint8_t)text[i]], 8);
+}
 
-    // Initialise display
-    i2c_master_init();
-    ssd1306_init();
+// A price in big digits into a two page strip
+static uint8_t bench_strip[2][128];
+static void bench_big_digits(void *arg) {
+    big_font_draw(bench_strip[0], sizeof bench_strip[0], 0, arg, 2, 1);
+}
+
+// The LED layers over a long strip, out of led_update()'s reach
+#define BENCH_COMP_LEN 1000
+static uint32_t *bench_comp_out;
+static comp_layer_t bench_comp_layers[2];
+static void bench_composite(void *arg) {
+    comp_render(bench_comp_out, bench_comp_layers, 2, BENCH_COMP_LEN);
+}
+
+// A page of text against a blank one, what a mirror reset costs per page
+static const uint8_t bench_blank[128];
+static void bench_mirror_page(void *arg) {
+    static uint8_t out[128 * 2];
+    mirror_encode(out, bench_page, bench_blank, sizeof bench_page, 1);
+}
+
+// A ring's worth of two-argument records, then dropped so that the ring
+// never fills; the drop is a few cycles per record of its own
+static binlog_fmt_t bench_binlog_fmt = { ESP_LOG_INFO, tag, "Read %d bytes in %u us" };
+static void bench_binlog(void *arg) {
+    for (int i = 0; i < BINLOG_RING_LEN; i++)
+        binlog_write(&bench_binlog_fmt, i, 1234u);
+    binlog_discard();
+}
+
+static quote_book_t bench_book;
+static void bench_parse(void *arg) {
+    static quote_parser_t parser;
+    quote_parser_init(&parser, watchlist, WATCHLIST_LEN);
+    quote_parser_feed(&parser, bench_feed, sizeof bench_feed - 1);
+    quote_parser_finish(&parser, &bench_book);
+}
+
+static void bench_page_render(void *arg) {
+    render_quote_page(&bench_book, 0);
+}
 
-    xTaskCreate(&task_ssd1306_display_clear, "ssd1306_display_clear", 2048, NULL, 6, NULL);
-    vTaskDelay(100/portTICK_PERIOD_MS);
+// Runs instead of the normal startup when bench_boot_requested(), with the
+// display and LEDs initialised but no tasks started yet
+static void run_benchmarks() {
+    init_sort();
+    quotes_book_init(&bench_book, watchlist, WATCHLIST_LEN);
+
+    bench_header();
+    bench_run("hsv_to_rgb", &bench_hsv, NULL, 1000, 1);
+    // one half RMT block is 32 pulses, four bytes
+    bench_run("rmt_encode_half", &bench_encode, strand, 1000, 4);
+    // the whole strand into an SPI DMA buffer
+    uint8_t *spi_buf = malloc(digitalLeds_spiBufferSize(strand->ledType, strand->numPixels));
+    bench_run("spi_encode", &bench_encode_spi, spi_buf, 100,
+              strand->numPixels * ledParamsAll[strand->ledType].bytesPerPixel);
+    free(spi_buf);
+    // a pulse over every pixel, and one as wide as led_update()'s
+    bench_comp_out = malloc(BENCH_COMP_LEN * sizeof *bench_comp_out);
+    uint32_t *base = malloc(BENCH_COMP_LEN * sizeof *base);
+    uint16_t *alpha = malloc(BENCH_COMP_LEN * sizeof *alpha);
+    for (int i = 0; i < BENCH_COMP_LEN; i++) {
+        base[i] = pix_norm[i % LED_LEN].num;
+        alpha[i] = 1 + i % LED_PULSE_PEAK;
+    }
+    bench_comp_layers[0] = (comp_layer_t){ .pixels = base };
+    bench_comp_layers[1] = (comp_layer_t){ .colour = pix_flash[0].num, .alpha = alpha,
+                                           .opacity = COMP_OPAQUE };
+    bench_run("composite", &bench_composite, NULL, 100, BENCH_COMP_LEN);
+    for (int i = 0; i < BENCH_COMP_LEN; i++)
+        alpha[i] = i >= 500 && i < 500 + 2 * LED_PULSE_HALF ? LED_PULSE_PEAK : 0;
+    bench_run("composite_pulse", &bench_composite, NULL, 100, BENCH_COMP_LEN);
+    free(alpha);
+    free(base);
+    free(bench_comp_out);
+    bench_run("glyphs", &bench_glyphs, "EUR/USD 1.14096 ", 1000, 16);
+    bench_run("mirror_page", &bench_mirror_page, NULL, 1000, sizeof bench_page);
+    bench_run("big_digits", &bench_big_digits, "1.14096", 1000, 7);
+    bench_run("binlog_write", &bench_binlog, NULL, 100, BINLOG_RING_LEN);
+    bench_run("quote_parse", &bench_parse, NULL, 100, sizeof bench_feed - 1);
+    bench_run("quote_page", &bench_page_render, NULL, 100, 1);
+}
 
+/******************************************************************************/
+/*** Console ******************************************************************/
+
+// Task/stack/heap lines every this often, 0 for only on request
+#define MONITOR_PERIOD_MS 10000
+// Share of the console UART (115200 baud, 11.5 KB/s) the OLED and LED
+// mirror gets while it is on (mirror.h)
+#define MIRROR_BYTES_PER_S 5000
+
+// The LED driver's counters since the previous snapshot, as a monitor line
+// per RMT strand (see digitalLeds_stats_t):
+//   @mon <ms> rmt <channel> <frames> <refills> <refills_max> <underruns>
+//        <latency_avg_us> <latency_max_us> <isr_cycles_avg> <isr_cycles_max>
+static void led_stats_report(uint32_t ms) {
+    for (int i = 0; i < STRANDCNT; i++) {
+        if (STRANDS[i].spiHost)
+            continue;
+        digitalLeds_stats_t st;
+        digitalLeds_getStats(&STRANDS[i], &st, 1);
+        const uint32_t refills = st.refills ? st.refills : 1;
+        printf("@mon %u rmt %d %u %u %u %u %u %u %u %u\n", ms, STRANDS[i].rmtChannel,
+               st.frames, st.refills, st.refillsMax, st.underruns,
+               st.latencySumUs / refills, st.latencyMaxUs,
+               st.isrCyclesSum / refills, st.isrCyclesMax);
+    }
+}
+
+static void monitor_extra(uint32_t ms) {
+    led_stats_report(ms);
+    mirror_report(ms);
+}
+
+// Polls the console UART for single-key commands and prints the periodic
+// reports and the binary log, so none of that formatting happens in the
+// time-critical tasks.
+//   l - fetch-to-pixel latency report
+//   n - quote traffic over the last hour
+//   m - task, stack and heap snapshot (see monitor.h)
+//   b - reboot into the benchmarks (see bench.h)
+//   t - boot timeline (see boot.h)
+//   j - LED frame jitter (see frame_timing.h)
+//   a - reboot with the next core affinity preset (see affinity.h)
+//   s - switch the display between quotes and sort bars (see sort_view.h)
+//   v - start or stop mirroring the OLED and LEDs (see mirror.h)
+static void console_task(void *pvParameters) {
+    while (1) {
+        int c = getchar();
+        if (c == EOF) {
+            clearerr(stdin);
+        } else if (c == 'l') {
+            latency_report();
+        } else if (c == 'n') {
+            traffic_report();
+        } else if (c == 'm') {
+            monitor_report();
+        } else if (c == 't') {
+            boot_report();
+        } else if (c == 'j') {
+            frame_timing_report(affinity_describe(affinity_get()));
+        } else if (c == 'a') {
+            affinity_request(affinity_next());
+            esp_restart();
+        } else if (c == 'b') {
+            bench_request_boot();
+            esp_restart();
+        } else if (c == 's') {
+            display_sort_bars = !display_sort_bars;
+            xEventGroupSetBits(display_events, DISPLAY_MODE);
+        } else if (c == 'v') {
+            mirror_enable(!mirror_enabled());
+            if (mirror_enabled())
+                xEventGroupSetBits(display_events, DISPLAY_REPAINT);
+        }
+
+        if (boot_report_due()) {
+            boot_report();
+        }
+        if (latency_report_due()) {
+            latency_report();
+            traffic_report();
+        }
+        if (frame_timing_report_due()) {
+            frame_timing_report(affinity_describe(affinity_get()));
+        }
+        binlog_flush();
+        mirror_poll();
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+
+    vTaskDelete(NULL);
+}
+
+/******************************************************************************/
+/*** Main Logic ***************************************************************/
+
+void app_main(void)
+{
+    boot_mark(BOOT_APP_MAIN);
+    ESP_ERROR_CHECK( nvs_flash_init() );
+    boot_mark(BOOT_NVS);
+
+    // Startup is ordered by what is on the critical path: the LEDs are the
+    // first sign of life and quick to set up, then the association, which
+    // takes longest, is started.  The display is brought up by quote_task
+    // while the association runs.  See boot.h for the timeline.
 
     // Initialise LEDs
     LED_setup(LED_PIN, GPIO_MODE_OUTPUT, 0);
@@ -632,12 +1568,64 @@ void app_main(void)
         ESP_LOGE(TAG, "LED init failure :(");
     }
     srand(esp_random());
+    boot_mark(BOOT_LEDS);
+
+    if (bench_boot_requested()) {
+        run_benchmarks();
+        esp_restart();
+    }
+
+    // All tasks are allocated statically, and after boot nothing in the
+    // firmware's own loops uses the heap (esp_http_client still does).
+    const affinity_t *affinity = affinity_get();
+    ESP_LOGI(TAG, "Core affinity %s", affinity_describe(affinity));
+
+    // what the viewer has of the strip, for mirror_poll()
+    static uint32_t led_mirror[LED_LEN];
+    mirror_init(&led_pixels[0].num, led_mirror, LED_LEN, MIRROR_BYTES_PER_S);
+
+    // the LED task reports its swaps to the display task from the start
+    static StaticEventGroup_t display_events_buf;
+    display_events = xEventGroupCreateStatic(&display_events_buf);
+    sort_view_init(LED_LEN, display_events, DISPLAY_BARS);
 
     // schedule LED sorting task
-    xTaskCreate(&LED_task, "LED_task", 2048, NULL, 4, NULL);
+    frame_timing_init(LED_FRAME_MS * 1000);
+    // quicksort recursion, compositing and BINLOG varargs, about 2.4 KB on
+    // the host
+    static StackType_t led_stack[4096];
+    static StaticTask_t led_tcb;
+    xTaskCreateStaticPinnedToCore(&LED_task, "LED_task", sizeof led_stack, NULL, 4,
+                                  led_stack, &led_tcb, affinity->led);
 
     // Connect to wifi
     initialise_wifi();
+    boot_mark(BOOT_WIFI_START);
+
+    static StackType_t quote_stack[8 * 2048];
+    static StaticTask_t quote_tcb;
+    xTaskCreateStaticPinnedToCore(&quote_task, "quote_task", sizeof quote_stack, NULL, 6,
+                                  quote_stack, &quote_tcb, affinity->net);
+
+    // binlog_flush() formats floats
+    static StackType_t console_stack[3072];
+    static StaticTask_t console_tcb;
+    xTaskCreateStatic(&console_task, "console_task", sizeof console_stack, NULL, 1,
+                      console_stack, &console_tcb);
+    monitor_set_extra(monitor_extra);
+    monitor_start(MONITOR_PERIOD_MS);
+
+    /* Print chip information, nothing waits for it */
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    printf("This is ESP32 chip with %d CPU cores, WiFi%s%s, ",
+           chip_info.cores,
+           (chip_info.features & CHIP_FEATURE_BT) ? "/BT" : "",
+           (chip_info.features & CHIP_FEATURE_BLE) ? "/BLE" : "");
 
-    xTaskCreate(&quote_task, "quote_task", 8 * 2048, NULL, 6, NULL);
+    printf("silicon revision %d, ", chip_info.revision);
+
+    printf("%dMB %s flash\n", spi_flash_get_chip_size() / (1024 * 1024),
+           (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external");
+    boot_mark(BOOT_TASKS);
 }
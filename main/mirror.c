@@ -0,0 +1,303 @@
+/*
+ * mirror.c
+ *
+ * OLED and LED stream to the console, see mirror.h.  Page numbers refer to
+ * the SSD1306 datasheet rev 1.1, like the comments in ssd1366.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "gddram.h"
+#include "mirror.h"
+
+// the biggest packet: an OLED page of single-byte literals, or an LED
+// chunk, plus the header
+#define PACKET_MAX (5 + GDDRAM_WIDTH * 2)
+_Static_assert(MIRROR_LED_CHUNK * 5 <= GDDRAM_WIDTH * 2, "LED packets fit");
+// "@mir <ms> <base64>\n"
+#define LINE_MAX (6 + 11 + (PACKET_MAX + 2) / 3 * 4 + 2)
+_Static_assert(LINE_MAX <= MIRROR_BURST, "any line fits the bucket");
+
+/*** GDDRAM model *************************************************************/
+
+static gddram_t oled = GDDRAM_INIT;
+static portMUX_TYPE oled_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile int enabled;
+
+// Control bytes (p20): Co = 1 means one byte and then another control byte,
+// D/C# = 1 that the bytes are GDDRAM data.  While the stream is off the
+// model isn't kept up, mirror_enable() has the panel redrawn instead.
+void mirror_oled(uint8_t control, const uint8_t *data, size_t len) {
+    if (!enabled)
+        return;
+    int single = control & 0x80, is_data = control & 0x40, expect_control = 0;
+
+    portENTER_CRITICAL(&oled_mux);
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t b = data[i];
+        if (expect_control) {
+            single = b & 0x80;
+            is_data = b & 0x40;
+            expect_control = 0;
+            continue;
+        }
+        if (is_data)
+            gddram_data_byte(&oled, b);
+        else
+            gddram_command_byte(&oled, b);
+        expect_control = single;
+    }
+    portEXIT_CRITICAL(&oled_mux);
+}
+
+/*** Delta encoding ***********************************************************/
+
+// unit is a constant wherever this is inlined, so the compare is one load
+// of each side
+static inline int same(const uint8_t *a, const uint8_t *b, int unit) {
+    return !memcmp(a, b, unit);
+}
+
+// units from i on that are unchanged (cur equal to sent), at most max
+static inline int unchanged(const uint8_t *cur, const uint8_t *sent, int i, int n, int unit, int max) {
+    int k = 0;
+    while (i + k < n && k < max && same(cur + (i + k) * unit, sent + (i + k) * unit, unit))
+        k++;
+    return k;
+}
+
+// units from i on that equal unit i, at most max
+static inline int repeats(const uint8_t *cur, int i, int n, int unit, int max) {
+    int k = 1;
+    while (i + k < n && k < max && same(cur + (i + k) * unit, cur + i * unit, unit))
+        k++;
+    return k;
+}
+
+static inline __attribute__((always_inline))
+int encode(uint8_t *out, const uint8_t *cur, const uint8_t *sent, int n, int unit) {
+    // a repeat is worth it where it is shorter than the literal
+    const int min_repeat = unit == 1 ? 3 : 2;
+    int o = 0, i = 0;
+    while (i < n) {
+        const int skip = unchanged(cur, sent, i, n, unit, n);
+        if (i + skip == n)
+            break;
+        for (int left = skip; left > 0; left -= 64)
+            out[o++] = MIRROR_OP_SKIP | ((left < 64 ? left : 64) - 1);
+        i += skip;
+
+        const int rep = repeats(cur, i, n, unit, 128);
+        if (rep >= min_repeat) {
+            out[o++] = MIRROR_OP_REPEAT | (rep - 1);
+            memcpy(out + o, cur + i * unit, unit);
+            o += unit;
+            i += rep;
+            continue;
+        }
+        // up to where two units are unchanged or a repeat starts
+        int lit = 1;
+        while (i + lit < n && lit < 64 &&
+               unchanged(cur, sent, i + lit, n, unit, 2) < 2 &&
+               repeats(cur, i + lit, n, unit, min_repeat) < min_repeat)
+            lit++;
+        out[o++] = MIRROR_OP_LITERAL | (lit - 1);
+        memcpy(out + o, cur + i * unit, lit * unit);
+        o += lit * unit;
+        i += lit;
+    }
+    return o;
+}
+
+// compiled once per unit size the stream uses
+int mirror_encode(uint8_t *out, const uint8_t *cur, const uint8_t *sent, int n, int unit) {
+    if (unit == 1)
+        return encode(out, cur, sent, n, 1);
+    if (unit == 4)
+        return encode(out, cur, sent, n, 4);
+    return encode(out, cur, sent, n, unit);
+}
+
+/*** Stream *******************************************************************/
+
+static const uint32_t *led_pixels;
+static uint32_t *led_sent;
+static int led_len;
+static uint32_t rate;
+
+static uint8_t oled_sent[GDDRAM_PAGES][GDDRAM_WIDTH];
+static int reset_due;
+static int cursor;  // packet to try first
+static int64_t last_poll_us, last_reset_us;
+static uint32_t tokens;
+
+typedef struct {
+    uint32_t lines, bytes, deferred, polls;
+    uint32_t encode_us, encode_us_max;
+} stream_stats_t;
+static stream_stats_t stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void mirror_init(const uint32_t *pixels, uint32_t *sent, int n, uint32_t bytes_per_s) {
+    led_pixels = pixels;
+    led_sent = sent;
+    led_len = n;
+    rate = bytes_per_s;
+}
+
+void mirror_enable(int on) {
+    reset_due = 1;
+    enabled = on;
+}
+
+int mirror_enabled() {
+    return enabled;
+}
+
+static const char base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_encode(char *out, const uint8_t *in, int len) {
+    int o = 0;
+    for (int i = 0; i < len; i += 3) {
+        const uint32_t v = in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) |
+                           (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = base64[v >> 18];
+        out[o++] = base64[(v >> 12) & 0x3F];
+        out[o++] = i + 1 < len ? base64[(v >> 6) & 0x3F] : '=';
+        out[o++] = i + 2 < len ? base64[v & 0x3F] : '=';
+    }
+    return o;
+}
+
+// Send a packet if the bucket has enough for its line.  Returns the bytes
+// sent, 0 if it hasn't.
+static int send(uint32_t ms, const uint8_t *packet, int len) {
+    static char line[LINE_MAX];
+    int n = snprintf(line, sizeof line, "@mir %u ", ms);
+    n += base64_encode(line + n, packet, len);
+    line[n++] = '\n';
+    if (n > tokens)
+        return 0;
+    tokens -= n;
+    fwrite(line, 1, n, stdout);
+    return n;
+}
+
+static void count_line(int bytes) {
+    portENTER_CRITICAL(&stats_mux);
+    if (bytes) {
+        stats.lines++;
+        stats.bytes += bytes;
+    } else {
+        stats.deferred++;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+// Packet k of one round: the OLED pages, then the LED chunks.  Encodes it
+// into packet and returns its length, 0 if nothing changed.  cur gets what
+// the viewer will have once it is sent.
+static int encode_packet(int k, uint8_t *packet, uint8_t *cur) {
+    if (k < GDDRAM_PAGES) {
+        portENTER_CRITICAL(&oled_mux);
+        memcpy(cur, oled.ram[k], GDDRAM_WIDTH);
+        portEXIT_CRITICAL(&oled_mux);
+        packet[0] = MIRROR_OLED_PAGE;
+        packet[1] = k;
+        const int ops = mirror_encode(packet + 2, cur, oled_sent[k], GDDRAM_WIDTH, 1);
+        return ops ? 2 + ops : 0;
+    }
+    const int first = (k - GDDRAM_PAGES) * MIRROR_LED_CHUNK;
+    const int n = led_len - first < MIRROR_LED_CHUNK ? led_len - first : MIRROR_LED_CHUNK;
+    // the LED task may be setting pixels meanwhile; a torn chunk is sent
+    // as it was read, and the rest follows with the next poll
+    memcpy(cur, &led_pixels[first], n * 4);
+    packet[0] = MIRROR_LED;
+    packet[1] = first & 0xFF;
+    packet[2] = first >> 8;
+    packet[3] = led_len & 0xFF;
+    packet[4] = led_len >> 8;
+    const int ops = mirror_encode(packet + 5, cur, (const uint8_t *)&led_sent[first], n, 4);
+    return ops ? 5 + ops : 0;
+}
+
+static void commit_packet(int k, const uint8_t *cur) {
+    if (k < GDDRAM_PAGES) {
+        memcpy(oled_sent[k], cur, GDDRAM_WIDTH);
+    } else {
+        const int first = (k - GDDRAM_PAGES) * MIRROR_LED_CHUNK;
+        const int n = led_len - first < MIRROR_LED_CHUNK ? led_len - first : MIRROR_LED_CHUNK;
+        memcpy(&led_sent[first], cur, n * 4);
+    }
+}
+
+void mirror_poll() {
+    static uint8_t packet[PACKET_MAX];
+    static uint8_t cur[GDDRAM_WIDTH > MIRROR_LED_CHUNK * 4 ? GDDRAM_WIDTH : MIRROR_LED_CHUNK * 4];
+
+    const int64_t now = esp_timer_get_time();
+    const uint32_t ms = now / 1000;
+    const int64_t earned = (now - last_poll_us) * rate / 1000000;
+    tokens = tokens + earned < MIRROR_BURST ? tokens + earned : MIRROR_BURST;
+    last_poll_us = now;
+    if (!enabled)
+        return;
+
+    if (now - last_reset_us >= MIRROR_KEY_MS * 1000ll)
+        reset_due = 1;
+    if (reset_due) {
+        static const uint8_t reset = MIRROR_RESET;
+        const int bytes = send(ms, &reset, 1);
+        count_line(bytes);
+        if (!bytes)
+            return;
+        reset_due = 0;
+        last_reset_us = now;
+        memset(oled_sent, 0, sizeof oled_sent);
+        memset(led_sent, 0, led_len * sizeof *led_sent);
+    }
+
+    const int count = GDDRAM_PAGES + (led_len + MIRROR_LED_CHUNK - 1) / MIRROR_LED_CHUNK;
+    uint32_t encode_us = 0;
+    int sent_any = 0;
+    for (int i = 0; i < count; i++) {
+        const int k = (cursor + i) % count;
+        const int64_t start = esp_timer_get_time();
+        const int len = encode_packet(k, packet, cur);
+        encode_us += esp_timer_get_time() - start;
+        if (!len)
+            continue;
+        const int bytes = send(ms, packet, len);
+        count_line(bytes);
+        if (!bytes) {
+            // start here next time, so that every packet gets its turn
+            cursor = k;
+            break;
+        }
+        commit_packet(k, cur);
+        sent_any = 1;
+    }
+    if (sent_any)
+        fflush(stdout);
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.polls++;
+    stats.encode_us += encode_us;
+    if (encode_us > stats.encode_us_max)
+        stats.encode_us_max = encode_us;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void mirror_report(uint32_t ms) {
+    portENTER_CRITICAL(&stats_mux);
+    const stream_stats_t s = stats;
+    memset(&stats, 0, sizeof stats);
+    portEXIT_CRITICAL(&stats_mux);
+    printf("@mon %u mirror %u %u %u %u %u\n", ms, s.lines, s.bytes, s.deferred,
+           s.polls ? s.encode_us / s.polls : 0, s.encode_us_max);
+}
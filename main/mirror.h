@@ -0,0 +1,83 @@
+/*
+ * mirror.h
+ *
+ * Streams what the OLED and the LED strip show to the console UART, for
+ * tools/mirror_view.py, which rebuilds both and draws them in a terminal.
+ *
+ * While the stream is on, every transaction ssd1306_write() sends also
+ * goes through a model of the panel's GDDRAM addressing (gddram.h), which
+ * keeps a 1 KB copy of GDDRAM.  The panel's own scrolling and display
+ * settings aren't mirrored.  The model doesn't follow the panel while the
+ * stream is off, so whoever starts it has the panel drawn again.
+ * The LED pixels are read where the driver sends them from.
+ *
+ * mirror_poll(), from the console task, compares both with its copy of what
+ * the viewer has and sends the differences as lines among the rest of the
+ * console output:
+ *
+ *   @mir <ms> <packet, base64>
+ *
+ * <ms> is the uptime of the poll that sent the line.  Packets, by first
+ * byte:
+ *
+ *   MIRROR_RESET       the viewer clears both surfaces to 0
+ *   MIRROR_OLED_PAGE   <page> <ops over its 128 columns, a byte each>
+ *   MIRROR_LED         <first lo> <first hi> <length lo> <length hi>
+ *                      <ops over up to MIRROR_LED_CHUNK pixels from first,
+ *                       4 bytes each as in pixelColor_t>
+ *
+ * Ops (the top bits; n is the rest, plus one) go through the units in
+ * order, the ones after the last op are unchanged:
+ *
+ *   MIRROR_OP_SKIP     n units unchanged (up to 64)
+ *   MIRROR_OP_LITERAL  n units follow (up to 64)
+ *   MIRROR_OP_REPEAT   the unit that follows, n times (up to 128)
+ *
+ * The stream is rate limited by a token bucket of bytes per second.  A
+ * poll sends what fits and leaves the rest; since deltas are against what
+ * the viewer has, whatever is left over goes out with the next changes
+ * instead of queueing up, and memory stays at the two copies and a line.
+ * A reset every MIRROR_KEY_MS lets a viewer start in the middle.
+ */
+
+#ifndef MAIN_MIRROR_H_
+#define MAIN_MIRROR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIRROR_RESET     0x00
+#define MIRROR_OLED_PAGE 0x01
+#define MIRROR_LED       0x02
+
+#define MIRROR_OP_SKIP    0x00
+#define MIRROR_OP_LITERAL 0x40
+#define MIRROR_OP_REPEAT  0x80
+
+#define MIRROR_LED_CHUNK 32     // pixels per LED packet
+#define MIRROR_KEY_MS    10000  // between resets
+#define MIRROR_BURST     512    // bytes the bucket holds, more than any line
+
+// The strip: n pixel words at pixels, and room for n more at sent for what
+// the viewer has.  bytes_per_s is the share of the UART the stream gets.
+void mirror_init(const uint32_t *pixels, uint32_t *sent, int n, uint32_t bytes_per_s);
+// A transaction to the OLED, the control byte and what follows it
+void mirror_oled(uint8_t control, const uint8_t *data, size_t len);
+
+// Start (with a reset) or stop the stream.  After starting it, redraw the
+// whole panel, addressing setup included.
+void mirror_enable(int on);
+int mirror_enabled();
+// Send what changed since the last poll, as far as the rate allows
+void mirror_poll();
+// The counters since the previous call, as a monitor line:
+//   @mon <ms> mirror <lines> <bytes> <deferred> <encode_us_avg> <encode_us_max>
+// <deferred> counts polls that ran out of budget, the encode times are per
+// poll and leave out printing.
+void mirror_report(uint32_t ms);
+
+// Ops turning n units of `unit` bytes from sent into cur, into out (room for
+// n * (unit + 1) bytes).  Returns the bytes written, 0 if nothing changed.
+int mirror_encode(uint8_t *out, const uint8_t *cur, const uint8_t *sent, int n, int unit);
+
+#endif /* MAIN_MIRROR_H_ */
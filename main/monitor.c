@@ -0,0 +1,138 @@
+/*
+ * monitor.c
+ *
+ * Task, stack and heap monitor, see monitor.h
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "monitor.h"
+
+#define MONITOR_STACK 3072
+#define MONITOR_PRIO  (tskIDLE_PRIORITY + 1)
+
+// with nothing to report periodically, still wake up to notice a new period
+#define MONITOR_IDLE_MS 1000
+
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t status[MONITOR_MAX_TASKS];
+
+// run time counters of the previous snapshot, to report the difference
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t runtime;
+} task_runtime_t;
+
+static task_runtime_t prev[MONITOR_MAX_TASKS];
+static UBaseType_t prev_count;
+static uint32_t prev_total;
+#endif
+
+static volatile uint32_t period;
+static monitor_extra_fn extra;
+// snapshots come from the monitor task and the console task
+static SemaphoreHandle_t monitor_lock;
+
+#if configUSE_TRACE_FACILITY
+static uint32_t prev_runtime(TaskHandle_t handle) {
+    for (UBaseType_t i = 0; i < prev_count; i++) {
+        if (prev[i].handle == handle)
+            return prev[i].runtime;
+    }
+    return 0;  // new since the last snapshot
+}
+
+static void report_tasks(uint32_t ms, UBaseType_t count, uint32_t total) {
+    const uint32_t elapsed = total - prev_total;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &status[i];
+        uint32_t cpu = 0;
+#if configGENERATE_RUN_TIME_STATS
+        if (elapsed > 0) {
+            const uint32_t ran = t->ulRunTimeCounter - prev_runtime(t->xHandle);
+            cpu = (uint64_t)ran * 1000 / elapsed;
+        }
+#endif
+        printf("@mon %u task %s %u %u %u %d\n", ms, t->pcTaskName, cpu,
+               (unsigned)t->usStackHighWaterMark, (unsigned)t->uxCurrentPriority,
+               t->xCoreID == tskNO_AFFINITY ? -1 : (int)t->xCoreID);
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev[i].handle = status[i].xHandle;
+#if configGENERATE_RUN_TIME_STATS
+        prev[i].runtime = status[i].ulRunTimeCounter;
+#endif
+    }
+    prev_count = count;
+    prev_total = total;
+}
+#endif
+
+void monitor_report() {
+    if (!monitor_lock)
+        return;  // not started
+    xSemaphoreTake(monitor_lock, portMAX_DELAY);
+    const int64_t start = esp_timer_get_time();
+    const uint32_t ms = start / 1000;
+
+    UBaseType_t tasks = uxTaskGetNumberOfTasks();
+#if configUSE_TRACE_FACILITY
+    uint32_t total = 0;
+    // returns 0 if there are more tasks than fit
+    const UBaseType_t count = uxTaskGetSystemState(status, MONITOR_MAX_TASKS, &total);
+#endif
+
+    printf("@mon %u heap %u %u %u\n", ms,
+           (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+#if configUSE_TRACE_FACILITY
+    if (count > 0) {
+        tasks = count;
+        report_tasks(ms, count, total);
+    }
+#endif
+    if (extra)
+        extra(ms);
+    printf("@mon %u self %u %u\n", ms, (unsigned)tasks,
+           (uint32_t)(esp_timer_get_time() - start));
+    xSemaphoreGive(monitor_lock);
+}
+
+void monitor_set_extra(monitor_extra_fn fn) {
+    extra = fn;
+}
+
+void monitor_set_period(uint32_t period_ms) {
+    period = period_ms;
+}
+
+static void monitor_task(void *pvParameters) {
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        const uint32_t p = period;
+        vTaskDelayUntil(&last_wake, (p ? p : MONITOR_IDLE_MS) / portTICK_PERIOD_MS);
+        if (p)
+            monitor_report();
+    }
+
+    vTaskDelete(NULL);
+}
+
+void monitor_start(uint32_t period_ms) {
+    static StaticSemaphore_t lock_buf;
+    static StackType_t stack[MONITOR_STACK];
+    static StaticTask_t tcb;
+
+    monitor_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    period = period_ms;
+    xTaskCreateStatic(&monitor_task, "monitor_task", MONITOR_STACK, NULL, MONITOR_PRIO,
+                      stack, &tcb);
+}
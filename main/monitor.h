@@ -0,0 +1,50 @@
+/*
+ * monitor.h
+ *
+ * Low-priority system monitor.  Every period it takes one snapshot of all
+ * tasks (uxTaskGetSystemState) and of the heap and prints it to the console
+ * UART as a few short lines that a script can pick out of the log:
+ *
+ *   @mon <ms> heap <free> <min_free> <largest_block>
+ *   @mon <ms> task <name> <cpu> <stack_free> <prio> <core>
+ *   @mon <ms> self <tasks> <sample_us>
+ *
+ * plus the lines of the source set with monitor_set_extra(), before "self",
+ * for subsystems the monitor doesn't know about (main.c adds the LED
+ * driver's "rmt" line and the "mirror" line).
+ *
+ * <ms> is the uptime of the snapshot in milliseconds.  Heap numbers are bytes
+ * of 8-bit capable memory.  <cpu> is the task's run time since the previous
+ * snapshot in permille of one core (so all tasks add up to 1000 per core),
+ * <stack_free> the stack high water mark in bytes, <core> the affinity or -1.
+ * The "self" line reports the number of tasks and how long taking and
+ * printing the snapshot took, which is what the monitor itself costs.
+ *
+ * The snapshot suspends the scheduler for a walk over at most
+ * MONITOR_MAX_TASKS tasks, and everything lives in static buffers, so the
+ * overhead is bounded by that and the period.  Per-task CPU needs
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (esp_timer clock); the counters
+ * are 32 bit microseconds, so periods must stay well below 71 minutes.
+ */
+
+#ifndef MAIN_MONITOR_H_
+#define MAIN_MONITOR_H_
+
+#include <stdint.h>
+
+// More tasks than this are only counted, not reported individually
+#define MONITOR_MAX_TASKS 20
+
+// Start the monitor task, reporting every period_ms (0: only on request)
+void monitor_start(uint32_t period_ms);
+// Change the period at runtime, 0 stops periodic reports
+void monitor_set_period(uint32_t period_ms);
+// Take and print a snapshot from the calling task
+void monitor_report();
+
+// Print more @mon lines with every snapshot, with its <ms>.  Called in the
+// monitor task or in the console task, one at a time.
+typedef void (*monitor_extra_fn)(uint32_t ms);
+void monitor_set_extra(monitor_extra_fn fn);
+
+#endif /* MAIN_MONITOR_H_ */
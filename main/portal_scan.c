@@ -0,0 +1,117 @@
+/*
+ * portal_scan.c
+ *
+ * Streaming scanner for the captive portal login page, see portal_scan.h
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "portal_scan.h"
+
+static const char done_needle[] = "Sie sind erfolgreich eingeloggt.";
+static const char user_needle[] =
+    "<input type=\"hidden\" name=\"username\" type=\"text\" value=\"";
+static const char pass_needle[] =
+    "<input type=\"hidden\" name=\"password\" type=\"password\" value=\"";
+
+#define NEEDLE_FITS(needle) \
+    _Static_assert(sizeof needle - 1 <= PORTAL_NEEDLE_MAX, #needle " fits fail[]")
+NEEDLE_FITS(done_needle);
+NEEDLE_FITS(user_needle);
+NEEDLE_FITS(pass_needle);
+
+enum {
+    CAPTURE_NONE,
+    CAPTURE_USER,  // fixed length
+    CAPTURE_PASS,  // up to the closing quote
+};
+
+// needle must not be longer than PORTAL_NEEDLE_MAX, see NEEDLE_FITS
+static void needle_init(portal_needle_t *n, const char *needle) {
+    n->needle = needle;
+    n->len = strlen(needle);
+    assert(n->len > 0 && n->len <= PORTAL_NEEDLE_MAX);
+    n->matched = 0;
+
+    // fail[i]: length of the longest proper border of needle[0..i]
+    n->fail[0] = 0;
+    uint8_t k = 0;
+    for (int i = 1; i < n->len; i++) {
+        while (k > 0 && needle[i] != needle[k])
+            k = n->fail[k - 1];
+        if (needle[i] == needle[k])
+            k++;
+        n->fail[i] = k;
+    }
+}
+
+// Advance by one character, returns 1 if the needle just matched completely
+static int needle_step(portal_needle_t *n, char c) {
+    while (n->matched > 0 && c != n->needle[n->matched])
+        n->matched = n->fail[n->matched - 1];
+    if (c == n->needle[n->matched])
+        n->matched++;
+    if (n->matched == n->len) {
+        n->matched = n->fail[n->len - 1];
+        return 1;
+    }
+    return 0;
+}
+
+void portal_scan_init(portal_scan_t *s) {
+    memset(s, 0, sizeof *s);
+    needle_init(&s->done, done_needle);
+    needle_init(&s->user, user_needle);
+    needle_init(&s->pass, pass_needle);
+    s->result = PORTAL_SCANNING;
+}
+
+static void capture_char(portal_scan_t *s, char c) {
+    if (s->capture == CAPTURE_USER) {
+        s->username[s->user_len++] = c;
+        if (s->user_len == PORTAL_USERNAME_LEN) {
+            s->have_user = 1;
+            s->capture = CAPTURE_NONE;
+        }
+    } else if (c == '"') {
+        s->have_pass = 1;
+        s->capture = CAPTURE_NONE;
+    } else if (s->pass_len == PORTAL_PASSWORD_MAX) {
+        // not what we expect a password to look like, keep looking
+        s->pass_len = 0;
+        s->capture = CAPTURE_NONE;
+    } else {
+        s->password[s->pass_len++] = c;
+    }
+    s->username[s->user_len] = 0;
+    s->password[s->pass_len] = 0;
+}
+
+portal_result_t portal_scan_feed(portal_scan_t *s, const char *data, int len) {
+    for (int i = 0; i < len && s->result == PORTAL_SCANNING; i++) {
+        const char c = data[i];
+        if (s->capture != CAPTURE_NONE) {
+            // the last character of a field completes the form right away,
+            // so that the caller can stop reading there
+            capture_char(s, c);
+            if (s->have_user && s->have_pass)
+                s->result = PORTAL_FORM;
+            continue;
+        }
+
+        const int done = needle_step(&s->done, c);
+        const int user = needle_step(&s->user, c);
+        const int pass = needle_step(&s->pass, c);
+        if (done) {
+            s->result = PORTAL_LOGGED_IN;
+        } else if (user && !s->have_user) {
+            s->capture = CAPTURE_USER;
+            s->user_len = 0;
+        } else if (pass && !s->have_pass) {
+            s->capture = CAPTURE_PASS;
+            s->pass_len = 0;
+        }
+    }
+    return s->result;
+}
@@ -0,0 +1,46 @@
+/*
+ * portal_scan.h
+ *
+ * Streaming scanner for the KA-WLAN captive portal login page.  It is fed the
+ * page chunk by chunk and pulls out the hidden username and password fields
+ * of the login form, or notices that we are already logged in.  As soon as
+ * either is known the caller can stop reading.
+ */
+
+#ifndef MAIN_PORTAL_SCAN_H_
+#define MAIN_PORTAL_SCAN_H_
+
+#include <stdint.h>
+
+#define PORTAL_NEEDLE_MAX   64
+#define PORTAL_USERNAME_LEN 17  // our MAC address, "xx:xx:xx:xx:xx:xx"
+#define PORTAL_PASSWORD_MAX 31
+
+typedef enum {
+    PORTAL_SCANNING,   // need more of the page
+    PORTAL_LOGGED_IN,  // the page says we're logged in already
+    PORTAL_FORM,       // username and password were found
+} portal_result_t;
+
+// Knuth-Morris-Pratt matcher state for one needle
+typedef struct {
+    const char *needle;
+    uint8_t len;
+    uint8_t matched;
+    uint8_t fail[PORTAL_NEEDLE_MAX];
+} portal_needle_t;
+
+typedef struct {
+    portal_needle_t done, user, pass;
+    uint8_t capture;  // field whose value is being read, see portal_scan.c
+    char username[PORTAL_USERNAME_LEN + 1];
+    char password[PORTAL_PASSWORD_MAX + 1];
+    uint8_t user_len, pass_len;
+    uint8_t have_user, have_pass;
+    portal_result_t result;
+} portal_scan_t;
+
+void portal_scan_init(portal_scan_t *s);
+portal_result_t portal_scan_feed(portal_scan_t *s, const char *data, int len);
+
+#endif /* MAIN_PORTAL_SCAN_H_ */
@@ -0,0 +1,285 @@
+/*
+ * quote_store.c
+ *
+ * Quotes and history in NVS, see quote_store.h
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "quote_store.h"
+
+#define STORE_NAMESPACE "tbhut"
+#define STORE_VERSION   1
+
+static const char *TAG = "quote_store";
+
+typedef struct {
+    char pair[QUOTE_PAIR_LEN];
+    char bid[QUOTE_PRICE_LEN];
+    char ask[QUOTE_PRICE_LEN];
+} stored_quote_t;
+
+// "quotes" blob: only the valid ones are stored
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    stored_quote_t q[QUOTE_MAX_PAIRS];
+} stored_book_t;
+
+// "history" blob: version, samples, pairs, then per pair the name, the
+// oldest sample and the deltas, as zigzag varints of at most 5 bytes
+#define HISTORY_BLOB_MAX \
+    (3 + QUOTE_MAX_PAIRS * (QUOTE_PAIR_LEN + 5 * QUOTE_HISTORY_LEN))
+
+static nvs_handle_t nvs;
+static uint8_t nvs_ok;
+static uint32_t sample_period, write_period;
+
+// ring of samples, all pairs share head and count
+static int32_t hist[QUOTE_MAX_PAIRS][QUOTE_HISTORY_LEN];
+static char hist_pairs[QUOTE_MAX_PAIRS][QUOTE_PAIR_LEN];
+static int hist_npairs, hist_head, hist_count;
+static portMUX_TYPE hist_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t last_sample, last_write;
+static uint8_t saved_this_boot;
+// of what is in flash, to skip writing the same again
+static uint32_t quotes_hash, history_hash;
+
+static stored_book_t book_blob;
+static uint8_t history_blob[HISTORY_BLOB_MAX];
+
+// FNV-1a
+static uint32_t hash(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint32_t h = 2166136261u;
+    while (len--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+static size_t put_varint(uint8_t *out, int32_t v) {
+    uint32_t z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    size_t n = 0;
+    while (z >= 0x80) {
+        out[n++] = z | 0x80;
+        z >>= 7;
+    }
+    out[n++] = z;
+    return n;
+}
+
+// Returns the position after the varint, NULL if it is cut off
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, int32_t *v) {
+    uint32_t z = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        const uint8_t b = *p++;
+        z |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static int find_pair(const quote_book_t *book, const char *pair) {
+    for (int i = 0; i < book->count; i++) {
+        if (memcmp(book->q[i].pair, pair, QUOTE_PAIR_LEN) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void quote_store_init(uint32_t sample_ms, uint32_t write_ms) {
+    sample_period = sample_ms;
+    write_period = write_ms;
+    esp_err_t err = nvs_open(STORE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Can't open NVS: %s, quotes won't survive a reboot",
+                 esp_err_to_name(err));
+        return;
+    }
+    nvs_ok = 1;
+}
+
+static int load_quotes(quote_book_t *book) {
+    size_t len = sizeof book_blob;
+    if (nvs_get_blob(nvs, "quotes", &book_blob, &len) != ESP_OK ||
+        book_blob.version != STORE_VERSION ||
+        len != offsetof(stored_book_t, q) + book_blob.count * sizeof(stored_quote_t))
+        return 0;
+    quotes_hash = hash(&book_blob, len);
+
+    int restored = 0;
+    for (int i = 0; i < book_blob.count; i++) {
+        const stored_quote_t *s = &book_blob.q[i];
+        const int slot = find_pair(book, s->pair);
+        if (slot < 0)
+            continue;  // not on the watchlist any more
+        quote_t *q = &book->q[slot];
+        memcpy(q->bid, s->bid, QUOTE_PRICE_LEN);
+        memcpy(q->ask, s->ask, QUOTE_PRICE_LEN);
+        q->bid[QUOTE_PRICE_LEN] = 0;
+        q->ask[QUOTE_PRICE_LEN] = 0;
+        q->valid = 1;
+        q->stale = 1;
+        restored++;
+    }
+    if (restored)
+        book->stale = 1;
+    return restored;
+}
+
+static void load_history(const quote_book_t *book) {
+    size_t len = sizeof history_blob;
+    if (nvs_get_blob(nvs, "history", history_blob, &len) != ESP_OK || len < 3 ||
+        history_blob[0] != STORE_VERSION || history_blob[1] > QUOTE_HISTORY_LEN)
+        return;
+    history_hash = hash(history_blob, len);
+
+    const int count = history_blob[1], npairs = history_blob[2];
+    const uint8_t *p = history_blob + 3, *end = history_blob + len;
+    for (int i = 0; i < npairs && p; i++) {
+        if (end - p < QUOTE_PAIR_LEN)
+            return;
+        const int slot = find_pair(book, (const char *)p);
+        p += QUOTE_PAIR_LEN;
+        int32_t mid = 0;
+        for (int j = 0; j < count && p; j++) {
+            int32_t delta;
+            p = get_varint(p, end, &delta);
+            mid += delta;
+            if (p && slot >= 0)
+                hist[slot][j] = mid;
+        }
+    }
+    if (p) {
+        hist_count = count;
+        hist_head = count % QUOTE_HISTORY_LEN;
+    }
+}
+
+int quote_store_load(quote_book_t *book) {
+    hist_npairs = book->count;
+    for (int i = 0; i < book->count; i++)
+        memcpy(hist_pairs[i], book->q[i].pair, QUOTE_PAIR_LEN);
+    if (!nvs_ok)
+        return 0;
+
+    const int restored = load_quotes(book);
+    load_history(book);
+    ESP_LOGI(TAG, "Restored %d quotes and %d history samples", restored, hist_count);
+    return restored;
+}
+
+static void sample(const quote_book_t *book) {
+    portENTER_CRITICAL(&hist_mux);
+    const int prev = (hist_head + QUOTE_HISTORY_LEN - 1) % QUOTE_HISTORY_LEN;
+    for (int i = 0; i < hist_npairs; i++) {
+        // a pair missing from this response, or from every one since the
+        // restore, keeps its last price
+        const quote_t *q = &book->q[i];
+        hist[i][hist_head] = q->valid && !q->stale ? quote_mid_points(q) :
+                             hist_count ? hist[i][prev] : 0;
+    }
+    hist_head = (hist_head + 1) % QUOTE_HISTORY_LEN;
+    if (hist_count < QUOTE_HISTORY_LEN)
+        hist_count++;
+    portEXIT_CRITICAL(&hist_mux);
+}
+
+// Stale quotes are saved too, as the last prices known: that writes back
+// what was restored, so they stay stale after the next reboot
+static size_t encode_quotes(const quote_book_t *book) {
+    memset(&book_blob, 0, sizeof book_blob);
+    book_blob.version = STORE_VERSION;
+    for (int i = 0; i < book->count; i++) {
+        const quote_t *q = &book->q[i];
+        if (!q->valid)
+            continue;
+        stored_quote_t *s = &book_blob.q[book_blob.count++];
+        memcpy(s->pair, q->pair, QUOTE_PAIR_LEN);
+        memcpy(s->bid, q->bid, QUOTE_PRICE_LEN);
+        memcpy(s->ask, q->ask, QUOTE_PRICE_LEN);
+    }
+    return offsetof(stored_book_t, q) + book_blob.count * sizeof(stored_quote_t);
+}
+
+// Only the quote task writes the ring, so it can be read without the lock
+static size_t encode_history() {
+    uint8_t *p = history_blob;
+    *p++ = STORE_VERSION;
+    *p++ = hist_count;
+    *p++ = hist_npairs;
+    const int oldest = (hist_head + QUOTE_HISTORY_LEN - hist_count) % QUOTE_HISTORY_LEN;
+    for (int i = 0; i < hist_npairs; i++) {
+        memcpy(p, hist_pairs[i], QUOTE_PAIR_LEN);
+        p += QUOTE_PAIR_LEN;
+        int32_t prev = 0;
+        for (int j = 0; j < hist_count; j++) {
+            const int32_t mid = hist[i][(oldest + j) % QUOTE_HISTORY_LEN];
+            p += put_varint(p, mid - prev);
+            prev = mid;
+        }
+    }
+    return p - history_blob;
+}
+
+// Write blob under key unless flash has the same already
+static int save_blob(const char *key, const void *blob, size_t len, uint32_t *flash_hash) {
+    const uint32_t h = hash(blob, len);
+    if (h == *flash_hash)
+        return 0;
+    esp_err_t err = nvs_set_blob(nvs, key, blob, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Can't save %s: %s", key, esp_err_to_name(err));
+        return 0;
+    }
+    *flash_hash = h;
+    return 1;
+}
+
+static void save(const quote_book_t *book) {
+    const size_t quotes_len = encode_quotes(book);
+    const size_t history_len = encode_history();
+    const int quotes = save_blob("quotes", &book_blob, quotes_len, &quotes_hash);
+    const int history = save_blob("history", history_blob, history_len, &history_hash);
+    if (quotes || history) {
+        nvs_commit(nvs);
+        ESP_LOGI(TAG, "Saved%s%s (%u + %u bytes)", quotes ? " quotes" : "",
+                 history ? " history" : "", (unsigned)(quotes ? quotes_len : 0),
+                 (unsigned)(history ? history_len : 0));
+    }
+}
+
+void quote_store_update(const quote_book_t *book) {
+    if (book->stale)
+        return;  // only what was fetched in this boot
+    const int64_t now = esp_timer_get_time() / 1000;
+    if (!hist_count || now - last_sample >= sample_period) {
+        sample(book);
+        last_sample = now;
+    }
+    if (nvs_ok && (!saved_this_boot || now - last_write >= write_period)) {
+        save(book);
+        saved_this_boot = 1;
+        last_write = now;
+    }
+}
+
+int quote_history_get(int slot, int32_t *mids, int max) {
+    portENTER_CRITICAL(&hist_mux);
+    int n = hist_count < max ? hist_count : max;
+    const int first = (hist_head + QUOTE_HISTORY_LEN - n) % QUOTE_HISTORY_LEN;
+    for (int j = 0; j < n; j++)
+        mids[j] = hist[slot][(first + j) % QUOTE_HISTORY_LEN];
+    portEXIT_CRITICAL(&hist_mux);
+    return n;
+}
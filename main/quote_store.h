@@ -0,0 +1,50 @@
+/*
+ * quote_store.h
+ *
+ * Last quotes and mid-price history, kept in NVS so that the display has
+ * something to show right after a reboot.  Restored quotes are marked
+ * stale (quote_t.stale) until a fetch has a price for their pair, and the
+ * book (quote_book_t.stale) until the first fetch.  Only fetched prices go
+ * into the history.
+ *
+ * The history is a ring of QUOTE_HISTORY_LEN mid prices per pair
+ * (quote_mid_points()), sampled every sample_ms from the fetched books.  In
+ * flash it is delta-encoded: per pair the oldest sample, then the
+ * differences to the previous one as zigzag varints, which is one byte for
+ * moves of up to 63 points and mostly two otherwise.
+ *
+ * Flash writes: quotes and history are two blobs in namespace "tbhut".  They
+ * are saved once after the first fetch of a boot and then at most every
+ * write_ms, and each only if it differs from what is in flash already.
+ * With the defaults in main.c (a sample a minute, a save every ten
+ * minutes, four pairs) a save writes 86 bytes of quotes and about 300 of
+ * history, some 550 bytes in 32-byte NVS entries with headers, so 3.3 KB
+ * per hour plus one save per boot.  The default 24 KB NVS partition
+ * rotates through five 4 KB sectors, so each is erased about four times a
+ * day, and the rated 100000 erase cycles last for decades.  The worst
+ * case, eight volatile pairs at five bytes a delta, is 18 KB per hour,
+ * still more than ten years.  Over a quiet weekend the blobs stop changing
+ * and nothing is written at all.
+ */
+
+#ifndef MAIN_QUOTE_STORE_H_
+#define MAIN_QUOTE_STORE_H_
+
+#include <stdint.h>
+
+#include "quotes.h"
+
+#define QUOTE_HISTORY_LEN 64  // samples per pair
+
+// Open the store, samples are taken every sample_ms, saves at most every write_ms
+void quote_store_init(uint32_t sample_ms, uint32_t write_ms);
+// Fill the valid quotes of book from flash and mark them and the book stale,
+// restore the history.  Returns the number of quotes restored.
+int quote_store_load(quote_book_t *book);
+// After each successful fetch: sample the history and save when due
+void quote_store_update(const quote_book_t *book);
+// Copy out the history of watchlist slot, oldest first, returns the number
+// of samples.  0 is a sample from before the pair had a quote.
+int quote_history_get(int slot, int32_t *mids, int max);
+
+#endif /* MAIN_QUOTE_STORE_H_ */
@@ -0,0 +1,142 @@
+/*
+ * quotes.c
+ *
+ * Incremental parser for the TrueFX rate feed, see quotes.h for the format.
+ */
+
+#include <string.h>
+
+#include "quotes.h"
+
+enum {
+    QP_NAMES,
+    QP_BID_BIG,
+    QP_BID_PTS,
+    QP_ASK_BIG,
+    QP_ASK_PTS,
+    QP_DONE,
+};
+
+static const uint8_t section_width[] = {
+    [QP_NAMES] = QUOTE_PAIR_LEN,
+    [QP_BID_BIG] = 4, [QP_BID_PTS] = 3,
+    [QP_ASK_BIG] = 4, [QP_ASK_PTS] = 3,
+};
+
+// all four price fields of a pair were seen
+#define QP_SEEN_ALL ((1 << QP_BID_BIG) | (1 << QP_BID_PTS) | \
+                     (1 << QP_ASK_BIG) | (1 << QP_ASK_PTS))
+
+void quotes_book_init(quote_book_t *book, const char *const *watchlist, int watch_len) {
+    memset(book, 0, sizeof *book);
+    if (watch_len > QUOTE_MAX_PAIRS)
+        watch_len = QUOTE_MAX_PAIRS;
+    for (int i = 0; i < watch_len; i++) {
+        strncpy(book->q[i].pair, watchlist[i], QUOTE_PAIR_LEN);
+    }
+    book->count = watch_len;
+}
+
+void quote_parser_init(quote_parser_t *p, const char *const *watchlist, int watch_len) {
+    memset(p, 0, sizeof *p);
+    p->watchlist = watchlist;
+    p->watch_len = watch_len > QUOTE_MAX_PAIRS ? QUOTE_MAX_PAIRS : watch_len;
+    p->section = QP_NAMES;
+}
+
+static int8_t watch_slot(const quote_parser_t *p, const char *name) {
+    for (int i = 0; i < p->watch_len; i++) {
+        if (strncmp(p->watchlist[i], name, QUOTE_PAIR_LEN) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void field_done(quote_parser_t *p) {
+    p->flen = 0;
+
+    if (p->section == QP_NAMES) {
+        if (p->field[3] != '/') {
+            // First field that isn't a pair name: it's the first bid big
+            // figure, so the names are done and the field must be replayed
+            p->ncols = p->col;
+            p->col = 0;
+            if (p->ncols == 0) {
+                p->section = QP_DONE;
+                return;
+            }
+            p->section = QP_BID_BIG;
+            char replay[QUOTE_PAIR_LEN];
+            memcpy(replay, p->field, QUOTE_PAIR_LEN);
+            quote_parser_feed(p, replay, QUOTE_PAIR_LEN);
+            return;
+        }
+        if (p->col < QUOTE_MAX_FEED_COLS)
+            p->col_map[p->col] = watch_slot(p, p->field);
+        p->col++;
+        return;
+    }
+
+    int slot = p->col < QUOTE_MAX_FEED_COLS ? p->col_map[p->col] : -1;
+    if (slot >= 0) {
+        // big figure goes in front, points behind it
+        int bid = (p->section == QP_BID_BIG || p->section == QP_BID_PTS);
+        int offset = (p->section == QP_BID_BIG || p->section == QP_ASK_BIG) ? 0 : 4;
+        char *dest = bid ? p->bid[slot] : p->ask[slot];
+        memcpy(dest + offset, p->field, section_width[p->section]);
+        p->seen[slot] |= 1 << p->section;
+    }
+
+    if (++p->col == p->ncols) {
+        p->col = 0;
+        p->section++;
+    }
+}
+
+void quote_parser_feed(quote_parser_t *p, const char *data, int len) {
+    for (int i = 0; i < len && p->section != QP_DONE; i++) {
+        p->field[p->flen++] = data[i];
+        if (p->flen == section_width[p->section])
+            field_done(p);
+    }
+}
+
+int quote_parser_finish(quote_parser_t *p, quote_book_t *book) {
+    int updated = 0;
+    for (int i = 0; i < p->watch_len && i < book->count; i++) {
+        if (p->seen[i] != QP_SEEN_ALL)
+            continue;
+        quote_t *q = &book->q[i];
+        memcpy(q->bid, p->bid[i], QUOTE_PRICE_LEN);
+        memcpy(q->ask, p->ask[i], QUOTE_PRICE_LEN);
+        q->bid[QUOTE_PRICE_LEN] = 0;
+        q->ask[QUOTE_PRICE_LEN] = 0;
+        q->valid = 1;
+        q->stale = 0;
+        updated++;
+    }
+    if (updated)
+        book->stale = 0;
+    return updated;
+}
+
+int quotes_any_stale(const quote_book_t *book) {
+    for (int i = 0; i < book->count; i++) {
+        if (book->q[i].valid && book->q[i].stale)
+            return 1;
+    }
+    return 0;
+}
+
+static int32_t price_points(const char *price) {
+    int32_t points = 0;
+    for (; *price; price++) {
+        if (*price >= '0' && *price <= '9')
+            points = points * 10 + (*price - '0');
+    }
+    return points;
+}
+
+int32_t quote_mid_points(const quote_t *q) {
+    return (price_points(q->bid) + price_points(q->ask)) / 2;
+}
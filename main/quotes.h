@@ -0,0 +1,74 @@
+/*
+ * quotes.h
+ *
+ * Incremental parser for the TrueFX rate feed.
+ *
+ * The feed is a column-major run of fixed-width fields without separators:
+ * first all pair names (7 chars each, "EUR/USD"), then all bid big figures
+ * (4 chars, "1.14"), all bid points (3 chars, "096"), all offer big figures
+ * and all offer points.  The number of pairs is not sent, it is detected as
+ * the first 7-char field that doesn't look like a pair name.
+ *
+ * The parser is fed the response chunk by chunk and only keeps the pairs on
+ * the watchlist, so its memory use doesn't depend on the response size.
+ */
+
+#ifndef MAIN_QUOTES_H_
+#define MAIN_QUOTES_H_
+
+#include <stdint.h>
+
+#define QUOTE_PAIR_LEN      7   // "EUR/USD"
+#define QUOTE_PRICE_LEN     7   // big figure (4) + points (3): "1.14096"
+#define QUOTE_MAX_PAIRS     8   // watchlist capacity
+#define QUOTE_MAX_FEED_COLS 32  // feed columns we can map, later ones are skipped
+
+typedef struct {
+    char pair[QUOTE_PAIR_LEN + 1];
+    char bid[QUOTE_PRICE_LEN + 1];
+    char ask[QUOTE_PRICE_LEN + 1];
+    uint8_t valid;  // 0 until bid and ask were seen in a complete response
+    uint8_t stale;  // restored from flash, not fetched in this boot yet
+} quote_t;
+
+typedef struct {
+    quote_t q[QUOTE_MAX_PAIRS];
+    int count;      // number of watchlist entries, valid or not
+    uint8_t stale;  // restored from flash, nothing fetched since (quote_store.h);
+                    // which quotes are still from flash is in quote_t.stale
+} quote_book_t;
+
+typedef struct {
+    const char *const *watchlist;
+    int watch_len;
+
+    int8_t col_map[QUOTE_MAX_FEED_COLS];  // feed column -> watchlist slot, -1 = skip
+    int ncols;                            // pairs in the feed, known after names
+
+    uint8_t section;  // which column block we are in, see quotes.c
+    int col;          // column within the current section
+    char field[QUOTE_PAIR_LEN];
+    uint8_t flen;
+
+    // prices are collected here and only committed once the response is done
+    char bid[QUOTE_MAX_PAIRS][QUOTE_PRICE_LEN];
+    char ask[QUOTE_MAX_PAIRS][QUOTE_PRICE_LEN];
+    uint8_t seen[QUOTE_MAX_PAIRS];
+} quote_parser_t;
+
+// Set up an empty book with the watchlist's pair names
+void quotes_book_init(quote_book_t *book, const char *const *watchlist, int watch_len);
+
+void quote_parser_init(quote_parser_t *p, const char *const *watchlist, int watch_len);
+void quote_parser_feed(quote_parser_t *p, const char *data, int len);
+// Commit all completely parsed pairs into book, returns how many were updated.
+// Only those lose their stale mark, the book's goes with the first of them.
+int quote_parser_finish(quote_parser_t *p, quote_book_t *book);
+// Are any of the valid quotes still the ones restored from flash?
+int quotes_any_stale(const quote_book_t *book);
+
+// Mid price of a valid quote in units of the last digit ("1.14096" counts
+// 0.00001), so that it fits an integer and deltas stay small
+int32_t quote_mid_points(const quote_t *q);
+
+#endif /* MAIN_QUOTES_H_ */
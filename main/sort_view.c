@@ -0,0 +1,92 @@
+/*
+ * sort_view.c
+ *
+ * Bar chart of the LED sort, see sort_view.h
+ */
+
+#include <string.h>
+
+#include "sort_view.h"
+
+#define PANEL_WIDTH 128
+#define PANEL_ROWS  (SORT_VIEW_PAGES * 8)
+
+static int num_bars;
+static uint8_t pitch, width, margin;  // columns
+static EventGroupHandle_t wake_events;
+static EventBits_t wake_bit;
+
+// rows per bar, and which bars changed since the display task last looked
+static uint8_t heights[SORT_VIEW_MAX_BARS];
+static uint64_t dirty;
+static portMUX_TYPE view_mux = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert(SORT_VIEW_MAX_BARS <= 64, "dirty is a 64 bit mask");
+
+void sort_view_init(int bars, EventGroupHandle_t events, EventBits_t bit) {
+    num_bars = bars < SORT_VIEW_MAX_BARS ? bars : SORT_VIEW_MAX_BARS;
+    pitch = PANEL_WIDTH / num_bars;
+    width = pitch - 1 < SORT_VIEW_MAX_WIDTH ? pitch - 1 : SORT_VIEW_MAX_WIDTH;
+    margin = (PANEL_WIDTH - num_bars * pitch) / 2;
+    wake_events = events;
+    wake_bit = bit;
+}
+
+static void changed(uint64_t bits) {
+    portENTER_CRITICAL(&view_mux);
+    dirty |= bits;
+    portEXIT_CRITICAL(&view_mux);
+    xEventGroupSetBits(wake_events, wake_bit);
+}
+
+void sort_view_set(int i, uint32_t value, uint32_t max) {
+    if (i >= num_bars)
+        return;
+    // at least a row, so that the smallest elements still show
+    const uint8_t h = 1 + (uint64_t)value * (PANEL_ROWS - 1) / (max ? max : 1);
+    portENTER_CRITICAL(&view_mux);
+    heights[i] = h;
+    portEXIT_CRITICAL(&view_mux);
+    changed(1ull << i);
+}
+
+void sort_view_swap(int a, int b) {
+    if (a >= num_bars || b >= num_bars || a == b)
+        return;
+    portENTER_CRITICAL(&view_mux);
+    const uint8_t h = heights[a];
+    heights[a] = heights[b];
+    heights[b] = h;
+    portEXIT_CRITICAL(&view_mux);
+    changed(1ull << a | 1ull << b);
+}
+
+void sort_view_invalidate() {
+    changed(num_bars == 64 ? ~0ull : (1ull << num_bars) - 1);
+}
+
+int sort_view_next(sort_view_bar_t *bar) {
+    portENTER_CRITICAL(&view_mux);
+    const int i = dirty ? __builtin_ctzll(dirty) : -1;
+    uint8_t h = 0;
+    if (i >= 0) {
+        dirty &= dirty - 1;
+        h = heights[i];
+    }
+    portEXIT_CRITICAL(&view_mux);
+    if (i < 0)
+        return 0;
+
+    bar->col_start = margin + i * pitch;
+    bar->col_end = bar->col_start + width - 1;
+    bar->len = 0;
+    // bottom up: rows PANEL_ROWS - h .. PANEL_ROWS - 1 are lit
+    const int top = PANEL_ROWS - h;
+    for (int page = 0; page < SORT_VIEW_PAGES; page++) {
+        const int first = top - page * 8;  // first lit bit of this page
+        const uint8_t b = first <= 0 ? 0xff : first >= 8 ? 0 : (uint8_t)(0xff << first);
+        memset(&bar->data[bar->len], b, width);
+        bar->len += width;
+    }
+    return 1;
+}
@@ -0,0 +1,48 @@
+/*
+ * sort_view.h
+ *
+ * The LED sort as a bar chart on the OLED, one vertical bar per element,
+ * as tall as its value.  The LED task reports each swap, the display task
+ * redraws only the bars that changed since it last looked.
+ *
+ * Each bar is written as one window in horizontal addressing mode: the
+ * column and page range commands, then its columns of all eight pages in a
+ * single data stream.  For the hat's 41 elements a bar is two columns wide
+ * (with a column of gap), so a swap costs two I2C transactions of 30 bytes,
+ * about 0.6 ms at 1 MHz, where a full frame is over 1 KB.  Changes that
+ * pile up while the display task is busy coalesce, a bar is drawn once per
+ * wake-up however often it moved.
+ */
+
+#ifndef MAIN_SORT_VIEW_H_
+#define MAIN_SORT_VIEW_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#define SORT_VIEW_MAX_BARS  64
+#define SORT_VIEW_MAX_WIDTH 8   // columns of a bar, without the gap
+#define SORT_VIEW_PAGES     8
+
+// A bar to draw: columns col_start..col_end of all pages, horizontal mode
+typedef struct {
+    uint8_t col_start, col_end;
+    uint8_t data[SORT_VIEW_MAX_WIDTH * SORT_VIEW_PAGES];
+    uint16_t len;
+} sort_view_bar_t;
+
+// Chart of `bars` elements on a 128 column panel.  Every change sets `bit`
+// in `events`, to wake the display task.
+void sort_view_init(int bars, EventGroupHandle_t events, EventBits_t bit);
+// Element i is now value out of max (LED task)
+void sort_view_set(int i, uint32_t value, uint32_t max);
+// Elements a and b swapped places (LED task)
+void sort_view_swap(int a, int b);
+// Draw all bars next time, e.g. after the panel was cleared
+void sort_view_invalidate();
+// Next bar that changed, returns 0 when there is none (display task)
+int sort_view_next(sort_view_bar_t *bar);
+
+#endif /* MAIN_SORT_VIEW_H_ */
@@ -0,0 +1,82 @@
+/*
+ * sparkline.c
+ *
+ * Price history charts, see sparkline.h
+ */
+
+#include <string.h>
+
+#include "sparkline.h"
+
+#define RING(i) ((i) % SPARK_LEN)
+
+_Static_assert((SPARK_LEN & (SPARK_LEN - 1)) == 0, "SPARK_LEN must be a power of two");
+
+void spark_init(spark_t *s) {
+    memset(s, 0, sizeof *s);
+}
+
+// Scale for samples from mn to mx: an eighth of the range (at least two
+// points) of room above and below
+static void set_scale(spark_t *s, int32_t mn, int32_t mx) {
+    const int32_t pad = (mx - mn) / 8 + 2;
+    s->lo = mn - pad;
+    s->hi = mx + pad;
+}
+
+int spark_push(spark_t *s, int32_t mid) {
+    const uint32_t n = s->next++;
+
+    // samples that leave the window leave the queues
+    if (s->min_head != s->min_tail && s->minq[RING(s->min_head)] + SPARK_LEN <= n)
+        s->min_head++;
+    if (s->max_head != s->max_tail && s->maxq[RING(s->max_head)] + SPARK_LEN <= n)
+        s->max_head++;
+    s->gone = s->mids[RING(n)];
+    s->mids[RING(n)] = mid;
+
+    // nothing before a smaller (larger) newer sample can be the min (max)
+    while (s->min_tail != s->min_head && s->mids[RING(s->minq[RING(s->min_tail - 1)])] >= mid)
+        s->min_tail--;
+    s->minq[RING(s->min_tail++)] = n;
+    while (s->max_tail != s->max_head && s->mids[RING(s->maxq[RING(s->max_tail - 1)])] <= mid)
+        s->max_tail--;
+    s->maxq[RING(s->max_tail++)] = n;
+
+    const int32_t mn = s->mids[RING(s->minq[RING(s->min_head)])];
+    const int32_t mx = s->mids[RING(s->maxq[RING(s->max_head)])];
+    // a flat line still keeps the minimum scale of four points
+    if (n == 0 || mn < s->lo || mx > s->hi || s->hi - s->lo > 2 * (mx - mn + 4)) {
+        set_scale(s, mn, mx);
+        return 1;
+    }
+    return 0;
+}
+
+// Row of a value, 0 at the top
+static int row_of(const spark_t *s, int32_t v) {
+    int y = (int64_t)(v - s->lo) * (SPARK_ROWS - 1) / (s->hi - s->lo);
+    y = y < 0 ? 0 : y > SPARK_ROWS - 1 ? SPARK_ROWS - 1 : y;
+    return SPARK_ROWS - 1 - y;
+}
+
+void spark_column(const spark_t *s, int x, uint8_t out[SPARK_PAGES]) {
+    memset(out, 0, SPARK_PAGES);
+    // sample number of column x, the window ends at the newest one
+    const int64_t n = (int64_t)s->next - SPARK_LEN + x;
+    if (n < 0)
+        return;
+
+    int top = row_of(s, s->mids[RING(n)]), bottom = top;
+    if (n > 0) {
+        // down to the row next to the previous sample's, which touches it.
+        // Column 0 too, as it was drawn before it was scrolled there.
+        const int prev = row_of(s, x > 0 ? s->mids[RING(n - 1)] : s->gone);
+        if (prev < top - 1)
+            top = prev + 1;
+        else if (prev > bottom + 1)
+            bottom = prev - 1;
+    }
+    for (int r = top; r <= bottom; r++)
+        out[r / 8] |= 1 << (r % 8);
+}
@@ -0,0 +1,48 @@
+/*
+ * sparkline.h
+ *
+ * Mid prices of the last SPARK_LEN updates of a pair, drawn as a line one
+ * column per update, newest on the right.  The chart is SPARK_PAGES pages
+ * tall and scaled to the range of the samples it shows.
+ *
+ * The range is kept as a running min and max over the window (monotonic
+ * queues, so a push is O(1) amortised however long the window).  The scale
+ * only changes when a sample leaves it, or when the samples shrink to less
+ * than half of it, so most updates just add a column: the caller moves the
+ * chart left by one and draws the new one, a few bytes however long the
+ * history.  A push that changes the scale says so, and the whole chart has
+ * to be drawn again.
+ */
+
+#ifndef MAIN_SPARKLINE_H_
+#define MAIN_SPARKLINE_H_
+
+#include <stdint.h>
+
+#define SPARK_LEN   128  // samples, one per column; a power of two
+#define SPARK_PAGES 4
+#define SPARK_ROWS  (SPARK_PAGES * 8)
+
+typedef struct {
+    int32_t mids[SPARK_LEN];  // by sample number % SPARK_LEN
+    uint32_t next;            // number of the next sample
+    int32_t gone;             // the last sample that left the window
+    // numbers of the samples that can still become the min (the max) of
+    // the window, oldest first, between free-running head and tail
+    uint32_t minq[SPARK_LEN], maxq[SPARK_LEN];
+    uint32_t min_head, min_tail, max_head, max_tail;
+    int32_t lo, hi;           // values at the bottom and top row
+} spark_t;
+
+void spark_init(spark_t *s);
+// Add a sample.  Returns 1 if the scale changed, so that all columns need
+// drawing again, 0 if only the new one does.
+int spark_push(spark_t *s, int32_t mid);
+// Column x (0 oldest, SPARK_LEN - 1 newest) as one byte per page, bit 0 at
+// the top.  The line runs from next to the previous sample to this one,
+// also in column 0 when the previous sample has just left the window, so a
+// chart moved left by a column and given the new one is the same as one
+// drawn in full.
+void spark_column(const spark_t *s, int x, uint8_t out[SPARK_PAGES]);
+
+#endif /* MAIN_SPARKLINE_H_ */
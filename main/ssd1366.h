@@ -43,6 +43,9 @@
 // Charge Pump (pg.62)
 #define OLED_CMD_SET_CHARGE_PUMP        0x8D    // follow with 0x14
 
+#include "i2c_pool.h"
+#include "mirror.h"
+
 
 void i2c_master_init()
 {
@@ -58,92 +61,138 @@ void i2c_master_init()
     i2c_driver_install(I2C_NUM_0, I2C_MODE_MASTER, 0, 0, 0);
 }
 
-void ssd1306_init() {
-    esp_err_t espRc;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+// One transaction: the control byte, then len bytes of commands or data.
+// Runs on a pooled command link (i2c_pool.h), which keeps it off the heap
+// with ESP-IDF v4.4 and later; the v4.0 driver allocates every command of
+// every transaction.  data only needs to stay valid for the duration of the
+// call.  The mirror (mirror.h) sees every transaction.
+esp_err_t ssd1306_write(uint8_t control, const uint8_t *data, size_t len) {
+    const uint8_t head[2] = { (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, control };
 
+    i2c_cmd_handle_t cmd = i2c_pool_get();
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
+    i2c_master_write(cmd, head, sizeof head, true);
+    i2c_master_write(cmd, data, len, true);
+    i2c_master_stop(cmd);
+    esp_err_t espRc = i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
+    i2c_pool_put(cmd);
+    mirror_oled(control, data, len);
+    return espRc;
+}
+
+// Single command followed by a data stream, in one transaction
+static esp_err_t ssd1306_write_page(uint8_t page, const uint8_t *data, size_t len) {
+    uint8_t buf[2 + 128] = {
+        0xB0 | page,
+        OLED_CONTROL_BYTE_DATA_STREAM,
+    };
+    memcpy(buf + 2, data, len);
+    return ssd1306_write(OLED_CONTROL_BYTE_CMD_SINGLE, buf, 2 + len);
+}
 
-    i2c_master_write_byte(cmd, OLED_CMD_SET_CHARGE_PUMP, true);
-    i2c_master_write_byte(cmd, 0x14, true);
+// Page mode: len bytes from column col of page, in one transaction
+esp_err_t ssd1306_write_at(uint8_t page, uint8_t col, const uint8_t *data, size_t len) {
+    uint8_t buf[5 + 1 + 128] = {
+        0xB0 | page,
+        OLED_CONTROL_BYTE_CMD_SINGLE, col & 0x0F,
+        OLED_CONTROL_BYTE_CMD_SINGLE, 0x10 | (col >> 4),
+        OLED_CONTROL_BYTE_DATA_STREAM,
+    };
+    if (len > 128)
+        len = 128;
+    memcpy(buf + 6, data, len);
+    return ssd1306_write(OLED_CONTROL_BYTE_CMD_SINGLE, buf, 6 + len);
+}
 
-    i2c_master_write_byte(cmd, OLED_CMD_SET_SEGMENT_REMAP, true); // reverse left-right mapping
-    i2c_master_write_byte(cmd, OLED_CMD_SET_COM_SCAN_MODE, true); // reverse up-bottom mapping
+// Memory addressing mode, p34: 0x00 horizontal, 0x02 page (the reset
+// default).  Text is drawn in page mode, windows in horizontal mode.  The
+// range is set back to the whole panel, so that page mode wraps at column
+// 127 again; range commands only count outside page mode.
+void ssd1306_set_addressing(uint8_t mode) {
+    const uint8_t range[] = {
+        OLED_CMD_SET_COLUMN_RANGE, 0x00, 0x7F,
+        OLED_CMD_SET_PAGE_RANGE, 0x00, 0x07,
+    };
+    const uint8_t cmds[] = { OLED_CMD_SET_MEMORY_ADDR_MODE, mode };
+    if (mode == 0x02)
+        ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, range, sizeof range);
+    ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
+    if (mode != 0x02)
+        ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, range, sizeof range);
+}
 
-    i2c_master_write_byte(cmd, OLED_CMD_DISPLAY_ON, true);
-    i2c_master_stop(cmd);
+// Columns col_start..col_end of pages page_start..page_end, in the order
+// horizontal addressing mode fills them (page by page).  One transaction:
+// the two range commands as single commands, then the data stream.
+esp_err_t ssd1306_write_window(uint8_t col_start, uint8_t col_end, uint8_t page_start,
+                               uint8_t page_end, const uint8_t *data, size_t len) {
+    uint8_t buf[11 + 1 + 128] = {
+        OLED_CMD_SET_COLUMN_RANGE,
+        OLED_CONTROL_BYTE_CMD_SINGLE, col_start,
+        OLED_CONTROL_BYTE_CMD_SINGLE, col_end,
+        OLED_CONTROL_BYTE_CMD_SINGLE, OLED_CMD_SET_PAGE_RANGE,
+        OLED_CONTROL_BYTE_CMD_SINGLE, page_start,
+        OLED_CONTROL_BYTE_CMD_SINGLE, page_end,
+        OLED_CONTROL_BYTE_DATA_STREAM,
+    };
+    if (len > 128)
+        len = 128;
+    memcpy(buf + 12, data, len);
+    return ssd1306_write(OLED_CONTROL_BYTE_CMD_SINGLE, buf, 12 + len);
+}
 
-    espRc = i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
+void ssd1306_init() {
+    esp_err_t espRc;
+
+    static const uint8_t init_cmds[] = {
+        OLED_CMD_SET_CHARGE_PUMP, 0x14,
+        OLED_CMD_SET_SEGMENT_REMAP, // reverse left-right mapping
+        OLED_CMD_SET_COM_SCAN_MODE, // reverse up-bottom mapping
+        OLED_CMD_DISPLAY_ON,
+    };
+
+    espRc = ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, init_cmds, sizeof init_cmds);
     if (espRc == ESP_OK) {
         ESP_LOGI(tag, "OLED configured successfully");
     } else {
         ESP_LOGE(tag, "OLED configuration failed. code: 0x%.2X", espRc);
     }
-    i2c_cmd_link_delete(cmd);
 }
 
 void task_ssd1306_display_pattern(void *ignore) {
-    i2c_cmd_handle_t cmd;
+    uint8_t row[128];
 
+    for (uint8_t j = 0; j < 128; j++) {
+        row[j] = 0xFF >> (j % 8);
+    }
     for (uint8_t i = 0; i < 8; i++) {
-        cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_SINGLE, true);
-        i2c_master_write_byte(cmd, 0xB0 | i, true);
-        i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_DATA_STREAM, true);
-        for (uint8_t j = 0; j < 128; j++) {
-            i2c_master_write_byte(cmd, 0xFF >> (j % 8), true);
-        }
-        i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
+        ssd1306_write_page(i, row, sizeof row);
     }
 
     vTaskDelete(NULL);
 }
 
-void task_ssd1306_display_clear(void *ignore) {
-    i2c_cmd_handle_t cmd;
-
+void ssd1306_display_clear() {
     uint8_t zero[128];
     memset(zero, 0, sizeof zero);
     for (uint8_t i = 0; i < 8; i++) {
-        cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_SINGLE, true);
-        i2c_master_write_byte(cmd, 0xB0 | i, true);
-
-        i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_DATA_STREAM, true);
-        i2c_master_write(cmd, zero, 128, true);
-        i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
+        ssd1306_write_page(i, zero, sizeof zero);
     }
+}
+
+void task_ssd1306_display_clear(void *ignore) {
+    ssd1306_display_clear();
 
     vTaskDelete(NULL);
 }
 
 
 void task_ssd1306_contrast(void *ignore) {
-    i2c_cmd_handle_t cmd;
-
     uint8_t contrast = 0;
     uint8_t direction = 1;
     while (true) {
-        cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
-        i2c_master_write_byte(cmd, OLED_CMD_SET_CONTRAST, true);
-        i2c_master_write_byte(cmd, contrast, true);
-        i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
+        const uint8_t cmds[] = { OLED_CMD_SET_CONTRAST, contrast };
+        ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
         vTaskDelay(1/portTICK_PERIOD_MS);
 
         contrast += direction;
@@ -156,86 +205,93 @@ void task_ssd1306_contrast(void *ignore) {
 void task_ssd1306_scroll(void *ignore) {
     esp_err_t espRc;
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-
-    i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
-
-    i2c_master_write_byte(cmd, 0x29, true); // vertical and horizontal scroll (p29)
-    i2c_master_write_byte(cmd, 0x00, true);
-    i2c_master_write_byte(cmd, 0x00, true);
-    i2c_master_write_byte(cmd, 0x07, true);
-    i2c_master_write_byte(cmd, 0x01, true);
-    i2c_master_write_byte(cmd, 0x3F, true);
-
-    i2c_master_write_byte(cmd, 0xA3, true); // set vertical scroll area (p30)
-    i2c_master_write_byte(cmd, 0x20, true);
-    i2c_master_write_byte(cmd, 0x40, true);
-
-    i2c_master_write_byte(cmd, 0x2F, true); // activate scroll (p29)
+    static const uint8_t cmds[] = {
+        0x29, 0x00, 0x00, 0x07, 0x01, 0x3F, // vertical and horizontal scroll (p29)
+        0xA3, 0x20, 0x40,                   // set vertical scroll area (p30)
+        0x2F,                               // activate scroll (p29)
+    };
 
-    i2c_master_stop(cmd);
-    espRc = i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
+    espRc = ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
     if (espRc == ESP_OK) {
         ESP_LOGI(tag, "Scroll command succeeded");
     } else {
         ESP_LOGE(tag, "Scroll command failed. code: 0x%.2X", espRc);
     }
 
-    i2c_cmd_link_delete(cmd);
-
     vTaskDelete(NULL);
 }
 
-void task_ssd1306_display_text(void *arg_text) {
-    char *text = (char*)arg_text;
-    uint8_t text_len = strlen(text);
+// Continuously scroll rows [fixed_rows, fixed_rows + scroll_rows) upwards by
+// one row every `interval` frames (encoded as on p29: 0b111 = 2 frames, 0b110
+// = 25 frames, ...).  The panel scrolls on its own, so there is no I2C traffic
+// while it runs.  Pages start_page..end_page get the horizontal part of the
+// scroll; A = 0 disables that on panels that support it (datasheet rev 1.5).
+// RAM must not be written while scrolling, call ssd1306_scroll_stop() first.
+void ssd1306_vscroll_start(uint8_t fixed_rows, uint8_t scroll_rows,
+                           uint8_t start_page, uint8_t end_page,
+                           uint8_t interval) {
+    esp_err_t espRc;
 
-    i2c_cmd_handle_t cmd;
+    const uint8_t cmds[] = {
+        0xA3, fixed_rows, scroll_rows,      // set vertical scroll area (p30)
+        0x29, 0x00, start_page,             // vertical and horizontal scroll (p29)
+        interval & 0x07, end_page,
+        0x01,                               // one row per step
+        0x2F,                               // activate scroll (p29)
+    };
 
-    uint8_t cur_page = 0;
+    espRc = ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
+    if (espRc != ESP_OK) {
+        ESP_LOGE(tag, "Scroll command failed. code: 0x%.2X", espRc);
+    }
+}
 
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+// Move columns start_col..end_col of pages start_page..end_page one column
+// to the left in RAM, the leftmost wraps around to end_col (content scroll,
+// datasheet rev 1.5).  Once, no scrolling is left running; consecutive
+// calls need two panel frames in between.
+void ssd1306_scroll_left_one(uint8_t start_page, uint8_t end_page,
+                             uint8_t start_col, uint8_t end_col) {
+    const uint8_t cmds[] = {
+        0x2D, 0x00, start_page, 0x01, end_page, start_col, end_col,
+    };
+    ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
+}
 
-    i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
-    i2c_master_write_byte(cmd, 0x00, true); // reset column
-    i2c_master_write_byte(cmd, 0x10, true);
-    i2c_master_write_byte(cmd, 0xB0 | cur_page, true); // reset page
+void ssd1306_scroll_stop() {
+    static const uint8_t cmd = 0x2E; // deactivate scroll (p29)
+    ssd1306_write(OLED_CONTROL_BYTE_CMD_SINGLE, &cmd, 1);
+}
 
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+// Column 0 of the given page, for page addressing mode
+static void ssd1306_set_page(uint8_t page) {
+    const uint8_t cmds[] = {
+        0x00, // reset column
+        0x10,
+        0xB0 | page,
+    };
+    ssd1306_write(OLED_CONTROL_BYTE_CMD_STREAM, cmds, sizeof cmds);
+}
+
+void ssd1306_display_text(const char *text) {
+    uint8_t text_len = strlen(text);
+
+    uint8_t cur_page = 0;
+
+    ssd1306_set_page(cur_page); // reset page
 
     for (uint8_t i = 0; i < text_len; i++) {
         if (text[i] == '\n') {
-            cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-
-            i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_CMD_STREAM, true);
-            i2c_master_write_byte(cmd, 0x00, true); // reset column
-            i2c_master_write_byte(cmd, 0x10, true);
-            i2c_master_write_byte(cmd, 0xB0 | ++cur_page, true); // increment page
-
-            i2c_master_stop(cmd);
-            i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-            i2c_cmd_link_delete(cmd);
+            ssd1306_set_page(++cur_page); // increment page
         } else {
-            cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, (OLED_I2C_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-
-            i2c_master_write_byte(cmd, OLED_CONTROL_BYTE_DATA_STREAM, true);
-            i2c_master_write(cmd, font8x8_basic_tr[(uint8_t)text[i]], 8, true);
-
-            i2c_master_stop(cmd);
-            i2c_master_cmd_begin(I2C_NUM_0, cmd, 10/portTICK_PERIOD_MS);
-            i2c_cmd_link_delete(cmd);
+            ssd1306_write(OLED_CONTROL_BYTE_DATA_STREAM,
+                          font8x8_basic_tr[(uint8_t)text[i]], 8);
         }
     }
+}
+
+void task_ssd1306_display_text(void *arg_text) {
+    ssd1306_display_text((const char*)arg_text);
 
     vTaskDelete(NULL);
 }
@@ -0,0 +1,67 @@
+/*
+ * traffic.c
+ *
+ * Rolling per-hour traffic counter, see traffic.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "traffic.h"
+
+static traffic_stats_t slots[TRAFFIC_SLOTS];
+static uint32_t slot_minute[TRAFFIC_SLOTS];
+static portMUX_TYPE traffic_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t current_minute() {
+    return esp_timer_get_time() / (60 * 1000000LL);
+}
+
+// the slot for this minute, emptied if it still holds an hour-old minute
+static traffic_stats_t *current_slot() {
+    uint32_t minute = current_minute();
+    int i = minute % TRAFFIC_SLOTS;
+    if (slot_minute[i] != minute) {
+        memset(&slots[i], 0, sizeof slots[i]);
+        slot_minute[i] = minute;
+    }
+    return &slots[i];
+}
+
+void traffic_add_bytes(uint32_t bytes) {
+    portENTER_CRITICAL(&traffic_mux);
+    current_slot()->bytes += bytes;
+    portEXIT_CRITICAL(&traffic_mux);
+}
+
+void traffic_add_response(int not_modified) {
+    portENTER_CRITICAL(&traffic_mux);
+    traffic_stats_t *slot = current_slot();
+    slot->responses++;
+    slot->not_modified += !!not_modified;
+    portEXIT_CRITICAL(&traffic_mux);
+}
+
+void traffic_last_hour(traffic_stats_t *out) {
+    memset(out, 0, sizeof *out);
+    uint32_t minute = current_minute();
+    portENTER_CRITICAL(&traffic_mux);
+    for (int i = 0; i < TRAFFIC_SLOTS; i++) {
+        if (minute - slot_minute[i] >= TRAFFIC_SLOTS)
+            continue;
+        out->bytes += slots[i].bytes;
+        out->responses += slots[i].responses;
+        out->not_modified += slots[i].not_modified;
+    }
+    portEXIT_CRITICAL(&traffic_mux);
+}
+
+void traffic_report() {
+    traffic_stats_t t;
+    traffic_last_hour(&t);
+    printf("traffic: %u bytes/h in %u responses, %u not modified\n",
+           t.bytes, t.responses, t.not_modified);
+}
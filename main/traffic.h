@@ -0,0 +1,28 @@
+/*
+ * traffic.h
+ *
+ * Rolling count of what the quote polling costs on the air: response bytes
+ * (headers and body as received, i.e. compressed) and responses, over the
+ * last hour in one-minute slots.
+ */
+
+#ifndef MAIN_TRAFFIC_H_
+#define MAIN_TRAFFIC_H_
+
+#include <stdint.h>
+
+#define TRAFFIC_SLOTS 60  // one per minute
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t responses;
+    uint32_t not_modified;  // 304s, which skip parsing altogether
+} traffic_stats_t;
+
+void traffic_add_bytes(uint32_t bytes);
+void traffic_add_response(int not_modified);
+// Totals over the last TRAFFIC_SLOTS minutes
+void traffic_last_hour(traffic_stats_t *out);
+void traffic_report();
+
+#endif /* MAIN_TRAFFIC_H_ */
@@ -0,0 +1,61 @@
+/*
+ * wifi_cache.c
+ *
+ * Last association in NVS, see wifi_cache.h
+ */
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "wifi_cache.h"
+
+#define CACHE_NAMESPACE "tbhut"
+#define CACHE_VERSION   1
+
+static const char *TAG = "wifi_cache";
+
+typedef struct {
+    uint8_t version;
+    wifi_cache_t cache;
+} stored_cache_t;
+
+// what is in flash, to skip writing the same again
+static stored_cache_t flash;
+
+int wifi_cache_load(wifi_cache_t *cache) {
+    memset(cache, 0, sizeof *cache);
+    nvs_handle_t nvs;
+    if (nvs_open(CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return 0;
+    size_t len = sizeof flash;
+    esp_err_t err = nvs_get_blob(nvs, "wifi", &flash, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || len != sizeof flash || flash.version != CACHE_VERSION) {
+        memset(&flash, 0, sizeof flash);
+        return 0;
+    }
+    *cache = flash.cache;
+    return cache->channel != 0;
+}
+
+void wifi_cache_save(const wifi_cache_t *cache) {
+    if (flash.version == CACHE_VERSION && memcmp(&flash.cache, cache, sizeof *cache) == 0)
+        return;
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CACHE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        stored_cache_t blob = { .version = CACHE_VERSION, .cache = *cache };
+        err = nvs_set_blob(nvs, "wifi", &blob, sizeof blob);
+        if (err == ESP_OK)
+            err = nvs_commit(nvs);
+        nvs_close(nvs);
+        if (err == ESP_OK)
+            flash = blob;
+    }
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Can't save: %s", esp_err_to_name(err));
+    else
+        ESP_LOGI(TAG, "Saved AP and lease");
+}
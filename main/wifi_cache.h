@@ -0,0 +1,28 @@
+/*
+ * wifi_cache.h
+ *
+ * The AP, channel and DHCP lease of the last association, kept in NVS so
+ * that the next connect can go straight to that AP instead of scanning all
+ * channels, and optionally skip DHCP.  It is only a hint: if the AP moved,
+ * the directed connect fails and the caller falls back to a full scan.
+ */
+
+#ifndef MAIN_WIFI_CACHE_H_
+#define MAIN_WIFI_CACHE_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;   // 0: nothing cached
+    uint32_t ip;       // lease, network order
+    uint32_t netmask;
+    uint32_t gw;
+} wifi_cache_t;
+
+// Fill cache from flash, returns 1 if there was one
+int wifi_cache_load(wifi_cache_t *cache);
+// Store cache unless flash has the same already
+void wifi_cache_save(const wifi_cache_t *cache);
+
+#endif /* MAIN_WIFI_CACHE_H_ */
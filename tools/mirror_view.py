@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+Viewer for the hat's OLED and LED mirror stream.
+
+Reads the console log (a file, or stdin), picks out the "@mir" lines that
+the firmware prints while the mirror is on (console key "v", format in
+main/mirror.h), rebuilds both surfaces from them and draws them in the
+terminal after each poll: the OLED in half-block characters, two rows of
+pixels per line, and the LED strip in 24-bit colour.  Other lines are
+dropped unless --log is given.
+
+    tbhut_host -q < keys | tools/mirror_view.py
+    stty -F /dev/ttyUSB0 115200 raw && tools/mirror_view.py /dev/ttyUSB0
+
+--dump writes each poll's state as oled_NNNNN.pbm and leds_NNNNN.ppm
+instead of drawing it.  At the end the viewer prints how many lines and
+bytes the stream took, and how many packets it couldn't decode.
+"""
+
+import argparse
+import base64
+import binascii
+import os
+import sys
+
+OLED_WIDTH = 128
+OLED_PAGES = 8
+
+MIRROR_RESET = 0x00
+MIRROR_OLED_PAGE = 0x01
+MIRROR_LED = 0x02
+
+MIRROR_OP_LITERAL = 0x40
+MIRROR_OP_REPEAT = 0x80
+
+LEDS_PER_ROW = 64
+
+
+class Surfaces:
+    def __init__(self):
+        self.oled = bytearray(OLED_WIDTH * OLED_PAGES)
+        self.leds = bytearray()
+
+    def reset(self):
+        self.oled = bytearray(len(self.oled))
+        self.leds = bytearray(len(self.leds))
+
+    @staticmethod
+    def apply(target, start, n, unit, ops):
+        """Apply delta ops to n units of target from unit start"""
+        i = p = 0
+        while p < len(ops):
+            op = ops[p]
+            p += 1
+            if op & MIRROR_OP_REPEAT:
+                count = (op & 0x7F) + 1
+                value = ops[p:p + unit]
+                p += unit
+                data = value * count
+            elif op & MIRROR_OP_LITERAL:
+                count = (op & 0x3F) + 1
+                data = ops[p:p + count * unit]
+                p += count * unit
+            else:
+                i += (op & 0x3F) + 1
+                continue
+            if len(data) != count * unit or i + count > n:
+                raise ValueError("op runs past the packet or the surface")
+            pos = (start + i) * unit
+            target[pos:pos + len(data)] = data
+            i += count
+
+    def packet(self, data):
+        kind = data[0]
+        if kind == MIRROR_RESET:
+            self.reset()
+        elif kind == MIRROR_OLED_PAGE:
+            page = data[1]
+            if page >= OLED_PAGES:
+                raise ValueError("page %d" % page)
+            self.apply(self.oled, page * OLED_WIDTH, OLED_WIDTH, 1, data[2:])
+        elif kind == MIRROR_LED:
+            first = data[1] | data[2] << 8
+            length = data[3] | data[4] << 8
+            if len(self.leds) != length * 4:
+                self.leds = bytearray(length * 4)
+            self.apply(self.leds, first, length - first, 4, data[5:])
+        else:
+            raise ValueError("packet type %d" % kind)
+
+    def lit(self, x, y):
+        return (self.oled[(y // 8) * OLED_WIDTH + x] >> (y % 8)) & 1
+
+    def led_rgb(self, i, gain):
+        # pixelColor_t is G, R, B, W; white is added to all three
+        g, r, b, w = self.leds[i * 4:i * 4 + 4]
+        return tuple(min(255, (c + w) * gain) for c in (r, g, b))
+
+
+def draw(surfaces, out, ms, gain):
+    blocks = " ▀▄█"
+    lines = ["\x1b[H\x1b[2J@mir %d ms" % ms]
+    for y in range(0, OLED_PAGES * 8, 2):
+        lines.append("".join(blocks[surfaces.lit(x, y) | surfaces.lit(x, y + 1) << 1]
+                             for x in range(OLED_WIDTH)))
+    count = len(surfaces.leds) // 4
+    for row in range(0, count, LEDS_PER_ROW):
+        lines.append("".join("\x1b[38;2;%d;%d;%dm█" % surfaces.led_rgb(i, gain)
+                             for i in range(row, min(count, row + LEDS_PER_ROW))) + "\x1b[0m")
+    out.write("\n".join(lines) + "\n")
+    out.flush()
+
+
+def dump(surfaces, directory, n, gain):
+    with open(os.path.join(directory, "oled_%05d.pbm" % n), "wb") as f:
+        f.write(b"P1\n%d %d\n" % (OLED_WIDTH, OLED_PAGES * 8))
+        for y in range(OLED_PAGES * 8):
+            # lit pixels come out white, like on the panel
+            f.write(b"".join(b"0" if surfaces.lit(x, y) else b"1"
+                             for x in range(OLED_WIDTH)) + b"\n")
+    count = len(surfaces.leds) // 4
+    with open(os.path.join(directory, "leds_%05d.ppm" % n), "wb") as f:
+        f.write(b"P6\n%d 1\n255\n" % count)
+        f.write(bytes(c for i in range(count) for c in surfaces.led_rgb(i, gain)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("input", nargs="?", help="console log or serial device (default: stdin)")
+    parser.add_argument("--dump", metavar="DIR", help="write each poll's state to DIR")
+    parser.add_argument("--log", action="store_true", help="pass the other console lines through")
+    parser.add_argument("--gain", type=int, default=4,
+                        help="LED brightness factor, the hat runs them dim (default 4)")
+    args = parser.parse_args()
+
+    source = open(args.input, "rb") if args.input else sys.stdin.buffer
+    surfaces = Surfaces()
+    shown_ms = None
+    polls = lines = nbytes = bad = 0
+
+    def show():
+        nonlocal polls
+        polls += 1
+        if args.dump:
+            dump(surfaces, args.dump, polls, args.gain)
+        else:
+            draw(surfaces, sys.stdout, shown_ms, args.gain)
+
+    for raw in source:
+        line = raw.decode("ascii", "replace").rstrip("\r\n")
+        at = line.find("@mir ")
+        if at < 0:
+            if args.log:
+                sys.stderr.write(line + "\n")
+            continue
+        fields = line[at:].split(" ")
+        try:
+            ms = int(fields[1])
+            data = base64.b64decode(fields[2], validate=True)
+            if shown_ms is not None and ms != shown_ms:
+                show()
+            shown_ms = ms
+            surfaces.packet(data)
+        except (IndexError, ValueError, binascii.Error):
+            bad += 1
+            continue
+        lines += 1
+        nbytes += len(line) - at + 1
+    if shown_ms is not None:
+        show()
+
+    sys.stderr.write("mirror: %d polls, %d lines, %d bytes, %d bad\n" % (polls, lines, nbytes, bad))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for the TrueFX rate feed.
+
+Serves random-walk rates for ten pairs in the feed's column-major fixed-width
+format (see main/quotes.h), with ETag / Last-Modified validators.  Rates only
+change every --tick seconds, so with the hat polling every second most
+requests exercise the 304 path.  Responses are gzipped if the client asks
+for it, unless --no-gzip is given.
+
+Point the firmware at it by setting QUOTE_URL in main/main.c to
+http://<this host>:<port>/rates/connect.html.  Every --report requests the
+server prints the response bytes it sent, extrapolated to bytes per hour.
+"""
+
+import argparse
+import email.utils
+import gzip
+import hashlib
+import random
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PAIRS = [
+    ("EUR/USD", 1.14096), ("USD/JPY", 110.123), ("GBP/USD", 1.30456),
+    ("EUR/GBP", 0.87461), ("USD/CHF", 0.99012), ("EUR/JPY", 125.642),
+    ("EUR/CHF", 1.12975), ("USD/CAD", 1.30521), ("AUD/USD", 0.72843),
+    ("GBP/JPY", 143.651),
+]
+
+
+def split_price(price):
+    """Big figure (4 chars) and points (3 chars), as TrueFX sends them"""
+    text = "%.3f" % price if price >= 100 else "%.5f" % price
+    return text[:4], text[4:7]
+
+
+class Feed:
+    def __init__(self, tick):
+        self.tick = tick
+        self.mids = [mid for _, mid in PAIRS]
+        self.changed = 0.0
+        self.body = b""
+        self.update(force=True)
+
+    def update(self, force=False):
+        now = time.time()
+        if not force and now - self.changed < self.tick:
+            return
+        self.mids = [m * (1 + random.gauss(0, 2e-5)) for m in self.mids]
+        bids = [split_price(m * (1 - 3e-5)) for m in self.mids]
+        asks = [split_price(m * (1 + 3e-5)) for m in self.mids]
+        fields = [name for name, _ in PAIRS]
+        fields += [big for big, _ in bids] + [pts for _, pts in bids]
+        fields += [big for big, _ in asks] + [pts for _, pts in asks]
+        self.body = "".join(fields).encode() + b"\n"
+        self.etag = '"%s"' % hashlib.md5(self.body).hexdigest()[:16]
+        self.changed = int(now)
+        self.last_modified = email.utils.formatdate(self.changed, usegmt=True)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            super().log_message(fmt, *args)
+
+    def send(self, status, headers, body=b""):
+        self.send_response(status)
+        for key, value in headers:
+            self.send_header(key, value)
+        self.end_headers()
+        self.wfile.write(body)
+        # what send_response/send_header put on the wire, roughly
+        header_bytes = 17 + sum(len(k) + len(v) + 4 for k, v in headers) + 2
+        self.server.account(header_bytes + len(body), status == 304)
+
+    def do_GET(self):
+        feed = self.server.feed
+        feed.update()
+        validators = [("ETag", feed.etag), ("Last-Modified", feed.last_modified)]
+
+        inm = self.headers.get("If-None-Match")
+        ims = self.headers.get("If-Modified-Since")
+        if (inm is not None and inm == feed.etag) or \
+           (inm is None and ims is not None and ims == feed.last_modified):
+            self.send(304, validators)
+            return
+
+        body = feed.body
+        headers = validators + [("Content-Type", "text/plain")]
+        if self.server.gzip and "gzip" in self.headers.get("Accept-Encoding", ""):
+            body = gzip.compress(body)
+            headers.append(("Content-Encoding", "gzip"))
+        headers.append(("Content-Length", str(len(body))))
+        self.send(200, headers, body)
+
+
+class Server(ThreadingHTTPServer):
+    def __init__(self, addr, args):
+        super().__init__(addr, Handler)
+        self.feed = Feed(args.tick)
+        self.gzip = not args.no_gzip
+        self.verbose = args.verbose
+        self.report = args.report
+        self.started = time.time()
+        self.requests = self.not_modified = self.bytes = 0
+
+    def account(self, nbytes, not_modified):
+        self.requests += 1
+        self.not_modified += not_modified
+        self.bytes += nbytes
+        if self.requests % self.report == 0:
+            hours = (time.time() - self.started) / 3600
+            print("%d requests, %d not modified, %d bytes -> %.0f bytes/h"
+                  % (self.requests, self.not_modified, self.bytes,
+                     self.bytes / hours if hours else 0), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--tick", type=float, default=5,
+                        help="seconds between rate changes")
+    parser.add_argument("--no-gzip", action="store_true",
+                        help="never compress responses")
+    parser.add_argument("--report", type=int, default=60,
+                        help="print traffic stats every this many requests")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = Server(("", args.port), args)
+    print("serving on port %d" % args.port, flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()